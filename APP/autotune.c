@@ -0,0 +1,264 @@
+/**
+	* @File:	autotune.c
+	* @Author:	Chunyu Zhang
+	* @Version:	V0.0.1
+	* @Date:	2026.10.19
+	* @Description:	Relay feedback autotuner for the velocity and position loops.
+	*		The loop under test is replaced by a relay, which makes the joint
+	*		oscillate in a limit cycle. The ultimate gain and period are identified
+	*		from the amplitude and period of the cycle, then the gains are computed
+	*		by tuning rules.
+	*/
+
+#include "math.h"
+#include "autotune.h"
+
+#define AUTOTUNE_PI 3.14159265f
+
+static float AUTOTUNE_get_fbk(AUTOTUNE_t *at)
+{
+	if (at->loop == AUTOTUNE_VEL_LOOP)
+		return at->motor->pid_vel.fbk;
+	else
+		return at->motor->pid_pos.fbk;
+}
+
+static void AUTOTUNE_set_cmd(AUTOTUNE_t *at, float cmd)
+{
+	if (at->loop == AUTOTUNE_VEL_LOOP)
+		MOTOR_cur_mode(at->motor, cmd);
+	else
+		MOTOR_vel_mode(at->motor, cmd);
+}
+
+/* End the experiment and give the joint back to the loops of its mode */
+static AUTOTUNE_State_t AUTOTUNE_stop(AUTOTUNE_t *at, AUTOTUNE_State_t state)
+{
+	/* The relay center is the command from which the loops take over */
+	AUTOTUNE_set_cmd(at, at->bias);
+	if (at->loop == AUTOTUNE_VEL_LOOP)
+		PID_set_state(&at->motor->pid_cur, at->bias, at->bias + at->motor->pid_cur.ffd);
+	at->state = state;
+	MOTOR_set_mode(at->motor, at->mode);
+
+	return state;
+}
+
+/**
+	* @Function:	Initializing the structure member of autotuner
+	* @Parameter:	- *at:		pointer of autotuner structure
+					- *motor:	pointer of motor structure to be tuned
+					- loop:		loop to be tuned
+					- dt:		period of control tick in second
+	* @Return:		none
+	* @Attention:	Each joint has its own autotuner, so several joints can be tuned at the same
+					time as long as their feedback is read every tick.
+*/
+void AUTOTUNE_init(AUTOTUNE_t *at, MOTOR_t *motor, AUTOTUNE_Loop_t loop, float dt)
+{
+	at->motor = motor;
+	at->loop = loop;
+	at->state = AUTOTUNE_IDLE_STATE;
+	at->dt = dt;
+
+	at->ku = 0.0f;
+	at->tu = 0.0f;
+	at->kp = 0.0f;
+	at->ki = 0.0f;
+	at->kd = 0.0f;
+}
+
+/**
+	* @Function:	Starting the relay experiment
+	* @Parameter:	- *at:		pointer of autotuner structure
+					- sp:		setpoint, around which the feedback oscillates
+					- bias:		output of the relay center, e.g. the current to hold the load
+					- amp:		amplitude of the relay output
+					- hyst:		hysteresis of the relay, should be larger than the feedback noise
+					- timeout:	maxinum time of the experiment in second
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		the loops of the motor are in the driver, nothing is started
+	* @Attention:	The motor is switched to the mode which opens the loop under test, i.e.
+					current mode for the velocity loop and velocity mode for the position loop.
+					Therefore the velocity loop must have been tuned before the position loop.
+					Call it after MOTOR_set_fbk() of the tick with the loops on the MCU, see
+					MOTOR_set_exec(). At the end of the experiment the motor goes back to the mode
+					it had, taking over bumplessly from the relay output at its center.
+*/
+int AUTOTUNE_start(AUTOTUNE_t *at, float sp, float bias, float amp, float hyst, float timeout)
+{
+	if (MOTOR_get_exec(at->motor) != MOTOR_EXEC_LOCAL)
+		return -1;
+
+	at->sp = sp;
+	at->bias = bias;
+	at->amp = amp;
+	at->hyst = hyst;
+	at->out = amp;
+
+	at->tick = 0;
+	at->timeout = (unsigned int)(timeout / at->dt);
+	at->rise_tick = 0;
+	at->cycles = -1;
+
+	at->fbk_max = AUTOTUNE_get_fbk(at);
+	at->fbk_min = at->fbk_max;
+	at->sum_period = 0.0f;
+	at->sum_amp = 0.0f;
+
+	at->mode = at->motor->mode;
+	if (at->loop == AUTOTUNE_VEL_LOOP)
+		MOTOR_set_mode(at->motor, MOTOR_CURRENT_MODE);
+	else
+		MOTOR_set_mode(at->motor, MOTOR_VELOCITY_MODE);
+
+	at->state = AUTOTUNE_RELAY_STATE;
+
+	return 0;
+}
+
+/**
+	* @Function:	Running the relay experiment for one tick
+	* @Parameter:	- *at:		pointer of autotuner structure
+	* @Return:		state of autotuner
+	* @Attention:	Call it every tick after MOTOR_set_fbk() and before MOTOR_calc().
+					The amplitude a and period of the cycle are averaged over AUTOTUNE_MEAS_CYCLES
+					cycles, then ku = 4 * amp / (pi * sqrt(a^2 - hyst^2)).
+*/
+AUTOTUNE_State_t AUTOTUNE_calc(AUTOTUNE_t *at)
+{
+	float fbk, err, a;
+
+	if (at->state != AUTOTUNE_RELAY_STATE)
+		return at->state;
+
+	fbk = AUTOTUNE_get_fbk(at);
+	err = at->sp - fbk;
+
+	at->fbk_max = (fbk > at->fbk_max) ? fbk : at->fbk_max;
+	at->fbk_min = (fbk < at->fbk_min) ? fbk : at->fbk_min;
+
+	if (err > at->hyst && at->out < 0)
+	{
+		/* Rising switch, a cycle is completed */
+		at->out = at->amp;
+
+		if (at->cycles >= AUTOTUNE_SKIP_CYCLES)
+		{
+			at->sum_period += (at->tick - at->rise_tick) * at->dt;
+			at->sum_amp += 0.5f * (at->fbk_max - at->fbk_min);
+		}
+		at->cycles++;
+		at->rise_tick = at->tick;
+		at->fbk_max = fbk;
+		at->fbk_min = fbk;
+
+		if (at->cycles >= AUTOTUNE_SKIP_CYCLES + AUTOTUNE_MEAS_CYCLES)
+		{
+			a = at->sum_amp / AUTOTUNE_MEAS_CYCLES;
+			at->tu = at->sum_period / AUTOTUNE_MEAS_CYCLES;
+
+			if (a > at->hyst && at->tu > 0.0f)
+			{
+				at->ku = 4.0f * at->amp / (AUTOTUNE_PI * sqrtf(a * a - at->hyst * at->hyst));
+				return AUTOTUNE_stop(at, AUTOTUNE_DONE_STATE);
+			}
+			return AUTOTUNE_stop(at, AUTOTUNE_FAIL_STATE);
+		}
+	}
+	else if (err < -at->hyst && at->out > 0)
+	{
+		at->out = -at->amp;
+	}
+
+	at->tick++;
+	if (at->tick > at->timeout)
+		return AUTOTUNE_stop(at, AUTOTUNE_FAIL_STATE);
+
+	AUTOTUNE_set_cmd(at, at->bias + at->out);
+
+	return at->state;
+}
+
+/**
+	* @Function:	Aborting the relay experiment
+	* @Parameter:	- *at:		pointer of autotuner structure
+	* @Return:		none
+	* @Attention:	Call it in the context of AUTOTUNE_calc(). The motor goes back to its mode like
+					at the end of the experiment.
+*/
+void AUTOTUNE_abort(AUTOTUNE_t *at)
+{
+	if (at->state == AUTOTUNE_RELAY_STATE)
+		AUTOTUNE_stop(at, AUTOTUNE_FAIL_STATE);
+}
+
+/**
+	* @Function:	Computing the gains and writing them to the motor controller
+	* @Parameter:	- *at:		pointer of autotuner structure
+					- rule:		tuning rule
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		the experiment has not been done successfully
+	* @Attention:	The continuous gains are converted to the discrete form of pid.c, where the
+					integral and the derivative are not scaled by the sample time:
+					ki = kp * dt / Ti, kd = kp * Td / dt.
+					The velocity loop is a PI controller, so kd is ignored there.
+					The gains are published, so they take effect at the next MOTOR_sync_param().
+*/
+int AUTOTUNE_apply(AUTOTUNE_t *at, AUTOTUNE_Rule_t rule)
+{
+	float kp, ti, td;
+
+	if (at->state != AUTOTUNE_DONE_STATE)
+		return -1;
+
+	switch (rule)
+	{
+	case AUTOTUNE_ZN_PI_RULE:
+		kp = 0.45f * at->ku;
+		ti = at->tu / 1.2f;
+		td = 0.0f;
+		break;
+	case AUTOTUNE_ZN_PID_RULE:
+		kp = 0.6f * at->ku;
+		ti = at->tu / 2.0f;
+		td = at->tu / 8.0f;
+		break;
+	case AUTOTUNE_TL_PI_RULE:
+		kp = at->ku / 3.2f;
+		ti = 2.2f * at->tu;
+		td = 0.0f;
+		break;
+	case AUTOTUNE_TL_PID_RULE:
+	default:
+		kp = at->ku / 2.2f;
+		ti = 2.2f * at->tu;
+		td = at->tu / 6.3f;
+		break;
+	}
+
+	at->kp = kp;
+	at->ki = kp * at->dt / ti;
+	at->kd = kp * td / at->dt;
+
+	if (at->loop == AUTOTUNE_VEL_LOOP)
+		MOTOR_set_vel_loop_gain(at->motor, at->kp, at->ki);
+	else
+		MOTOR_set_pos_loop_gain(at->motor, at->kp, at->ki, at->kd);
+	PID_publish();
+
+	return 0;
+}
+
+/**
+	* @Function:	Getting state of autotuner
+	* @Parameter:	- *at:		pointer of autotuner structure
+	* @Return:		state of autotuner
+	* @Attention:	none
+*/
+AUTOTUNE_State_t AUTOTUNE_get_state(AUTOTUNE_t *at)
+{
+	return at->state;
+}
@@ -0,0 +1,85 @@
+#ifndef _AUTOTUNE_H
+#define _AUTOTUNE_H
+
+#include "motor.h"
+
+/* Number of oscillation cycles ignored before measuring */
+#define AUTOTUNE_SKIP_CYCLES 2
+/* Number of oscillation cycles averaged */
+#define AUTOTUNE_MEAS_CYCLES 4
+
+typedef enum AUTOTUNE_Loop_t
+{
+	AUTOTUNE_VEL_LOOP = 0x00,
+	AUTOTUNE_POS_LOOP = 0x01,
+} AUTOTUNE_Loop_t;
+
+typedef enum AUTOTUNE_State_t
+{
+	AUTOTUNE_IDLE_STATE = 0x00,
+	AUTOTUNE_RELAY_STATE = 0x01,
+	AUTOTUNE_DONE_STATE = 0x02,
+	AUTOTUNE_FAIL_STATE = 0x03,
+} AUTOTUNE_State_t;
+
+typedef enum AUTOTUNE_Rule_t
+{
+	/* Ziegler-Nichols */
+	AUTOTUNE_ZN_PI_RULE = 0x00,
+	AUTOTUNE_ZN_PID_RULE = 0x01,
+	/* Tyreus-Luyben, less overshoot and more robust than Ziegler-Nichols */
+	AUTOTUNE_TL_PI_RULE = 0x02,
+	AUTOTUNE_TL_PID_RULE = 0x03,
+} AUTOTUNE_Rule_t;
+
+typedef struct AUTOTUNE_t
+{
+	MOTOR_t *motor;
+	AUTOTUNE_Loop_t loop;
+	AUTOTUNE_State_t state;
+	/* Mode of motor before the experiment, restored at its end */
+	MOTOR_Mode_t mode;
+
+	/* Sample time of the control tick in second */
+	float dt;
+
+	float sp;
+	float bias;
+	float amp;
+	float hyst;
+	float out;
+
+	unsigned int tick;
+	unsigned int timeout;
+	unsigned int rise_tick;
+	int cycles;
+
+	float fbk_max;
+	float fbk_min;
+	float sum_period;
+	float sum_amp;
+
+	/* Ultimate gain and period */
+	float ku;
+	float tu;
+
+	/* Gain of the discrete controller in pid.c */
+	float kp;
+	float ki;
+	float kd;
+
+} AUTOTUNE_t;
+
+void AUTOTUNE_init(AUTOTUNE_t *at, MOTOR_t *motor, AUTOTUNE_Loop_t loop, float dt);
+
+int AUTOTUNE_start(AUTOTUNE_t *at, float sp, float bias, float amp, float hyst, float timeout);
+
+AUTOTUNE_State_t AUTOTUNE_calc(AUTOTUNE_t *at);
+
+void AUTOTUNE_abort(AUTOTUNE_t *at);
+
+int AUTOTUNE_apply(AUTOTUNE_t *at, AUTOTUNE_Rule_t rule);
+
+AUTOTUNE_State_t AUTOTUNE_get_state(AUTOTUNE_t *at);
+
+#endif
@@ -0,0 +1,155 @@
+/**
+	* @File:	dob.c
+	* @Author:	Chunyu Zhang
+	* @Version:	V0.0.1
+	* @Date:	2026.10.19
+	* @Description:	Disturbance observer of the joints. The current commanded is compared
+	*		with the current predicted by the inverse model of the joint from the
+	*		measured velocity, and the difference is low-pass filtered into an estimate
+	*		of the external torque. It needs no torque sensor and no extra bus reads,
+	*		and the estimate is used for contact detection.
+	*/
+
+#include "math.h"
+#include "dob.h"
+
+/**
+	* @Function:	Initializing the structure member of disturbance observer
+	* @Parameter:	- *dob:		pointer of disturbance observer structure
+					- inertia:	inertia of joint, current per unit of acceleration
+					- damping:	viscous damping of joint, current per unit of velocity
+					- bw:		bandwidth of the estimate in rad/s
+					- dt:		period of control tick in second
+	* @Return:		none
+	* @Attention:	The model is in the unit of the current command like the feedforward model,
+					so the estimate is a current too. Divide it by the torque constant for torque.
+					The bandwidth trades noise against delay, it should stay well below the
+					sample rate. Contact detection is disabled until the thresholds are set.
+					With inertia and damping both 0 there is no model, and the estimate stays 0
+					instead of being the filtered command.
+*/
+void DOB_init(DOB_t *dob, float inertia, float damping, float bw, float dt)
+{
+	dob->inertia = inertia;
+	dob->damping = damping;
+	dob->model = (inertia != 0.0f || damping != 0.0f);
+	dob->bw = bw;
+	dob->alpha = 1.0f - expf(-bw * dt);
+
+	dob->z = 0.0f;
+	dob->out = 0.0f;
+
+	dob->th_on = 0.0f;
+	dob->th_off = 0.0f;
+	dob->contact = 0;
+}
+
+/**
+	* @Function:	Setting the thresholds of contact detection
+	* @Parameter:	- *dob:		pointer of disturbance observer structure
+					- th_on:	magnitude of the estimate above which the contact starts
+					- th_off:	magnitude of the estimate below which the contact ends
+	* @Return:		none
+	* @Attention:	th_off should be smaller than th_on. Setting th_on to 0 disables the detection.
+*/
+void DOB_set_contact_th(DOB_t *dob, float th_on, float th_off)
+{
+	dob->th_on = th_on;
+	dob->th_off = th_off;
+}
+
+/**
+	* @Function:	Resetting the estimate to zero
+	* @Parameter:	- *dob:		pointer of disturbance observer structure
+					- vel:		present velocity of joint
+	* @Return:		none
+	* @Attention:	none
+*/
+void DOB_reset(DOB_t *dob, float vel)
+{
+	dob->z = dob->bw * dob->inertia * vel;
+	dob->out = 0.0f;
+	dob->contact = 0;
+}
+
+/**
+	* @Function:	Running the disturbance observer of one joint
+	* @Parameter:	- *dob:		pointer of disturbance observer structure
+					- cmd:		current command which is not explained by a model, i.e. without the
+								friction and gravity feedforward
+					- vel:		measured velocity of joint
+	* @Return:		estimate of external torque as current
+	* @Attention:	d = LPF(cmd - b * vel - J * acc) is computed without differentiating the velocity:
+					z = LPF(cmd - b * vel + bw * J * vel), d = z - bw * J * vel.
+*/
+float DOB_calc(DOB_t *dob, float cmd, float vel)
+{
+	float jv = dob->bw * dob->inertia * vel;
+	float mag;
+
+	if (!dob->model)
+		return dob->out;
+
+	dob->z += dob->alpha * (cmd - dob->damping * vel + jv - dob->z);
+	dob->out = dob->z - jv;
+
+	if (dob->th_on > 0.0f)
+	{
+		mag = fabsf(dob->out);
+		if (mag > dob->th_on)
+			dob->contact = 1;
+		else if (mag < dob->th_off)
+			dob->contact = 0;
+	}
+
+	return dob->out;
+}
+
+/**
+	* @Function:	Running the disturbance observers of several joints
+	* @Parameter:	- *dob:		array of disturbance observer structures
+					- *motor:	array of motor structures
+					- num:		number of joints
+	* @Return:		none
+	* @Attention:	The command is the last output of the current loop minus the model feedforward
+					set by MOTOR_set_cur_ffd(), and the velocity is the feedback of the velocity loop.
+					Call it every tick after MOTOR_set_fbk() and before MOTOR_calc(), so the
+					command is the one applied during the tick just measured. Call it before
+					FFD_calc_batch(), which replaces the model feedforward of the command.
+					The current is not known while the loops are in the driver, so the observer
+					of such a joint is reset and restarts when the loops come back.
+*/
+void DOB_calc_batch(DOB_t *dob, MOTOR_t *motor, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+	{
+		if (MOTOR_get_exec(&motor[i]) == MOTOR_EXEC_LOCAL)
+			DOB_calc(&dob[i], MOTOR_get_cmd(&motor[i]) - motor[i].pid_cur.ffd, motor[i].pid_vel.fbk);
+		else
+			DOB_reset(&dob[i], motor[i].pid_vel.fbk);
+	}
+}
+
+/**
+	* @Function:	Getting estimate of external torque
+	* @Parameter:	- *dob:		pointer of disturbance observer structure
+	* @Return:		estimate of external torque as current
+	* @Attention:	The sign is the one of the current needed to balance the external torque.
+*/
+float DOB_get_out(DOB_t *dob)
+{
+	return dob->out;
+}
+
+/**
+	* @Function:	Getting contact state of joint
+	* @Parameter:	- *dob:		pointer of disturbance observer structure
+	* @Return:		1 for contact and 0 for free
+	* @Attention:	none
+*/
+int DOB_get_contact(DOB_t *dob)
+{
+	return dob->contact;
+}
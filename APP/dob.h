@@ -0,0 +1,44 @@
+#ifndef _DOB_H
+#define _DOB_H
+
+#include "motor.h"
+
+typedef struct DOB_t
+{
+	/* Inverse model J * acc + b * vel, in the unit of the current command */
+	float inertia;
+	float damping;
+	/* Whether a model is set, without it the estimate stays 0 */
+	unsigned char model;
+
+	/* Bandwidth in rad/s and the filter coefficient of it */
+	float bw;
+	float alpha;
+
+	/* Output of the low-pass filter */
+	float z;
+	/* Estimate of external torque, in the unit of the current command */
+	float out;
+
+	/* Thresholds of contact detection with hysteresis */
+	float th_on;
+	float th_off;
+	unsigned char contact;
+
+} DOB_t;
+
+void DOB_init(DOB_t *dob, float inertia, float damping, float bw, float dt);
+
+void DOB_set_contact_th(DOB_t *dob, float th_on, float th_off);
+
+void DOB_reset(DOB_t *dob, float vel);
+
+float DOB_calc(DOB_t *dob, float cmd, float vel);
+
+void DOB_calc_batch(DOB_t *dob, MOTOR_t *motor, int num);
+
+float DOB_get_out(DOB_t *dob);
+
+int DOB_get_contact(DOB_t *dob);
+
+#endif
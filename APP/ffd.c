@@ -0,0 +1,231 @@
+/**
+	* @File:	ffd.c
+	* @Author:	Chunyu Zhang
+	* @Version:	V0.0.1
+	* @Date:	2026.10.19
+	* @Description:	Joint friction and gravity feedforward. The model gives the current
+	*		needed to overcome Coulomb and viscous friction and to hold the load
+	*		against gravity, and it is fed to the current loop so that the PID
+	*		integrators only have to deal with the model error.
+	*/
+
+#include "math.h"
+#include "kin.h"
+#include "ffd.h"
+
+static void FFD_regressor(float vel, float ang, float vel_eps, float *phi)
+{
+	float sgn = vel / vel_eps;
+
+	sgn = (sgn > 1.0f) ? 1.0f : sgn;
+	sgn = (sgn < -1.0f) ? -1.0f : sgn;
+
+	phi[0] = sgn;
+	phi[1] = vel;
+	KIN_sincos(ang, &phi[3], &phi[2]);
+}
+
+/**
+	* @Function:	Initializing the structure member of feedforward model
+	* @Parameter:	- *ffd:		pointer of feedforward structure
+					- kc:		Coulomb friction
+					- kv:		viscous friction per unit of velocity
+					- kgc:		gravity coefficient of cos(ang)
+					- kgs:		gravity coefficient of sin(ang)
+					- vel_eps:	velocity band where the Coulomb friction changes its sign
+	* @Return:		none
+	* @Attention:	All coefficients are in the unit of the current command, so the model can be
+					identified directly from logged current without the torque constant.
+					vel_eps must be positive, it avoids chattering at standstill.
+*/
+void FFD_init(FFD_t *ffd, float kc, float kv, float kgc, float kgs, float vel_eps)
+{
+	ffd->kc = kc;
+	ffd->kv = kv;
+	ffd->kgc = kgc;
+	ffd->kgs = kgs;
+	ffd->vel_eps = vel_eps;
+	ffd->out = 0.0f;
+}
+
+/**
+	* @Function:	Calculating the feedforward of one joint
+	* @Parameter:	- *ffd:		pointer of feedforward structure
+					- vel:		velocity of joint
+					- ang:		configuration angle of the link in radian, which is 0 when the gravity
+								torque is given by kgc only, e.g. hip angle plus knee angle for the shank
+	* @Return:		feedforward current
+	* @Attention:	none
+*/
+float FFD_calc(FFD_t *ffd, float vel, float ang)
+{
+	float phi[FFD_PARA_NUM];
+
+	FFD_regressor(vel, ang, ffd->vel_eps, phi);
+	ffd->out = ffd->kc * phi[0] + ffd->kv * phi[1] + ffd->kgc * phi[2] + ffd->kgs * phi[3];
+
+	return ffd->out;
+}
+
+/**
+	* @Function:	Calculating the feedforward of several joints and feeding the current loops
+	* @Parameter:	- *ffd:		array of feedforward structures
+					- *motor:	array of motor structures
+					- *ang:		array of configuration angles in radian
+					- num:		number of joints
+	* @Return:		none
+	* @Attention:	The velocity is taken from the feedback of velocity loop, so call it every tick
+					after MOTOR_set_fbk() and before MOTOR_calc().
+					The loop has no branch, the M4 FPU is scalar, so this is as wide as it gets.
+*/
+void FFD_calc_batch(FFD_t *ffd, MOTOR_t *motor, const float *ang, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		MOTOR_set_cur_ffd(&motor[i], FFD_calc(&ffd[i], motor[i].pid_vel.fbk, ang[i]));
+}
+
+/**
+	* @Function:	Getting output of feedforward model
+	* @Parameter:	- *ffd:		pointer of feedforward structure
+	* @Return:		feedforward current
+	* @Attention:	none
+*/
+float FFD_get_out(FFD_t *ffd)
+{
+	return ffd->out;
+}
+
+/**
+	* @Function:	Initializing the least squares identification
+	* @Parameter:	- *id:		pointer of identification structure
+					- vel_eps:	velocity band of Coulomb friction, same as the one of model
+	* @Return:		none
+	* @Attention:	none
+*/
+void FFD_ident_init(FFD_Ident_t *id, float vel_eps)
+{
+	int i, j;
+
+	id->vel_eps = vel_eps;
+	id->num = 0;
+
+	for (i = 0; i < FFD_PARA_NUM; i++)
+	{
+		for (j = 0; j < FFD_PARA_NUM; j++)
+			id->a[i][j] = 0.0;
+		id->b[i] = 0.0;
+	}
+}
+
+/**
+	* @Function:	Adding a logged sample to the identification
+	* @Parameter:	- *id:		pointer of identification structure
+					- vel:		velocity of joint
+					- ang:		configuration angle in radian
+					- cur:		current command or feedback
+	* @Return:		none
+	* @Attention:	The model has no inertia, so only samples with small acceleration should be
+					added, e.g. from slow sweeps at constant velocity in both directions over the
+					range of the joint. The sums are in double, which the M4 does in software,
+					so it costs some us per sample: add samples only while identifying.
+*/
+void FFD_ident_add(FFD_Ident_t *id, float vel, float ang, float cur)
+{
+	float phi[FFD_PARA_NUM];
+	int i, j;
+
+	FFD_regressor(vel, ang, id->vel_eps, phi);
+
+	for (i = 0; i < FFD_PARA_NUM; i++)
+	{
+		for (j = i; j < FFD_PARA_NUM; j++)
+			id->a[i][j] += (double)phi[i] * phi[j];
+		id->b[i] += (double)phi[i] * cur;
+	}
+	id->num++;
+}
+
+/**
+	* @Function:	Solving the identification and writing the result to the model
+	* @Parameter:	- *id:		pointer of identification structure
+					- *ffd:		pointer of feedforward structure
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		samples are not rich enough to determine all parameters
+	* @Attention:	The normal equation is scaled to a unit diagonal first, so each column of the
+					regressor counts the same whatever its unit, e.g. the velocity against the
+					sin/cos of the gravity. Then it is solved by Gaussian elimination with partial
+					pivoting in double. A pivot below FFD_IDENT_PIVOT means that a column is
+					explained by the others within that fraction, e.g. no sweep in one direction
+					or no motion over the range of the angle, and the model is not touched.
+					The samples are kept, so more samples can be added and solved again.
+*/
+int FFD_ident_solve(FFD_Ident_t *id, FFD_t *ffd)
+{
+	double a[FFD_PARA_NUM][FFD_PARA_NUM + 1];
+	double d[FFD_PARA_NUM];
+	double x[FFD_PARA_NUM];
+	double tmp, scale;
+	int i, j, k, piv;
+
+	if (id->num < FFD_PARA_NUM)
+		return -1;
+
+	/* Only the upper triangle is summed */
+	for (i = 0; i < FFD_PARA_NUM; i++)
+	{
+		if (id->a[i][i] <= 0.0)
+			return -1;
+		d[i] = sqrt(id->a[i][i]);
+	}
+	for (i = 0; i < FFD_PARA_NUM; i++)
+	{
+		for (j = 0; j < FFD_PARA_NUM; j++)
+			a[i][j] = ((i <= j) ? id->a[i][j] : id->a[j][i]) / (d[i] * d[j]);
+		a[i][FFD_PARA_NUM] = id->b[i] / d[i];
+	}
+
+	for (k = 0; k < FFD_PARA_NUM; k++)
+	{
+		piv = k;
+		for (i = k + 1; i < FFD_PARA_NUM; i++)
+		{
+			if (fabs(a[i][k]) > fabs(a[piv][k]))
+				piv = i;
+		}
+		if (fabs(a[piv][k]) < FFD_IDENT_PIVOT)
+			return -1;
+
+		for (j = k; j <= FFD_PARA_NUM; j++)
+		{
+			tmp = a[k][j];
+			a[k][j] = a[piv][j];
+			a[piv][j] = tmp;
+		}
+
+		for (i = k + 1; i < FFD_PARA_NUM; i++)
+		{
+			scale = a[i][k] / a[k][k];
+			for (j = k; j <= FFD_PARA_NUM; j++)
+				a[i][j] -= scale * a[k][j];
+		}
+	}
+
+	for (i = FFD_PARA_NUM - 1; i >= 0; i--)
+	{
+		tmp = a[i][FFD_PARA_NUM];
+		for (j = i + 1; j < FFD_PARA_NUM; j++)
+			tmp -= a[i][j] * x[j];
+		x[i] = tmp / a[i][i];
+	}
+
+	ffd->kc = (float)(x[0] / d[0]);
+	ffd->kv = (float)(x[1] / d[1]);
+	ffd->kgc = (float)(x[2] / d[2]);
+	ffd->kgs = (float)(x[3] / d[3]);
+	ffd->vel_eps = id->vel_eps;
+
+	return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef _FFD_H
+#define _FFD_H
+
+#include "motor.h"
+
+/* Number of model parameters: Coulomb, viscous, gravity cos, gravity sin */
+#define FFD_PARA_NUM 4
+/* Smallest pivot of the scaled normal equation, below it the samples do not determine the model */
+#define FFD_IDENT_PIVOT 1e-6
+
+typedef struct FFD_t
+{
+	/* Coulomb friction */
+	float kc;
+	/* Viscous friction per unit of velocity */
+	float kv;
+	/* Gravity at configuration angle: kgc * cos(ang) + kgs * sin(ang) */
+	float kgc;
+	float kgs;
+
+	/* Velocity band where the Coulomb friction changes its sign linearly */
+	float vel_eps;
+
+	float out;
+
+} FFD_t;
+
+typedef struct FFD_Ident_t
+{
+	float vel_eps;
+	unsigned int num;
+
+	/* Normal equation A * x = b of the least squares problem, in double since the velocity
+	   column is orders of magnitude above the others and the sums run over many samples */
+	double a[FFD_PARA_NUM][FFD_PARA_NUM];
+	double b[FFD_PARA_NUM];
+
+} FFD_Ident_t;
+
+void FFD_init(FFD_t *ffd, float kc, float kv, float kgc, float kgs, float vel_eps);
+
+float FFD_calc(FFD_t *ffd, float vel, float ang);
+
+void FFD_calc_batch(FFD_t *ffd, MOTOR_t *motor, const float *ang, int num);
+
+float FFD_get_out(FFD_t *ffd);
+
+void FFD_ident_init(FFD_Ident_t *id, float vel_eps);
+
+void FFD_ident_add(FFD_Ident_t *id, float vel, float ang, float cur);
+
+int FFD_ident_solve(FFD_Ident_t *id, FFD_t *ffd);
+
+#endif
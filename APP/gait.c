@@ -0,0 +1,267 @@
+/**
+	* @File:	gait.c
+	* @Author:	Chunyu Zhang
+	* @Version:	V0.0.1
+	* @Date:	2026.10.19
+	* @Description:	Gait pattern generator. A phase clock schedules stance and swing of
+	*		each leg by the duty factor and the phase offsets of the gait. The feet
+	*		slide backwards with the commanded body velocity in stance and follow a
+	*		cycloid to the next foothold in swing. The foot targets are converted to
+	*		joint angles every tick, so the gait timing does not depend on the link
+	*		to the upper computer.
+	*/
+
+#include "gait.h"
+
+#define GAIT_2PI 6.28318531f
+
+/* Fraction of the cycle in stance, by gait type */
+static const float GAIT_duty[GAIT_TYPE_NUM] = {1.0f, 0.75f, 0.5f, 0.5f};
+
+/* Phase offsets of LF, RF, LH and RH, by gait type */
+static const float GAIT_offset[GAIT_TYPE_NUM][LEG_NUM] =
+{
+	{0.0f, 0.0f, 0.0f, 0.0f},
+	/* Lateral sequence LF, RH, RF, LH */
+	{0.75f, 0.25f, 0.0f, 0.5f},
+	/* Diagonal pairs */
+	{0.0f, 0.5f, 0.5f, 0.0f},
+	/* Lateral pairs */
+	{0.0f, 0.5f, 0.0f, 0.5f},
+};
+
+static void GAIT_load(GAIT_t *gait, GAIT_Type_t type)
+{
+	int i;
+
+	gait->type = type;
+	gait->duty = GAIT_duty[type];
+	for (i = 0; i < LEG_NUM; i++)
+		gait->offset[i] = GAIT_offset[type][i];
+}
+
+/**
+	* @Function:	Initializing the structure member of gait generator
+	* @Parameter:	- *gait:	pointer of gait generator structure
+					- dt:		period of control tick in second
+					- period:	period of gait cycle in second
+					- height:	height of swing
+	* @Return:		none
+	* @Attention:	The gait generator starts standing. The legs must be set by GAIT_set_leg().
+*/
+void GAIT_init(GAIT_t *gait, float dt, float period, float height)
+{
+	int i, j;
+
+	gait->dt = dt;
+	gait->period = period;
+	gait->phase = 0.0f;
+	gait->height = height;
+	gait->next = GAIT_STAND;
+	GAIT_load(gait, GAIT_STAND);
+
+	gait->vx = 0.0f;
+	gait->vy = 0.0f;
+	gait->wz = 0.0f;
+
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		gait->hip_x[i] = 0.0f;
+		gait->hip_y[i] = 0.0f;
+		gait->sched_swing[i] = 0;
+		gait->contact[i] = 1;
+		gait->swing[i] = 0.0f;
+		gait->swing_rate[i] = 0.0f;
+		gait->t_st[i] = 0.0f;
+		gait->td[0][i] = 0.0f;
+		gait->td[1][i] = 0.0f;
+
+		for (j = 0; j < 3; j++)
+		{
+			gait->p0[j][i] = 0.0f;
+			gait->lift[j][i] = 0.0f;
+			gait->p[j][i] = 0.0f;
+		}
+	}
+}
+
+/**
+	* @Function:	Setting the placement of a leg
+	* @Parameter:	- *gait:	pointer of gait generator structure
+					- leg:		index of leg
+					- hip_x:	position of hip to body center, forward
+					- hip_y:	position of hip to body center, left
+					- *p0:		nominal foot position in the frame at hip
+	* @Return:		none
+	* @Attention:	The foot target is moved to the nominal position, so call it while standing.
+*/
+void GAIT_set_leg(GAIT_t *gait, int leg, float hip_x, float hip_y, const float *p0)
+{
+	int j;
+
+	gait->hip_x[leg] = hip_x;
+	gait->hip_y[leg] = hip_y;
+
+	for (j = 0; j < 3; j++)
+	{
+		gait->p0[j][leg] = p0[j];
+		gait->p[j][leg] = p0[j];
+	}
+}
+
+/**
+	* @Function:	Requesting a gait
+	* @Parameter:	- *gait:	pointer of gait generator structure
+					- type:		gait type
+	* @Return:		none
+	* @Attention:	The gait is changed when the phase wraps around, and a leg in swing always
+					finishes its swing, so the change is smooth.
+					Standing holds the feet where they are, so command zero velocity for one cycle
+					before standing to bring the feet back to the nominal position.
+*/
+void GAIT_set_type(GAIT_t *gait, GAIT_Type_t type)
+{
+	gait->next = type;
+}
+
+/**
+	* @Function:	Setting the period of gait cycle
+	* @Parameter:	- *gait:	pointer of gait generator structure
+					- period:	period of gait cycle in second
+	* @Return:		none
+	* @Attention:	A swing in progress keeps its duration and foothold.
+*/
+void GAIT_set_period(GAIT_t *gait, float period)
+{
+	gait->period = period;
+}
+
+/**
+	* @Function:	Setting the body velocity command
+	* @Parameter:	- *gait:	pointer of gait generator structure
+					- vx:		forward velocity
+					- vy:		lateral velocity, left is positive
+					- wz:		yaw rate in radian per second, counterclockwise is positive
+	* @Return:		none
+	* @Attention:	It is ignored while standing.
+*/
+void GAIT_set_cmd(GAIT_t *gait, float vx, float vy, float wz)
+{
+	gait->vx = vx;
+	gait->vy = vy;
+	gait->wz = wz;
+}
+
+/**
+	* @Function:	Running the gait generator for one tick
+	* @Parameter:	- *gait:	pointer of gait generator structure
+					- *geom:	pointer of geometry structure
+					- q:		joint angles in radian
+	* @Return:		bit mask of the legs whose foot target is out of reach, 0 if all are reachable
+	* @Attention:	The stance foot moves against the velocity of the body at the foot, which
+					includes the yaw rate. The swing foot aims at the foothold half a stance length
+					ahead of the nominal position, so the stance is centered on it. The foothold is
+					fixed at lift-off from the command then, because the velocity at the swinging
+					foot moves with the foot when turning, so a new command takes effect at the next
+					step. A swing in progress keeps the timing and the foothold it started with,
+					also when the gait or the period changes.
+					Swing: s = sigma - sin(2 * pi * sigma) / (2 * pi),
+					h = height * (1 - cos(2 * pi * sigma)) / 2, which start and end at zero velocity.
+*/
+int GAIT_calc(GAIT_t *gait, const KIN_Geom_t *geom, float q[LEG_JOINT_NUM][LEG_NUM])
+{
+	float vb[2], ph, sn, cs, s;
+	int i, j, sched;
+
+	gait->phase += gait->dt / gait->period;
+	if (gait->phase >= 1.0f)
+	{
+		gait->phase -= 1.0f;
+		if (gait->next != gait->type)
+			GAIT_load(gait, gait->next);
+	}
+
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		/* Velocity of the body at the foot */
+		if (gait->type == GAIT_STAND)
+		{
+			vb[0] = 0.0f;
+			vb[1] = 0.0f;
+		}
+		else
+		{
+			vb[0] = gait->vx - gait->wz * (gait->hip_y[i] + gait->p[1][i]);
+			vb[1] = gait->vy + gait->wz * (gait->hip_x[i] + gait->p[0][i]);
+		}
+
+		/* Lift-off at the start of the swing window of the schedule */
+		ph = gait->phase + gait->offset[i];
+		ph = (ph >= 1.0f) ? ph - 1.0f : ph;
+		sched = (gait->type != GAIT_STAND && ph >= gait->duty);
+
+		if (sched && !gait->sched_swing[i] && gait->contact[i])
+		{
+			gait->contact[i] = 0;
+			gait->swing[i] = 0.0f;
+			gait->swing_rate[i] = gait->dt / ((1.0f - gait->duty) * gait->period);
+			gait->t_st[i] = gait->duty * gait->period;
+			for (j = 0; j < 3; j++)
+				gait->lift[j][i] = gait->p[j][i];
+			gait->td[0][i] = gait->p0[0][i] + 0.5f * gait->t_st[i] * vb[0];
+			gait->td[1][i] = gait->p0[1][i] + 0.5f * gait->t_st[i] * vb[1];
+		}
+		gait->sched_swing[i] = sched;
+
+		if (gait->contact[i])
+		{
+			gait->p[0][i] -= vb[0] * gait->dt;
+			gait->p[1][i] -= vb[1] * gait->dt;
+			gait->p[2][i] = gait->p0[2][i];
+			continue;
+		}
+
+		gait->swing[i] += gait->swing_rate[i];
+		if (gait->swing[i] >= 1.0f)
+		{
+			/* Touch-down */
+			gait->contact[i] = 1;
+			gait->p[0][i] = gait->td[0][i];
+			gait->p[1][i] = gait->td[1][i];
+			gait->p[2][i] = gait->p0[2][i];
+			continue;
+		}
+
+		KIN_sincos(GAIT_2PI * gait->swing[i], &sn, &cs);
+		s = gait->swing[i] - sn / GAIT_2PI;
+
+		gait->p[0][i] = gait->lift[0][i] + (gait->td[0][i] - gait->lift[0][i]) * s;
+		gait->p[1][i] = gait->lift[1][i] + (gait->td[1][i] - gait->lift[1][i]) * s;
+		gait->p[2][i] = gait->lift[2][i] + (gait->p0[2][i] - gait->lift[2][i]) * s + 0.5f * gait->height * (1.0f - cs);
+	}
+
+	return KIN_ik(geom, (const float (*)[LEG_NUM])gait->p, q);
+}
+
+/**
+	* @Function:	Getting the gait being run
+	* @Parameter:	- *gait:	pointer of gait generator structure
+	* @Return:		gait type
+	* @Attention:	none
+*/
+GAIT_Type_t GAIT_get_type(GAIT_t *gait)
+{
+	return gait->type;
+}
+
+/**
+	* @Function:	Getting the contact state of a leg scheduled by the gait
+	* @Parameter:	- *gait:	pointer of gait generator structure
+					- leg:		index of leg
+	* @Return:		1 for stance and 0 for swing
+	* @Attention:	none
+*/
+int GAIT_get_contact(GAIT_t *gait, int leg)
+{
+	return gait->contact[leg];
+}
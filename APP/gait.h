@@ -0,0 +1,83 @@
+#ifndef _GAIT_H
+#define _GAIT_H
+
+#include "kin.h"
+
+/* Index of the legs */
+#define GAIT_LF 0
+#define GAIT_RF 1
+#define GAIT_LH 2
+#define GAIT_RH 3
+
+typedef enum GAIT_Type_t
+{
+	GAIT_STAND = 0x00,
+	GAIT_WALK = 0x01,
+	GAIT_TROT = 0x02,
+	GAIT_PACE = 0x03,
+} GAIT_Type_t;
+
+#define GAIT_TYPE_NUM 4
+
+/* Structure of arrays, the last index is always the leg */
+typedef struct GAIT_t
+{
+	GAIT_Type_t type;
+	GAIT_Type_t next;
+
+	/* Sample time of the control tick and period of gait cycle in second */
+	float dt;
+	float period;
+	/* Phase of gait cycle in [0, 1) */
+	float phase;
+	/* Fraction of the cycle in stance */
+	float duty;
+	float offset[LEG_NUM];
+	/* Height of swing */
+	float height;
+
+	/* Command of body velocity and yaw rate */
+	float vx;
+	float vy;
+	float wz;
+
+	/* Position of the hips to the body center */
+	float hip_x[LEG_NUM];
+	float hip_y[LEG_NUM];
+	/* Nominal foot position in the frame at hip */
+	float p0[3][LEG_NUM];
+
+	/* Whether the schedule asked for swing in the last tick */
+	unsigned char sched_swing[LEG_NUM];
+	unsigned char contact[LEG_NUM];
+	/* Progress of swing in [0, 1) and its speed per tick */
+	float swing[LEG_NUM];
+	float swing_rate[LEG_NUM];
+	/* Stance time of the gait at lift-off, which places the foothold */
+	float t_st[LEG_NUM];
+	float lift[3][LEG_NUM];
+	/* Foothold of x and y, fixed at lift-off */
+	float td[2][LEG_NUM];
+
+	/* Foot targets in the frame at hip */
+	float p[3][LEG_NUM];
+
+} GAIT_t;
+
+void GAIT_init(GAIT_t *gait, float dt, float period, float height);
+
+void GAIT_set_leg(GAIT_t *gait, int leg, float hip_x, float hip_y, const float *p0);
+
+void GAIT_set_type(GAIT_t *gait, GAIT_Type_t type);
+
+void GAIT_set_period(GAIT_t *gait, float period);
+
+void GAIT_set_cmd(GAIT_t *gait, float vx, float vy, float wz);
+
+int GAIT_calc(GAIT_t *gait, const KIN_Geom_t *geom, float q[LEG_JOINT_NUM][LEG_NUM]);
+
+GAIT_Type_t GAIT_get_type(GAIT_t *gait);
+
+int GAIT_get_contact(GAIT_t *gait, int leg);
+
+#endif
@@ -0,0 +1,166 @@
+/**
+	* @File:	imp.c
+	* @Author:	Chunyu Zhang
+	* @Version:	V0.0.1
+	* @Date:	2026.10.19
+	* @Description:	Cartesian impedance controller of the feet. The foot behaves like a
+	*		spring and damper towards its target, F = K * dx + D * dv + F_ff, and the
+	*		force is mapped to the joint torques by the transposed Jacobian. It is meant
+	*		to run every control tick for all legs, so the planner only has to send
+	*		targets and gains instead of closing the loop over the serial link. It needs
+	*		LEG_NUM * LEG_JOINT_NUM joints on the bus, so ctrl_task does not call it on
+	*		the single joint bench.
+	*/
+
+#include "imp.h"
+
+/**
+	* @Function:	Initializing the structure member of impedance controller
+	* @Parameter:	- *imp:		pointer of impedance controller structure
+	* @Return:		none
+	* @Attention:	All gains and targets are zero, so the legs are limp until they are set.
+					The joint scales are 1 and the offsets are 0.
+*/
+void IMP_init(IMP_t *imp)
+{
+	int i, j;
+
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			imp->kp[j][i] = 0.0f;
+			imp->kd[j][i] = 0.0f;
+			imp->p_des[j][i] = 0.0f;
+			imp->v_des[j][i] = 0.0f;
+			imp->f_ffd[j][i] = 0.0f;
+			imp->v[j][i] = 0.0f;
+			imp->f[j][i] = 0.0f;
+		}
+		for (j = 0; j < LEG_JOINT_NUM; j++)
+		{
+			imp->q_scale[j][i] = 1.0f;
+			imp->q_ofs[j][i] = 0.0f;
+			imp->qd_scale[j][i] = 1.0f;
+			imp->cur_scale[j][i] = 1.0f;
+			imp->qd[j][i] = 0.0f;
+			imp->tau[j][i] = 0.0f;
+		}
+	}
+}
+
+/**
+	* @Function:	Setting the conversion between a motor and its joint
+	* @Parameter:	- *imp:		pointer of impedance controller structure
+					- leg:		index of leg
+					- joint:	index of joint in the leg, KIN_ABD, KIN_HIP or KIN_KNEE
+					- q_scale:	joint angle in radian per unit of position feedback
+					- q_ofs:	joint angle in radian when the position feedback is 0
+					- qd_scale:	joint velocity in radian per second per unit of velocity feedback
+					- cur_scale:	current command per joint torque, i.e. 1 / (torque constant * gear ratio)
+	* @Return:		none
+	* @Attention:	The scales also carry the sign when the motor turns against the joint axis.
+*/
+void IMP_set_joint(IMP_t *imp, int leg, int joint, float q_scale, float q_ofs, float qd_scale, float cur_scale)
+{
+	imp->q_scale[joint][leg] = q_scale;
+	imp->q_ofs[joint][leg] = q_ofs;
+	imp->qd_scale[joint][leg] = qd_scale;
+	imp->cur_scale[joint][leg] = cur_scale;
+}
+
+/**
+	* @Function:	Setting stiffness and damping of a foot
+	* @Parameter:	- *imp:		pointer of impedance controller structure
+					- leg:		index of leg
+					- *kp:		stiffness of x, y and z
+					- *kd:		damping of x, y and z
+	* @Return:		none
+	* @Attention:	The gains are diagonal in the frame at hip.
+*/
+void IMP_set_gain(IMP_t *imp, int leg, const float *kp, const float *kd)
+{
+	int j;
+
+	for (j = 0; j < 3; j++)
+	{
+		imp->kp[j][leg] = kp[j];
+		imp->kd[j][leg] = kd[j];
+	}
+}
+
+/**
+	* @Function:	Setting target of a foot
+	* @Parameter:	- *imp:		pointer of impedance controller structure
+					- leg:		index of leg
+					- *p:		target position of x, y and z
+					- *v:		target velocity of x, y and z, or 0 for none
+					- *f:		feedforward force of x, y and z, or 0 for none
+	* @Return:		none
+	* @Attention:	none
+*/
+void IMP_set_target(IMP_t *imp, int leg, const float *p, const float *v, const float *f)
+{
+	int j;
+
+	for (j = 0; j < 3; j++)
+	{
+		imp->p_des[j][leg] = p[j];
+		imp->v_des[j][leg] = v ? v[j] : 0.0f;
+		imp->f_ffd[j][leg] = f ? f[j] : 0.0f;
+	}
+}
+
+/**
+	* @Function:	Running the impedance controller of all legs for one tick
+	* @Parameter:	- *imp:		pointer of impedance controller structure
+					- *geom:	pointer of geometry structure
+					- *legs:	pointer of legs structure, used as the workspace of kinematics
+					- *motor:	array of LEG_NUM * LEG_JOINT_NUM motor structures, leg by leg
+	* @Return:		bit mask of the legs with a joint which is not in impedance mode
+	* @Attention:	The joint feedback is taken from the position and velocity loops, so call it
+					every tick after MOTOR_set_fbk() and before MOTOR_calc().
+					The foot velocity is J * qd and the joint torque is J^T * F, both with the
+					Jacobian of the same tick. Joints in another mode are not commanded.
+*/
+unsigned int IMP_calc(IMP_t *imp, const KIN_Geom_t *geom, KIN_Legs_t *legs, MOTOR_t *motor)
+{
+	MOTOR_t *m;
+	unsigned int err = 0;
+	int i, j;
+
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		for (j = 0; j < LEG_JOINT_NUM; j++)
+		{
+			m = &motor[i * LEG_JOINT_NUM + j];
+			legs->q[j][i] = m->pid_pos.fbk * imp->q_scale[j][i] + imp->q_ofs[j][i];
+			imp->qd[j][i] = m->pid_vel.fbk * imp->qd_scale[j][i];
+		}
+	}
+
+	KIN_fk(geom, legs);
+	KIN_jac(geom, legs);
+
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			imp->v[j][i] = legs->jac[KIN_J(j, 0)][i] * imp->qd[0][i] + legs->jac[KIN_J(j, 1)][i] * imp->qd[1][i] + legs->jac[KIN_J(j, 2)][i] * imp->qd[2][i];
+			imp->f[j][i] = imp->kp[j][i] * (imp->p_des[j][i] - legs->p[j][i]) + imp->kd[j][i] * (imp->v_des[j][i] - imp->v[j][i]) + imp->f_ffd[j][i];
+		}
+	}
+
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		for (j = 0; j < LEG_JOINT_NUM; j++)
+		{
+			imp->tau[j][i] = legs->jac[KIN_J(0, j)][i] * imp->f[0][i] + legs->jac[KIN_J(1, j)][i] * imp->f[1][i] + legs->jac[KIN_J(2, j)][i] * imp->f[2][i];
+
+			if (MOTOR_imp_mode(&motor[i * LEG_JOINT_NUM + j], imp->tau[j][i] * imp->cur_scale[j][i]) != 0)
+				err |= 1u << i;
+		}
+	}
+
+	return err;
+}
@@ -0,0 +1,42 @@
+#ifndef _IMP_H
+#define _IMP_H
+
+#include "motor.h"
+#include "kin.h"
+
+/* Structure of arrays, the last index is always the leg */
+typedef struct IMP_t
+{
+	/* Diagonal stiffness and damping in the frame at hip */
+	float kp[3][LEG_NUM];
+	float kd[3][LEG_NUM];
+
+	float p_des[3][LEG_NUM];
+	float v_des[3][LEG_NUM];
+	float f_ffd[3][LEG_NUM];
+
+	/* Joint feedback = motor feedback * scale + offset, in radian and radian per second */
+	float q_scale[LEG_JOINT_NUM][LEG_NUM];
+	float q_ofs[LEG_JOINT_NUM][LEG_NUM];
+	float qd_scale[LEG_JOINT_NUM][LEG_NUM];
+	/* Current command per joint torque */
+	float cur_scale[LEG_JOINT_NUM][LEG_NUM];
+
+	float qd[LEG_JOINT_NUM][LEG_NUM];
+	float v[3][LEG_NUM];
+	float f[3][LEG_NUM];
+	float tau[LEG_JOINT_NUM][LEG_NUM];
+
+} IMP_t;
+
+void IMP_init(IMP_t *imp);
+
+void IMP_set_joint(IMP_t *imp, int leg, int joint, float q_scale, float q_ofs, float qd_scale, float cur_scale);
+
+void IMP_set_gain(IMP_t *imp, int leg, const float *kp, const float *kd);
+
+void IMP_set_target(IMP_t *imp, int leg, const float *p, const float *v, const float *f);
+
+unsigned int IMP_calc(IMP_t *imp, const KIN_Geom_t *geom, KIN_Legs_t *legs, MOTOR_t *motor);
+
+#endif
@@ -0,0 +1,287 @@
+/**
+	* @File:	interp.c
+	* @Author:	Chunyu Zhang
+	* @Version:	V0.0.1
+	* @Date:	2026.10.19
+	* @Description:	Setpoint interpolation for commands coming from the upper computer
+	*		at a lower rate than the control loop. Timestamped waypoints are buffered
+	*		per joint and connected by cubic Hermite splines, which are evaluated
+	*		every control tick.
+	*/
+
+#include "interp.h"
+
+#define INTERP_US_TO_S 0.000001f
+
+static INTERP_Point_t *INTERP_at(INTERP_t *interp, int idx)
+{
+	return &interp->buf[(interp->head + idx) % INTERP_BUF_LEN];
+}
+
+static int INTERP_append(INTERP_t *interp, unsigned int t, float pos, float vel, unsigned char fixed)
+{
+	INTERP_Point_t *last, *prev, *pnt;
+
+	if (interp->cnt > 0)
+	{
+		/* Waypoints older than the newest one are out of order */
+		last = INTERP_at(interp, interp->cnt - 1);
+		if ((int)(t - last->t) <= 0)
+		{
+			interp->late_cnt++;
+			return -1;
+		}
+	}
+	if (interp->state != INTERP_IDLE_STATE && (int)(t - interp->t_eval) <= 0)
+	{
+		/* Waypoints which have already passed are useless */
+		interp->late_cnt++;
+		return -1;
+	}
+
+	if (interp->state == INTERP_EXTRAP_STATE || interp->state == INTERP_HOLD_STATE)
+	{
+		/* Restart the spline from the reference which is being output */
+		interp->head = 0;
+		interp->cnt = 1;
+		interp->buf[0].t = interp->t_eval;
+		interp->buf[0].pos = interp->pos;
+		interp->buf[0].vel = interp->vel;
+		interp->buf[0].fixed = 1;
+	}
+
+	if (interp->cnt >= INTERP_BUF_LEN)
+	{
+		interp->ovf_cnt++;
+		return -1;
+	}
+
+	pnt = INTERP_at(interp, interp->cnt);
+	pnt->t = t;
+	pnt->pos = pos;
+	pnt->vel = vel;
+	pnt->fixed = fixed;
+
+	if (!fixed && interp->cnt >= 1)
+	{
+		/* The newest tangent is a backward difference until the next waypoint arrives */
+		last = INTERP_at(interp, interp->cnt - 1);
+		pnt->vel = (pos - last->pos) / ((t - last->t) * INTERP_US_TO_S);
+
+		/* Catmull-Rom tangent for the waypoint before, unless it ends the segment being
+		   evaluated, whose shape must not change under the reference */
+		if (!last->fixed && interp->cnt >= 2 &&
+			(interp->cnt >= 3 || (int)(interp->t_eval - INTERP_at(interp, 0)->t) < 0))
+		{
+			prev = INTERP_at(interp, interp->cnt - 2);
+			last->vel = (pos - prev->pos) / ((t - prev->t) * INTERP_US_TO_S);
+		}
+	}
+
+	interp->cnt++;
+
+	return 0;
+}
+
+/**
+	* @Function:	Initializing the structure member of interpolator
+	* @Parameter:	- *interp:	pointer of interpolator structure
+					- t_extrap:	maxinum time to extrapolate after the last waypoint in microsecond
+	* @Return:		none
+	* @Attention:	none
+*/
+void INTERP_init(INTERP_t *interp, unsigned int t_extrap)
+{
+	interp->state = INTERP_IDLE_STATE;
+	interp->head = 0;
+	interp->cnt = 0;
+	interp->t_extrap = t_extrap;
+	interp->t_eval = 0;
+
+	interp->pos = 0.0f;
+	interp->vel = 0.0f;
+	interp->acc = 0.0f;
+
+	interp->late_cnt = 0;
+	interp->ovf_cnt = 0;
+	interp->underrun_cnt = 0;
+}
+
+/**
+	* @Function:	Clearing the buffer and starting from a standstill position
+	* @Parameter:	- *interp:	pointer of interpolator structure
+					- t:		current time in microsecond
+					- pos:		position where the joint stands
+	* @Return:		none
+	* @Attention:	The standstill position is the first waypoint, so the joint moves smoothly
+					to the first waypoint received from upstream.
+*/
+void INTERP_reset(INTERP_t *interp, unsigned int t, float pos)
+{
+	interp->state = INTERP_IDLE_STATE;
+	interp->head = 0;
+	interp->cnt = 0;
+	interp->t_eval = t;
+
+	interp->pos = pos;
+	interp->vel = 0.0f;
+	interp->acc = 0.0f;
+
+	INTERP_append(interp, t, pos, 0.0f, 1);
+}
+
+/**
+	* @Function:	Pushing a waypoint received from upstream
+	* @Parameter:	- *interp:	pointer of interpolator structure
+					- t:		timestamp of waypoint in microsecond
+					- pos:		position of waypoint
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		waypoint is discarded because it is late or the buffer is full
+	* @Attention:	The velocity at the waypoint is estimated by Catmull-Rom, so the tangent of a
+					waypoint is final only after the next waypoint arrives. The tangent of the
+					waypoint ending the segment being evaluated is not changed any more, it keeps
+					the backward difference. Timestamps should lead the local time by at least one
+					upstream period to make use of Catmull-Rom.
+					Time is compared by signed difference, so the counter may wrap around.
+*/
+int INTERP_push(INTERP_t *interp, unsigned int t, float pos)
+{
+	return INTERP_append(interp, t, pos, 0.0f, 0);
+}
+
+/**
+	* @Function:	Pushing a waypoint with velocity received from upstream
+	* @Parameter:	- *interp:	pointer of interpolator structure
+					- t:		timestamp of waypoint in microsecond
+					- pos:		position of waypoint
+					- vel:		velocity of waypoint
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		waypoint is discarded because it is late or the buffer is full
+	* @Attention:	none
+*/
+int INTERP_push_pv(INTERP_t *interp, unsigned int t, float pos, float vel)
+{
+	return INTERP_append(interp, t, pos, vel, 1);
+}
+
+/**
+	* @Function:	Evaluating the reference at current time
+	* @Parameter:	- *interp:	pointer of interpolator structure
+					- t:		current time in microsecond
+	* @Return:		none
+	* @Attention:	Between two waypoints the reference follows the cubic Hermite spline.
+					After the last waypoint the reference is extrapolated with the last velocity
+					for t_extrap, then it holds still. A waypoint arriving after that continues
+					from the reference being output, so there is no jump.
+*/
+void INTERP_calc(INTERP_t *interp, unsigned int t)
+{
+	INTERP_Point_t *p0, *p1;
+	float h, s, s2, s3, m0, m1;
+	unsigned int dt;
+
+	interp->t_eval = t;
+
+	if (interp->cnt == 0)
+		return;
+
+	/* Dropping the segments which have passed */
+	while (interp->cnt >= 2 && (int)(t - INTERP_at(interp, 1)->t) >= 0)
+	{
+		interp->head = (interp->head + 1) % INTERP_BUF_LEN;
+		interp->cnt--;
+	}
+
+	p0 = INTERP_at(interp, 0);
+
+	if ((int)(t - p0->t) < 0)
+	{
+		/* Waiting for the first waypoint */
+		interp->pos = p0->pos;
+		interp->vel = 0.0f;
+		interp->acc = 0.0f;
+		return;
+	}
+
+	if (interp->cnt >= 2)
+	{
+		p1 = INTERP_at(interp, 1);
+
+		h = (p1->t - p0->t) * INTERP_US_TO_S;
+		s = (t - p0->t) * INTERP_US_TO_S / h;
+		s2 = s * s;
+		s3 = s2 * s;
+		m0 = p0->vel * h;
+		m1 = p1->vel * h;
+
+		interp->pos = (2 * s3 - 3 * s2 + 1) * p0->pos + (s3 - 2 * s2 + s) * m0 + (-2 * s3 + 3 * s2) * p1->pos + (s3 - s2) * m1;
+		interp->vel = ((6 * s2 - 6 * s) * p0->pos + (3 * s2 - 4 * s + 1) * m0 + (-6 * s2 + 6 * s) * p1->pos + (3 * s2 - 2 * s) * m1) / h;
+		interp->acc = ((12 * s - 6) * p0->pos + (6 * s - 4) * m0 + (-12 * s + 6) * p1->pos + (6 * s - 2) * m1) / (h * h);
+		interp->state = INTERP_TRACK_STATE;
+		return;
+	}
+
+	/* Underrun: no waypoint ahead, which only counts if it cuts the tracking short */
+	dt = t - p0->t;
+	if (dt <= interp->t_extrap)
+	{
+		if (interp->state == INTERP_TRACK_STATE)
+			interp->underrun_cnt++;
+		interp->pos = p0->pos + p0->vel * dt * INTERP_US_TO_S;
+		interp->vel = p0->vel;
+		interp->state = INTERP_EXTRAP_STATE;
+	}
+	else
+	{
+		interp->pos = p0->pos + p0->vel * interp->t_extrap * INTERP_US_TO_S;
+		interp->vel = 0.0f;
+		interp->state = INTERP_HOLD_STATE;
+	}
+	interp->acc = 0.0f;
+}
+
+/**
+	* @Function:	Getting position reference
+	* @Parameter:	- *interp:	pointer of interpolator structure
+	* @Return:		position reference
+	* @Attention:	none
+*/
+float INTERP_get_pos(INTERP_t *interp)
+{
+	return interp->pos;
+}
+
+/**
+	* @Function:	Getting velocity reference
+	* @Parameter:	- *interp:	pointer of interpolator structure
+	* @Return:		velocity reference
+	* @Attention:	none
+*/
+float INTERP_get_vel(INTERP_t *interp)
+{
+	return interp->vel;
+}
+
+/**
+	* @Function:	Getting acceleration reference
+	* @Parameter:	- *interp:	pointer of interpolator structure
+	* @Return:		acceleration reference
+	* @Attention:	none
+*/
+float INTERP_get_acc(INTERP_t *interp)
+{
+	return interp->acc;
+}
+
+/**
+	* @Function:	Getting state of interpolator
+	* @Parameter:	- *interp:	pointer of interpolator structure
+	* @Return:		state of interpolator
+	* @Attention:	none
+*/
+INTERP_State_t INTERP_get_state(INTERP_t *interp)
+{
+	return interp->state;
+}
@@ -0,0 +1,67 @@
+#ifndef _INTERP_H
+#define _INTERP_H
+
+/* Number of waypoints buffered per joint */
+#define INTERP_BUF_LEN 8
+
+typedef enum INTERP_State_t
+{
+	INTERP_IDLE_STATE = 0x00,
+	INTERP_TRACK_STATE = 0x01,
+	INTERP_EXTRAP_STATE = 0x02,
+	INTERP_HOLD_STATE = 0x03,
+} INTERP_State_t;
+
+typedef struct INTERP_Point_t
+{
+	/* Timestamp in microsecond */
+	unsigned int t;
+	float pos;
+	float vel;
+	/* The velocity is given by upstream and will not be re-estimated */
+	unsigned char fixed;
+} INTERP_Point_t;
+
+typedef struct INTERP_t
+{
+	INTERP_State_t state;
+
+	/* Queue, where the oldest waypoint is at index head */
+	INTERP_Point_t buf[INTERP_BUF_LEN];
+	unsigned char head;
+	unsigned char cnt;
+
+	/* Maxinum time to extrapolate after the last waypoint in microsecond */
+	unsigned int t_extrap;
+	/* Time of the last evaluation */
+	unsigned int t_eval;
+
+	float pos;
+	float vel;
+	float acc;
+
+	unsigned int late_cnt;
+	unsigned int ovf_cnt;
+	unsigned int underrun_cnt;
+
+} INTERP_t;
+
+void INTERP_init(INTERP_t *interp, unsigned int t_extrap);
+
+void INTERP_reset(INTERP_t *interp, unsigned int t, float pos);
+
+int INTERP_push(INTERP_t *interp, unsigned int t, float pos);
+
+int INTERP_push_pv(INTERP_t *interp, unsigned int t, float pos, float vel);
+
+void INTERP_calc(INTERP_t *interp, unsigned int t);
+
+float INTERP_get_pos(INTERP_t *interp);
+
+float INTERP_get_vel(INTERP_t *interp);
+
+float INTERP_get_acc(INTERP_t *interp);
+
+INTERP_State_t INTERP_get_state(INTERP_t *interp);
+
+#endif
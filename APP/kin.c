@@ -0,0 +1,240 @@
+/**
+	* @File:	kin.c
+	* @Author:	Chunyu Zhang
+	* @Version:	V0.0.1
+	* @Date:	2026.10.19
+	* @Description:	Leg kinematics for the hip-abduction/hip/knee legs. Forward kinematics,
+	*		closed-form inverse kinematics and the 3x3 Jacobian are evaluated for all
+	*		four legs in one call. The data is kept as structure of arrays so that each
+	*		loop runs the same instructions over the legs.
+	*		Cycle budget: forward kinematics, Jacobian and inverse kinematics of all
+	*		legs together within 20us (3360 cycles at 168MHz).
+	*/
+
+#include "math.h"
+#include "kin.h"
+
+#define KIN_PI 3.14159265f
+#define KIN_2_PI 0.63661977f
+/* pi / 2 split into a part exact in float and the rest, for range reduction */
+#define KIN_PI_2_HI 1.5703125f
+#define KIN_PI_2_LO 4.8382679e-4f
+/* Relative rounding error tolerated before a foot is out of reach */
+#define KIN_REACH_EPS 1e-5f
+
+/**
+	* @Function:	Calculating sine and cosine together
+	* @Parameter:	- x:	angle in radian
+					- *s:	sine of the angle
+					- *c:	cosine of the angle
+	* @Return:		none
+	* @Attention:	The angle is reduced to [-pi/4, pi/4] around a multiple of pi/2, where Taylor
+					polynomials of degree 7 and 8 keep the error below 4e-7 for |x| <= 100.
+					It is several times faster than sinf() plus cosf() of the library.
+*/
+void KIN_sincos(float x, float *s, float *c)
+{
+	float k, r, r2, ps, pc;
+	int quad;
+
+	k = x * KIN_2_PI;
+	k = (k >= 0.0f) ? (float)(int)(k + 0.5f) : (float)(int)(k - 0.5f);
+	quad = (int)k;
+	r = (x - k * KIN_PI_2_HI) - k * KIN_PI_2_LO;
+	r2 = r * r;
+
+	ps = r * (1.0f + r2 * (-1.0f / 6 + r2 * (1.0f / 120 + r2 * (-1.0f / 5040))));
+	pc = 1.0f + r2 * (-0.5f + r2 * (1.0f / 24 + r2 * (-1.0f / 720 + r2 * (1.0f / 40320))));
+
+	switch (quad & 3)
+	{
+	case 0:
+		*s = ps;
+		*c = pc;
+		break;
+	case 1:
+		*s = pc;
+		*c = -ps;
+		break;
+	case 2:
+		*s = -ps;
+		*c = -pc;
+		break;
+	default:
+		*s = -pc;
+		*c = ps;
+		break;
+	}
+}
+
+/**
+	* @Function:	Calculating arc tangent of y / x in four quadrants
+	* @Parameter:	- y:	ordinate
+					- x:	abscissa
+	* @Return:		angle in radian in [-pi, pi]
+	* @Attention:	The ratio is reduced to [0, 1] and a minimax polynomial of degree 11 is used,
+					the error is below 2e-6 rad. It returns 0 when both x and y are 0.
+*/
+float KIN_atan2(float y, float x)
+{
+	float ax = fabsf(x), ay = fabsf(y);
+	float mx = (ax > ay) ? ax : ay;
+	float mn = (ax > ay) ? ay : ax;
+	float t, t2, r;
+
+	if (mx == 0.0f)
+		return 0.0f;
+
+	t = mn / mx;
+	t2 = t * t;
+	r = t * (0.99997726f + t2 * (-0.33262347f + t2 * (0.19354346f + t2 * (-0.11643287f + t2 * (0.05265332f + t2 * (-0.01172120f))))));
+
+	r = (ay > ax) ? 0.5f * KIN_PI - r : r;
+	r = (x < 0.0f) ? KIN_PI - r : r;
+	r = (y < 0.0f) ? -r : r;
+
+	return r;
+}
+
+/**
+	* @Function:	Setting the geometry of a leg
+	* @Parameter:	- *geom:	pointer of geometry structure
+					- leg:		index of leg
+					- l1:		offset of abduction axis to hip, positive for left and negative for right
+					- l2:		length of thigh
+					- l3:		length of shank
+					- knee:		bending direction of knee, 1 or -1
+	* @Return:		none
+	* @Attention:	With all joints at 0, the leg points straight down: foot at (0, l1, -l2 - l3).
+*/
+void KIN_set_geom(KIN_Geom_t *geom, int leg, float l1, float l2, float l3, float knee)
+{
+	geom->l1[leg] = l1;
+	geom->l2[leg] = l2;
+	geom->l3[leg] = l3;
+	geom->knee[leg] = (knee < 0.0f) ? -1.0f : 1.0f;
+}
+
+/**
+	* @Function:	Forward kinematics of all legs
+	* @Parameter:	- *geom:	pointer of geometry structure
+					- *legs:	pointer of legs structure, q is the input and p is the output
+	* @Return:		none
+	* @Attention:	x = -l2 * s1 - l3 * s12
+					y = l1 * c0 + d * s0
+					z = l1 * s0 - d * c0, where d = l2 * c1 + l3 * c12
+*/
+void KIN_fk(const KIN_Geom_t *geom, KIN_Legs_t *legs)
+{
+	float d;
+	int i;
+
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		KIN_sincos(legs->q[KIN_ABD][i], &legs->s0[i], &legs->c0[i]);
+		KIN_sincos(legs->q[KIN_HIP][i], &legs->s1[i], &legs->c1[i]);
+		KIN_sincos(legs->q[KIN_HIP][i] + legs->q[KIN_KNEE][i], &legs->s12[i], &legs->c12[i]);
+	}
+
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		d = geom->l2[i] * legs->c1[i] + geom->l3[i] * legs->c12[i];
+
+		legs->p[0][i] = -geom->l2[i] * legs->s1[i] - geom->l3[i] * legs->s12[i];
+		legs->p[1][i] = geom->l1[i] * legs->c0[i] + d * legs->s0[i];
+		legs->p[2][i] = geom->l1[i] * legs->s0[i] - d * legs->c0[i];
+	}
+}
+
+/**
+	* @Function:	Jacobian of all legs
+	* @Parameter:	- *geom:	pointer of geometry structure
+					- *legs:	pointer of legs structure, jac is the output
+	* @Return:		none
+	* @Attention:	It uses the trigonometric values and the foot position of the last KIN_fk(),
+					which must be called with the same joint angles before.
+*/
+void KIN_jac(const KIN_Geom_t *geom, KIN_Legs_t *legs)
+{
+	float d, l3s12, l3c12;
+	int i;
+
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		l3s12 = geom->l3[i] * legs->s12[i];
+		l3c12 = geom->l3[i] * legs->c12[i];
+		d = geom->l2[i] * legs->c1[i] + l3c12;
+
+		legs->jac[KIN_J(0, 0)][i] = 0.0f;
+		legs->jac[KIN_J(0, 1)][i] = -geom->l2[i] * legs->c1[i] - l3c12;
+		legs->jac[KIN_J(0, 2)][i] = -l3c12;
+
+		legs->jac[KIN_J(1, 0)][i] = -geom->l1[i] * legs->s0[i] + d * legs->c0[i];
+		legs->jac[KIN_J(1, 1)][i] = legs->s0[i] * legs->p[0][i];
+		legs->jac[KIN_J(1, 2)][i] = -l3s12 * legs->s0[i];
+
+		legs->jac[KIN_J(2, 0)][i] = legs->p[1][i];
+		legs->jac[KIN_J(2, 1)][i] = -legs->c0[i] * legs->p[0][i];
+		legs->jac[KIN_J(2, 2)][i] = l3s12 * legs->c0[i];
+	}
+}
+
+/**
+	* @Function:	Inverse kinematics of all legs
+	* @Parameter:	- *geom:	pointer of geometry structure
+					- p:		foot positions in the frame at hip
+					- q:		joint angles in radian
+	* @Return:		bit mask of the legs whose foot position is out of reach, 0 if all are reachable
+	* @Attention:	A foot out of reach is moved to the nearest reachable point, so the joint angles
+					are always valid, a foot within the rounding of the boundary is not flagged.
+					The bending direction of knee is given by the geometry.
+					KIN_atan2() is used instead of atan2f(), four times per leg, which keeps
+					the whole solution in a few hundred cycles per leg.
+*/
+int KIN_ik(const KIN_Geom_t *geom, const float p[3][LEG_NUM], float q[LEG_JOINT_NUM][LEG_NUM])
+{
+	float x, y, z, l1, l2, l3, d2, d, c2, s2, q0;
+	int i, err = 0;
+
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		x = p[0][i];
+		y = p[1][i];
+		z = p[2][i];
+		l1 = geom->l1[i];
+		l2 = geom->l2[i];
+		l3 = geom->l3[i];
+
+		/* Abduction: (y, z) is (l1, -d) rotated by q0 */
+		d2 = y * y + z * z - l1 * l1;
+		if (d2 < 0.0f)
+		{
+			/* A foot right under the abduction axis is reachable, up to the rounding */
+			if (d2 < -KIN_REACH_EPS * l1 * l1)
+				err |= 1 << i;
+			d2 = 0.0f;
+		}
+		d = sqrtf(d2);
+
+		q0 = KIN_atan2(z, y) + KIN_atan2(d, l1);
+		q0 = (q0 > KIN_PI) ? q0 - 2.0f * KIN_PI : q0;
+		q0 = (q0 < -KIN_PI) ? q0 + 2.0f * KIN_PI : q0;
+
+		/* Knee: law of cosines in the leg plane */
+		c2 = (x * x + d2 - l2 * l2 - l3 * l3) / (2.0f * l2 * l3);
+		if (c2 > 1.0f || c2 < -1.0f)
+		{
+			if (c2 > 1.0f + KIN_REACH_EPS || c2 < -1.0f - KIN_REACH_EPS)
+				err |= 1 << i;
+			c2 = (c2 > 1.0f) ? 1.0f : -1.0f;
+		}
+		s2 = geom->knee[i] * sqrtf(1.0f - c2 * c2);
+
+		/* Hip: (d, -x) is (l2 + l3 * c2, l3 * s2) rotated by q1 */
+		q[KIN_ABD][i] = q0;
+		q[KIN_HIP][i] = KIN_atan2(-x, d) - KIN_atan2(l3 * s2, l2 + l3 * c2);
+		q[KIN_KNEE][i] = KIN_atan2(s2, c2);
+	}
+
+	return err;
+}
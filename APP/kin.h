@@ -0,0 +1,60 @@
+#ifndef _KIN_H
+#define _KIN_H
+
+#define LEG_NUM 4
+#define LEG_JOINT_NUM 3
+
+/* Index of the joints of a leg */
+#define KIN_ABD 0
+#define KIN_HIP 1
+#define KIN_KNEE 2
+
+/* Index of the entries of row-major 3x3 Jacobian */
+#define KIN_J(row, col) ((row) * 3 + (col))
+
+typedef struct KIN_Geom_t
+{
+	/* Offset of the abduction axis to the hip, positive for left legs and negative for right legs */
+	float l1[LEG_NUM];
+	/* Length of thigh */
+	float l2[LEG_NUM];
+	/* Length of shank */
+	float l3[LEG_NUM];
+	/* Bending direction of knee chosen by inverse kinematics, 1 or -1 */
+	float knee[LEG_NUM];
+
+} KIN_Geom_t;
+
+/* Structure of arrays, the last index is always the leg */
+typedef struct KIN_Legs_t
+{
+	/* Joint angles in radian */
+	float q[LEG_JOINT_NUM][LEG_NUM];
+	/* Foot position in the frame at hip, x forward, y left, z up */
+	float p[3][LEG_NUM];
+	/* Jacobian of foot position by joint angles */
+	float jac[9][LEG_NUM];
+
+	/* Trigonometric values of the last forward kinematics, reused by the Jacobian */
+	float s0[LEG_NUM];
+	float c0[LEG_NUM];
+	float s1[LEG_NUM];
+	float c1[LEG_NUM];
+	float s12[LEG_NUM];
+	float c12[LEG_NUM];
+
+} KIN_Legs_t;
+
+void KIN_sincos(float x, float *s, float *c);
+
+float KIN_atan2(float y, float x);
+
+void KIN_set_geom(KIN_Geom_t *geom, int leg, float l1, float l2, float l3, float knee);
+
+void KIN_fk(const KIN_Geom_t *geom, KIN_Legs_t *legs);
+
+void KIN_jac(const KIN_Geom_t *geom, KIN_Legs_t *legs);
+
+int KIN_ik(const KIN_Geom_t *geom, const float p[3][LEG_NUM], float q[LEG_JOINT_NUM][LEG_NUM]);
+
+#endif
@@ -0,0 +1,190 @@
+/**
+	* @File:	lqr.c
+	* @Author:	Chunyu Zhang
+	* @Version:	V0.0.1
+	* @Date:	2026.10.19
+	* @Description:	Discrete state feedback controller of the joints. The state is the
+	*		error of position, the error of velocity and the integral of the position
+	*		error, and the current is the inner product of the state with the gains.
+	*		The gains are the discrete LQR solution of the identified joint model,
+	*		computed offline by TOOLS/lqr_gain.py and loaded as a constant table.
+	*/
+
+#include "lqr.h"
+
+/**
+	* @Function:	Initializing the structure member of state feedback controller
+	* @Parameter:	- *lqr:		pointer of state feedback controller structure
+					- *gain:	pointer of gains, usually an entry of the table generated offline
+					- dt:		period of control tick in second, the same as the one of the table
+	* @Return:		none
+	* @Attention:	The gains are only read, so several joints of the same type can share an entry.
+					The output is not limited until the limit is set.
+*/
+void LQR_init(LQR_t *lqr, const LQR_Gain_t *gain, float dt)
+{
+	lqr->gain = gain;
+	lqr->dt = dt;
+	lqr->kvel = 1.0f;
+
+	lqr->pos_ref = 0.0f;
+	lqr->vel_ref = 0.0f;
+	lqr->ffd = 0.0f;
+	lqr->integ = 0.0f;
+
+	lqr->max = 0.0f;
+	lqr->min = 0.0f;
+	lqr->out = 0.0f;
+}
+
+/**
+	* @Function:	Setting limit of the output
+	* @Parameter:	- *lqr:		pointer of state feedback controller structure
+					- max:		maxinum output of current
+					- min:		mininum output of current
+	* @Return:		none
+	* @Attention:	If abs(max - min) < 0.01, it will be consider that there is no limit for output.
+					The integral stops while the output is limited, like the regular PID.
+*/
+void LQR_set_limit(LQR_t *lqr, float max, float min)
+{
+	lqr->max = max;
+	lqr->min = min;
+}
+
+/**
+	* @Function:	Setting the scale of the velocity feedback
+	* @Parameter:	- *lqr:		pointer of state feedback controller structure
+					- kvel:		velocity of the velocity loop per unit of position per second
+	* @Return:		none
+	* @Attention:	The model of the gains has the velocity as the derivative of the position, so
+					LQR_start() and LQR_calc_batch() divide the feedback of the velocity loop by it.
+					The reference and LQR_calc() are in the unit of the position per second.
+					It is 1 after LQR_init().
+*/
+void LQR_set_vel_scale(LQR_t *lqr, float kvel)
+{
+	lqr->kvel = kvel;
+}
+
+/**
+	* @Function:	Setting reference of the joint
+	* @Parameter:	- *lqr:		pointer of state feedback controller structure
+					- pos:		reference of position
+					- vel:		reference of velocity
+					- ffd:		feedforward of current
+	* @Return:		none
+	* @Attention:	The velocity reference should be the derivative of the position reference,
+					e.g. from the trajectory generator, otherwise the two terms fight each other.
+*/
+void LQR_set_ref(LQR_t *lqr, float pos, float vel, float ffd)
+{
+	lqr->pos_ref = pos;
+	lqr->vel_ref = vel;
+	lqr->ffd = ffd;
+}
+
+/**
+	* @Function:	Switching a motor to state feedback mode without a bump
+	* @Parameter:	- *lqr:		pointer of state feedback controller structure
+					- *motor:	pointer of motor structure
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		the loops of the motor are in the driver, see MOTOR_set_mode()
+	* @Attention:	The reference is set to the present feedback and the integral to the value
+					which gives the last current command, so the joint holds where it is.
+					Call it after MOTOR_set_fbk() of the tick.
+*/
+int LQR_start(LQR_t *lqr, MOTOR_t *motor)
+{
+	float cmd = MOTOR_get_cmd(motor) - motor->pid_cur.ffd;
+
+	if (MOTOR_set_mode(motor, MOTOR_STATE_FEEDBACK_MODE) != 0)
+		return -1;
+
+	lqr->pos_ref = motor->pid_pos.fbk;
+	lqr->vel_ref = motor->pid_vel.fbk / lqr->kvel;
+	lqr->ffd = 0.0f;
+	lqr->integ = (lqr->gain->ki != 0.0f) ? cmd / lqr->gain->ki : 0.0f;
+	lqr->out = cmd;
+
+	return 0;
+}
+
+/**
+	* @Function:	Calculating the output of one joint
+	* @Parameter:	- *lqr:		pointer of state feedback controller structure
+					- pos:		feedback of position
+					- vel:		feedback of velocity
+	* @Return:		current command
+	* @Attention:	The output uses the integral of the last tick, then the integral is updated,
+					which is the order assumed by the offline design.
+*/
+float LQR_calc(LQR_t *lqr, float pos, float vel)
+{
+	const LQR_Gain_t *k = lqr->gain;
+	float ep = lqr->pos_ref - pos;
+	float ev = lqr->vel_ref - vel;
+	float out;
+
+	out = k->kp * ep + k->kv * ev + k->ki * lqr->integ + lqr->ffd;
+
+	if (lqr->max - lqr->min >= 0.01f && out > lqr->max)
+	{
+		out = lqr->max;
+		if (ep < 0)
+			lqr->integ += ep * lqr->dt;
+	}
+	else if (lqr->max - lqr->min >= 0.01f && out < lqr->min)
+	{
+		out = lqr->min;
+		if (ep > 0)
+			lqr->integ += ep * lqr->dt;
+	}
+	else
+		lqr->integ += ep * lqr->dt;
+
+	lqr->out = out;
+
+	return out;
+}
+
+/**
+	* @Function:	Calculating the output of several joints and commanding the current loops
+	* @Parameter:	- *lqr:		array of state feedback controller structures
+					- *motor:	array of motor structures
+					- num:		number of joints, up to 32
+	* @Return:		bit mask of the joints which are not in state feedback mode
+	* @Attention:	The feedback is taken from the position and velocity loops, the velocity scaled
+					by LQR_set_vel_scale(), so call it every tick after MOTOR_set_fbk() and before
+					MOTOR_calc(). Joints in another mode are
+					skipped, so their integral does not wind up.
+*/
+unsigned int LQR_calc_batch(LQR_t *lqr, MOTOR_t *motor, int num)
+{
+	unsigned int err = 0;
+	int i;
+
+	for (i = 0; i < num; i++)
+	{
+		if (motor[i].mode != MOTOR_STATE_FEEDBACK_MODE)
+		{
+			err |= 1u << i;
+			continue;
+		}
+		MOTOR_sf_mode(&motor[i], LQR_calc(&lqr[i], motor[i].pid_pos.fbk, motor[i].pid_vel.fbk / lqr[i].kvel));
+	}
+
+	return err;
+}
+
+/**
+	* @Function:	Getting output of state feedback controller
+	* @Parameter:	- *lqr:		pointer of state feedback controller structure
+	* @Return:		current command
+	* @Attention:	none
+*/
+float LQR_get_out(LQR_t *lqr)
+{
+	return lqr->out;
+}
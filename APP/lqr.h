@@ -0,0 +1,55 @@
+#ifndef _LQR_H
+#define _LQR_H
+
+#include "motor.h"
+
+/* Gains of u = kp * (pos_ref - pos) + kv * (vel_ref - vel) + ki * integral, from TOOLS/lqr_gain.py */
+typedef struct LQR_Gain_t
+{
+	float kp;
+	float kv;
+	float ki;
+} LQR_Gain_t;
+
+/* Gains of the joint types of the robot, generated into APP/lqr_table.c */
+extern const LQR_Gain_t LQR_gain_table[];
+
+typedef struct LQR_t
+{
+	const LQR_Gain_t *gain;
+
+	/* Sample time of the control tick in second */
+	float dt;
+	/* Velocity of the velocity loop per unit of position per second */
+	float kvel;
+
+	float pos_ref;
+	float vel_ref;
+	float ffd;
+
+	/* Integral of position error */
+	float integ;
+
+	float max;
+	float min;
+	float out;
+
+} LQR_t;
+
+void LQR_init(LQR_t *lqr, const LQR_Gain_t *gain, float dt);
+
+void LQR_set_limit(LQR_t *lqr, float max, float min);
+
+void LQR_set_vel_scale(LQR_t *lqr, float kvel);
+
+void LQR_set_ref(LQR_t *lqr, float pos, float vel, float ffd);
+
+int LQR_start(LQR_t *lqr, MOTOR_t *motor);
+
+float LQR_calc(LQR_t *lqr, float pos, float vel);
+
+unsigned int LQR_calc_batch(LQR_t *lqr, MOTOR_t *motor, int num);
+
+float LQR_get_out(LQR_t *lqr);
+
+#endif
@@ -0,0 +1,8 @@
+/* Generated by TOOLS/lqr_gain.py, dt = 0.001 s, Q = diag(1000, 1, 100000), R = 1 */
+#include "lqr.h"
+
+const LQR_Gain_t LQR_gain_table[1] =
+{
+	/* J = 0.02, b = 0.1 */
+	{4.3970097e+01f, 1.5383479e+00f, 3.0397096e+02f},
+};
@@ -9,6 +9,24 @@
 
 #include "motor.h"
 
+static int MOTOR_exec_valid(MOTOR_Mode_t mode, MOTOR_Exec_t exec, int fbk_div)
+{
+	switch (exec)
+	{
+	case MOTOR_EXEC_LOCAL:
+		return 1;
+	case MOTOR_EXEC_ACTR_VEL:
+		/* The position loop stays on the MCU, so it needs the feedback of every tick */
+		if (mode == MOTOR_POSITION_MODE || mode == MOTOR_POSITION_VELOCITY_MODE)
+			return fbk_div <= 1;
+		return mode == MOTOR_VELOCITY_MODE;
+	case MOTOR_EXEC_ACTR_POS:
+		return mode == MOTOR_POSITION_MODE || mode == MOTOR_POSITION_VELOCITY_MODE;
+	default:
+		return 0;
+	}
+}
+
 /**
 	* @Function:	Initializing the structure member of motor
 	* @Parameter:	- *motor:	pointer of motor structure
@@ -22,6 +40,9 @@
 void MOTOR_init(MOTOR_t* motor, MOTOR_Mode_t mode)
 {
 	motor->mode = mode;
+	motor->exec = MOTOR_EXEC_LOCAL;
+	motor->fbk_div = 1;
+	motor->fbk_cnt = 0;
 
 	PID_init(&motor->pid_cur, PID_INCREMENT_MODE, 1.0f, 0.0f, 0.0f);
 	PID_init(&motor->pid_vel, PID_REGULAR_MODE, 1.0f, 0.0f, 0.0f);
@@ -32,10 +53,23 @@ void MOTOR_init(MOTOR_t* motor, MOTOR_Mode_t mode)
 	* @Function:	Calculating the control command of motor
 	* @Parameter:	- *motor:	pointer of motor structure
 	* @Return:		none
-	* @Attention:	none
+	* @Attention:	The loops which are delegated to the driver are not calculated, see
+					MOTOR_set_exec().
 */
 void MOTOR_calc(MOTOR_t* motor)
 {
+	if (motor->exec == MOTOR_EXEC_ACTR_POS)
+		return;
+	if (motor->exec == MOTOR_EXEC_ACTR_VEL)
+	{
+		if (motor->mode != MOTOR_VELOCITY_MODE)
+		{
+			PID_calc(&motor->pid_pos);
+			PID_set_in(&motor->pid_vel, PID_get_out(&motor->pid_pos));
+		}
+		return;
+	}
+
 	switch (motor->mode)
 	{
 	case MOTOR_POSITION_MODE:
@@ -49,6 +83,8 @@ void MOTOR_calc(MOTOR_t* motor)
 		PID_calc(&motor->pid_vel);
 		PID_set_in(&motor->pid_cur, PID_get_out(&motor->pid_vel));
 	case MOTOR_CURRENT_MODE:
+	case MOTOR_IMPEDANCE_MODE:
+	case MOTOR_STATE_FEEDBACK_MODE:
 		PID_calc(&motor->pid_cur);
 		break;
 	default:
@@ -60,16 +96,146 @@ void MOTOR_calc(MOTOR_t* motor)
 	* @Function:	Setting the mode of motor
 	* @Parameter:	- *motor:	pointer of motor structure
 					- mode:		mode of motor
-	* @Return:		none
-	* @Attention:	none
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		the mode cannot run where the loops are, the mode is not changed
+	* @Attention:	The transfer is bumpless. The loops used by the new mode are initialized from
+					the present feedback and the last command: the position and velocity loops
+					start with zero error and the output holding the present velocity and current,
+					and the current loop starts from the last current command. So the command stays
+					the same until the new setpoint moves it, a loop without I keeps its output at
+					the transfer as a bias, see PID_set_state(). The feedforward given by the mode
+					commands is cleared, the model feedforward of current is kept. The loops not
+					used are cleared.
+					Call it after MOTOR_set_fbk() of the tick, so the feedback is fresh.
+					If the loops are in the driver and the new mode cannot run there, the change is
+					refused, because the driver has to be switched too: take the loops back with
+					MOTOR_set_exec() first.
 */
-void MOTOR_set_mode(MOTOR_t* motor, MOTOR_Mode_t mode)
+int MOTOR_set_mode(MOTOR_t* motor, MOTOR_Mode_t mode)
 {
+	float cur = PID_get_out(&motor->pid_cur) - motor->pid_cur.ffd;
+	float vel = motor->pid_vel.fbk;
+	int loop_pos = 0, loop_vel = 0, loop_cur = 0;
+
+	if (!MOTOR_exec_valid(mode, motor->exec, motor->fbk_div))
+		return -1;
+
 	motor->mode = mode;
 
-	PID_clr_buf(&motor->pid_cur);
-	PID_clr_buf(&motor->pid_vel);
-	PID_clr_buf(&motor->pid_pos);
+	switch (mode)
+	{
+	case MOTOR_POSITION_MODE:
+	case MOTOR_POSITION_CURRENT_MODE:
+	case MOTOR_POSITION_VELOCITY_MODE:
+	case MOTOR_POSITION_VELOCITY_CURRENT_MODE:
+		loop_pos = 1;
+	case MOTOR_VELOCITY_MODE:
+	case MOTOR_VELOCITY_CURRENT_MODE:
+		loop_vel = 1;
+	case MOTOR_CURRENT_MODE:
+	case MOTOR_IMPEDANCE_MODE:
+	case MOTOR_STATE_FEEDBACK_MODE:
+		loop_cur = 1;
+		break;
+	default:
+		break;
+	}
+
+	if (loop_pos)
+	{
+		PID_set_ffd(&motor->pid_pos, 0.0f);
+		PID_set_state(&motor->pid_pos, motor->pid_pos.fbk, vel);
+	}
+	else
+		PID_clr_buf(&motor->pid_pos);
+
+	if (loop_vel)
+	{
+		PID_set_ffd(&motor->pid_vel, 0.0f);
+		PID_set_state(&motor->pid_vel, vel, cur);
+	}
+	else
+		PID_clr_buf(&motor->pid_vel);
+
+	if (loop_cur)
+		PID_set_state(&motor->pid_cur, cur, cur + motor->pid_cur.ffd);
+	else
+		PID_clr_buf(&motor->pid_cur);
+
+	return 0;
+}
+
+/**
+	* @Function:	Setting where the loops of motor are closed
+	* @Parameter:	- *motor:	pointer of motor structure
+					- exec:		execution strategy
+					- fbk_div:	divider of the feedback rate while the loops are in the driver,
+								1 to read feedback every tick
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		the loops of the mode cannot be delegated like this
+	* @Attention:	Delegating needs no current loop on the MCU: velocity and position modes can
+					leave the velocity loop to the driver, and position modes the position loop too.
+					A position loop left on the MCU over the velocity loop of the driver needs the
+					feedback of every tick, so fbk_div must be 1 then.
+					The command feedforward of current is ignored by the driver.
+					The setpoint is not changed, so the driver continues from the same reference.
+					The driver must be switched to its own mode by the caller at the same time.
+					When the loops come back to the MCU, they are initialized like a bumpless mode
+					change, with the current feedback as the last command, so read the current of
+					the driver into MOTOR_set_fbk() before.
+*/
+int MOTOR_set_exec(MOTOR_t* motor, MOTOR_Exec_t exec, int fbk_div)
+{
+	fbk_div = (fbk_div < 1) ? 1 : fbk_div;
+	if (!MOTOR_exec_valid(motor->mode, exec, fbk_div))
+		return -1;
+
+	if (exec == MOTOR_EXEC_LOCAL)
+	{
+		motor->fbk_div = 1;
+		if (motor->exec != MOTOR_EXEC_LOCAL)
+		{
+			PID_set_state(&motor->pid_cur, motor->pid_cur.fbk, motor->pid_cur.fbk + motor->pid_cur.ffd);
+			motor->exec = exec;
+			MOTOR_set_mode(motor, motor->mode);
+		}
+		return 0;
+	}
+
+	motor->exec = exec;
+	motor->fbk_div = fbk_div;
+	motor->fbk_cnt = 0;
+
+	return 0;
+}
+
+/**
+	* @Function:	Getting where the loops of motor are closed
+	* @Parameter:	- *motor:	pointer of motor structure
+	* @Return:		execution strategy
+	* @Attention:	none
+*/
+MOTOR_Exec_t MOTOR_get_exec(MOTOR_t* motor)
+{
+	return motor->exec;
+}
+
+/**
+	* @Function:	Checking whether the feedback should be read in this tick
+	* @Parameter:	- *motor:	pointer of motor structure
+	* @Return:		1 if the feedback should be read, otherwise 0
+	* @Attention:	Call it once per tick. It is always 1 while the loops are on the MCU.
+*/
+int MOTOR_fbk_due(MOTOR_t* motor)
+{
+	if (++motor->fbk_cnt >= motor->fbk_div)
+	{
+		motor->fbk_cnt = 0;
+		return 1;
+	}
+	return 0;
 }
 
 /**
@@ -156,6 +322,89 @@ void MOTOR_set_pos_loop_limit(MOTOR_t* motor, float max, float min)
 	PID_set_limit(&motor->pid_pos, max, min);
 }
 
+/**
+	* @Function:	Setting the gain schedule for current loop of motor
+	* @Parameter:	- *motor:	pointer of motor structure
+					- *sched:	pointer of gain schedule structure, NULL to disable the schedule
+	* @Return:		none
+	* @Attention:	The current loop is a PD controller, so the gain of I controller in the schedule
+					should be 0. Like MOTOR_set_cur_loop_gain(), only for a current loop which is not
+					closed by the driver/amplifer. It takes effect at MOTOR_sync_param() after
+					PID_publish(), see PID_set_sched().
+*/
+void MOTOR_set_cur_loop_sched(MOTOR_t* motor, const PID_Sched_t *sched)
+{
+	PID_set_sched(&motor->pid_cur, sched);
+}
+
+/**
+	* @Function:	Setting the gain schedule for velocity loop of motor
+	* @Parameter:	- *motor:	pointer of motor structure
+					- *sched:	pointer of gain schedule structure, NULL to disable the schedule
+	* @Return:		none
+	* @Attention:	The gain of D controller in the schedule is ignored by the PI controller.
+					It takes effect like MOTOR_set_cur_loop_sched().
+*/
+void MOTOR_set_vel_loop_sched(MOTOR_t* motor, const PID_Sched_t *sched)
+{
+	PID_set_sched(&motor->pid_vel, sched);
+}
+
+/**
+	* @Function:	Setting the gain schedule for position loop of motor
+	* @Parameter:	- *motor:	pointer of motor structure
+					- *sched:	pointer of gain schedule structure, NULL to disable the schedule
+	* @Return:		none
+	* @Attention:	It takes effect like MOTOR_set_cur_loop_sched().
+*/
+void MOTOR_set_pos_loop_sched(MOTOR_t* motor, const PID_Sched_t *sched)
+{
+	PID_set_sched(&motor->pid_pos, sched);
+}
+
+/**
+	* @Function:	Setting the scheduling variable for motor controller
+	* @Parameter:	- *motor:	pointer of motor structure
+					- var:		scheduling variable, e.g. velocity, load estimate or gait phase
+	* @Return:		none
+	* @Attention:	All loops of the motor share the same scheduling variable. Call it every tick
+					before MOTOR_calc().
+*/
+void MOTOR_set_sched_var(MOTOR_t* motor, float var)
+{
+	PID_set_sched_var(&motor->pid_cur, var);
+	PID_set_sched_var(&motor->pid_vel, var);
+	PID_set_sched_var(&motor->pid_pos, var);
+}
+
+/**
+	* @Function:	Taking the published parameters of several motors
+	* @Parameter:	- *motor:	array of motor structures
+					- num:		number of motors
+	* @Return:		none
+	* @Attention:	The gains and limits set by the functions above are written to the shadow
+					blocks and take effect only here, after PID_publish(). Call it at the start of
+					every tick with all motors, so the new parameters of all joints apply in the
+					same tick.
+*/
+void MOTOR_sync_param(MOTOR_t* motor, int num)
+{
+	unsigned int seq;
+	int i;
+
+	if (!PID_param_pending())
+		return;
+
+	seq = PID_get_pub_seq();
+	for (i = 0; i < num; i++)
+	{
+		PID_sync(&motor[i].pid_cur);
+		PID_sync(&motor[i].pid_vel);
+		PID_sync(&motor[i].pid_pos);
+	}
+	PID_ack(seq);
+}
+
 /**
 	* @Function:	Setting the feedback value for motor controller
 	* @Parameter:	- *motor:	pointer of motor structure
@@ -172,6 +421,20 @@ void MOTOR_set_fbk(MOTOR_t* motor, float cur, float vel, float pos)
 	PID_set_fbk(&motor->pid_pos, pos);
 }
 
+/**
+	* @Function:	Setting the model-based current feedforward for motor controller
+	* @Parameter:	- *motor:	pointer of motor structure
+					- current:	feedforward value of current, e.g. friction and gravity compensation
+	* @Return:		none
+	* @Attention:	It is added to the output of current loop in every mode, on top of the
+					feedforward given by the mode commands. It is kept when the mode changes for
+					the bumpless transfer, and it should be updated every tick.
+*/
+void MOTOR_set_cur_ffd(MOTOR_t* motor, float current)
+{
+	PID_set_ffd(&motor->pid_cur, current);
+}
+
 /**
 	* @Function:	Current mode command
 	* @Parameter:	- *motor:	pointer of motor structure
@@ -311,7 +574,7 @@ int MOTOR_pos_vel_mode(MOTOR_t* motor, float position, float velocity)
 */
 int MOTOR_pos_vel_cur_mode(MOTOR_t* motor, float position, float velocity, float current)
 {
-	if (motor->mode == MOTOR_POSITION_VELOCITY_MODE)
+	if (motor->mode == MOTOR_POSITION_VELOCITY_CURRENT_MODE)
 	{
 		PID_set_in(&motor->pid_pos, position);
 		PID_set_ffd(&motor->pid_pos, velocity);
@@ -322,6 +585,48 @@ int MOTOR_pos_vel_cur_mode(MOTOR_t* motor, float position, float velocity, float
 		return -1;
 }
 
+/**
+	* @Function:	Impedance mode command
+	* @Parameter:	- *motor:	pointer of motor structure
+					- current:	setvalue of current computed by the impedance controller
+	* @Return:		operation status
+					- 0:		operating successfully
+					- 1:		setting mode of motor does not match
+	* @Attention:	The motor only runs the current loop like the current mode, but the separate
+					mode keeps the impedance controller from overriding a joint which has been
+					switched to another mode.
+*/
+int MOTOR_imp_mode(MOTOR_t* motor, float current)
+{
+	if (motor->mode == MOTOR_IMPEDANCE_MODE)
+	{
+		PID_set_in(&motor->pid_cur, current);
+		return 0;
+	}
+	else
+		return -1;
+}
+
+/**
+	* @Function:	State feedback mode command
+	* @Parameter:	- *motor:	pointer of motor structure
+					- current:	setvalue of current computed by the state feedback controller
+	* @Return:		operation status
+					- 0:		operating successfully
+					- 1:		setting mode of motor does not match
+	* @Attention:	The motor only runs the current loop like the current mode.
+*/
+int MOTOR_sf_mode(MOTOR_t* motor, float current)
+{
+	if (motor->mode == MOTOR_STATE_FEEDBACK_MODE)
+	{
+		PID_set_in(&motor->pid_cur, current);
+		return 0;
+	}
+	else
+		return -1;
+}
+
 /**
 	* @Function:	Getting output command of motor controller
 	* @Parameter:	- *motor:	pointer of motor structure
@@ -332,3 +637,24 @@ float MOTOR_get_cmd(MOTOR_t* motor)
 {
 	return PID_get_out(&motor->pid_cur);
 }
+
+/**
+	* @Function:	Getting the setpoint for the driver when the loops are delegated
+	* @Parameter:	- *motor:	pointer of motor structure
+	* @Return:		velocity setpoint for MOTOR_EXEC_ACTR_VEL, position setpoint for
+					MOTOR_EXEC_ACTR_POS and current command for MOTOR_EXEC_LOCAL
+	* @Attention:	The position feedforward of velocity is not used by the driver, so the
+					position reference should be smooth, e.g. from the trajectory generator.
+*/
+float MOTOR_get_exec_cmd(MOTOR_t* motor)
+{
+	switch (motor->exec)
+	{
+	case MOTOR_EXEC_ACTR_VEL:
+		return motor->pid_vel.in;
+	case MOTOR_EXEC_ACTR_POS:
+		return motor->pid_pos.in;
+	default:
+		return MOTOR_get_cmd(motor);
+	}
+}
@@ -16,12 +16,35 @@ typedef enum MOTOR_Mode_t
 	MOTOR_POSITION_VELOCITY_MODE = 0x06,
 	MOTOR_POSITION_VELOCITY_CURRENT_MODE = 0x07,
 
+	/* Current is given by the Cartesian impedance controller of the leg */
+	MOTOR_IMPEDANCE_MODE = 0x08,
+
+	/* Current is given by the state feedback controller of the joint */
+	MOTOR_STATE_FEEDBACK_MODE = 0x09,
+
 }MOTOR_Mode_t;
 
+/* Where the loops of the motor are closed */
+typedef enum MOTOR_Exec_t
+{
+	/* All loops on the MCU, current command to the driver */
+	MOTOR_EXEC_LOCAL = 0x00,
+	/* Velocity and current loops in the driver, velocity command to the driver */
+	MOTOR_EXEC_ACTR_VEL = 0x01,
+	/* All loops in the driver, position command to the driver */
+	MOTOR_EXEC_ACTR_POS = 0x02,
+
+}MOTOR_Exec_t;
+
 typedef struct MOTOR_t
 {
 	MOTOR_Mode_t mode;
 
+	MOTOR_Exec_t exec;
+	/* Feedback is read every fbk_div ticks while the loops are in the driver */
+	int fbk_div;
+	int fbk_cnt;
+
 	PID_t pid_cur;
 	PID_t pid_vel;
 	PID_t pid_pos;
@@ -32,7 +55,13 @@ void MOTOR_init(MOTOR_t* motor, MOTOR_Mode_t mode);
 
 void MOTOR_calc(MOTOR_t* motor);
 
-void MOTOR_set_mode(MOTOR_t* motor, MOTOR_Mode_t mode);
+int MOTOR_set_mode(MOTOR_t* motor, MOTOR_Mode_t mode);
+
+int MOTOR_set_exec(MOTOR_t* motor, MOTOR_Exec_t exec, int fbk_div);
+
+MOTOR_Exec_t MOTOR_get_exec(MOTOR_t* motor);
+
+int MOTOR_fbk_due(MOTOR_t* motor);
 
 void MOTOR_set_cur_loop_gain(MOTOR_t* motor, float kp, float kd);
 
@@ -46,8 +75,20 @@ void MOTOR_set_vel_loop_limit(MOTOR_t* motor, float max, float min);
 
 void MOTOR_set_pos_loop_limit(MOTOR_t* motor, float max, float min);
 
+void MOTOR_set_cur_loop_sched(MOTOR_t* motor, const PID_Sched_t *sched);
+
+void MOTOR_set_vel_loop_sched(MOTOR_t* motor, const PID_Sched_t *sched);
+
+void MOTOR_set_pos_loop_sched(MOTOR_t* motor, const PID_Sched_t *sched);
+
+void MOTOR_set_sched_var(MOTOR_t* motor, float var);
+
+void MOTOR_sync_param(MOTOR_t* motor, int num);
+
 void MOTOR_set_fbk(MOTOR_t* motor, float cur, float vel, float pos);
 
+void MOTOR_set_cur_ffd(MOTOR_t* motor, float current);
+
 int MOTOR_cur_mode(MOTOR_t* motor, float torque);
 
 int MOTOR_vel_mode(MOTOR_t* motor, float velocity);
@@ -62,6 +103,12 @@ int MOTOR_pos_vel_mode(MOTOR_t* motor, float position, float velocity);
 
 int MOTOR_pos_vel_cur_mode(MOTOR_t* motor, float position, float velocity, float torque);
 
+int MOTOR_imp_mode(MOTOR_t* motor, float current);
+
+int MOTOR_sf_mode(MOTOR_t* motor, float current);
+
 float MOTOR_get_cmd(MOTOR_t* motor);
 
+float MOTOR_get_exec_cmd(MOTOR_t* motor);
+
 #endif
@@ -9,6 +9,10 @@
 
 #include "pid.h"
 
+/* Sequence of the parameter publication, see PID_publish() */
+static volatile unsigned int PID_pub_seq = 0;
+static volatile unsigned int PID_ack_seq = 0;
+
 /**
 	* @Function:	Initializing the structure member for pid
 	* @Parameter:	- *pid:	pointer of pid structure
@@ -22,9 +26,19 @@
 */
 void PID_init(PID_t *pid, PID_Mode_t mode, float kp, float ki, float kd)
 {
-	pid->kp = kp;
-	pid->ki = ki;
-	pid->kd = kd;
+	pid->mode = mode;
+
+	pid->act = &pid->param[0];
+	pid->shd = &pid->param[1];
+	pid->dirty = 0;
+
+	pid->act->kp = kp;
+	pid->act->ki = ki;
+	pid->act->kd = kd;
+	pid->act->max = 0.0f;
+	pid->act->min = 0.0f;
+	pid->act->sched = 0;
+	*pid->shd = *pid->act;
 
 	pid->in = 0;
 	pid->fbk = 0;
@@ -35,9 +49,45 @@ void PID_init(PID_t *pid, PID_Mode_t mode, float kp, float ki, float kd)
 	pid->err[1] = 0;
 	pid->err[2] = 0;
 
-	pid->max = 0.0f;
-	pid->min = 0.0f;
 	pid->err_sum = 0;
+
+	pid->sched_var = 0.0f;
+	pid->sched_idx = 0;
+}
+
+/**
+	* @Function:	Looking up the gain in the gain schedule
+	* @Parameter:	- *pid:		pointer of pid structure
+					- *sched:	gain schedule of the active block
+					- *gain:	gains at the scheduling variable, the limits are not touched
+	* @Return:		none
+	* @Attention:	The segment found last time is checked first, since the scheduling variable
+					usually changes slowly. Out of the breakpoints the gain is held at the end.
+					The gains of the parameter blocks are not written, so the constant gains of
+					PID_set_gain() apply again once the schedule is removed.
+*/
+static void PID_sched_calc(PID_t *pid, const PID_Sched_t *sched, PID_Param_t *gain)
+{
+	const PID_Seg_t *seg;
+	int idx = pid->sched_idx;
+	float var = pid->sched_var;
+	float dx;
+
+	if (idx >= sched->num)
+		idx = 0;
+	while (idx > 0 && var < sched->x[idx])
+		idx--;
+	while (idx < sched->num - 1 && var >= sched->x[idx + 1])
+		idx++;
+	pid->sched_idx = idx;
+
+	seg = &sched->seg[idx];
+	dx = var - sched->x[idx];
+	dx = (dx < 0.0f) ? 0.0f : dx;
+
+	gain->kp = seg->kp + seg->kp_k * dx;
+	gain->ki = seg->ki + seg->ki_k * dx;
+	gain->kd = seg->kd + seg->kd_k * dx;
 }
 
 /**
@@ -45,10 +95,28 @@ void PID_init(PID_t *pid, PID_Mode_t mode, float kp, float ki, float kd)
 	* @Parameter:	- *pid:	pointer of pid structure
 	* @Return:		none
 	* @Attention:	Either mode will output the actual control rather than the control increment.
-					For regular mode, the property of anti integral windup is added.
+					For regular mode, the property of anti integral windup is added: the error is
+					integrated while the output is within the limits, and while it is saturated
+					only the error driving it back. Without limits the error is always integrated.
+					The integral is kept as the sum of ki * err, so a change of ki by the schedule
+					or PID_sync() only weights the errors from then on and the output does not step.
+					If the active block has a gain schedule, the gains are looked up in it before
+					calculating, so the gains used in one calculation always come from the same
+					lookup. The parameters are read through one load of the active block pointer,
+					which is only swapped by PID_sync() in the same context.
 */
 void PID_calc(PID_t *pid)
 {
+	const PID_Param_t *p = pid->act;
+	PID_Param_t gain;
+
+	if (p->sched)
+	{
+		gain = *p;
+		PID_sched_calc(pid, p->sched, &gain);
+		p = &gain;
+	}
+
 	pid->err[2] = pid->err[1];
 	pid->err[1] = pid->err[0];
 
@@ -60,21 +128,23 @@ void PID_calc(PID_t *pid)
 		/* Solving integral windup */
 		// FIXME:	The existing of feedfoward may decrease the effect of anti integral windup
 		//			because the feedfoward isn't included in the pid->out[1].
-		if (pid->out[1] > pid->max)
+		if (p->max - p->min >= 0.01f && pid->out[1] > p->max)
 		{
 			if (pid->err[0] < 0)
-				pid->err_sum += pid->err[0];
+				pid->err_sum += p->ki * pid->err[0];
 		}
-		else if (pid->out[1] < pid->min)
+		else if (p->max - p->min >= 0.01f && pid->out[1] < p->min)
 		{
 			if (pid->err[0] > 0)
-				pid->err_sum += pid->err[0];
+				pid->err_sum += p->ki * pid->err[0];
 		}
-		pid->out[0] = pid->kp * pid->err[0] + pid->ki * pid->err_sum + pid->kd * (pid->err[1] - pid->err[0]);
+		else
+			pid->err_sum += p->ki * pid->err[0];
+		pid->out[0] = p->kp * pid->err[0] + pid->err_sum + p->kd * (pid->err[0] - pid->err[1]);
 		break;
 
 	case PID_INCREMENT_MODE:
-		pid->out[0] = pid->out[1] + pid->kp * (pid->err[0] - pid->err[1]) + pid->ki * pid->err[0] + pid->kd * (pid->err[0] - 2 * pid->err[1] + pid->err[2]);
+		pid->out[0] = pid->out[1] + p->kp * (pid->err[0] - pid->err[1]) + p->ki * pid->err[0] + p->kd * (pid->err[0] - 2 * pid->err[1] + pid->err[2]);
 		break;
 
 	default:
@@ -87,14 +157,14 @@ void PID_calc(PID_t *pid)
 	pid->out[0] += pid->ffd;
 
 	/* Limitting the output */
-	if (pid->max - pid->min < 0)
+	if (p->max - p->min < 0)
 		pid->out[0] = 0;
-	else if (pid->max - pid->min < 0.01f)
+	else if (p->max - p->min < 0.01f)
 		pid->out[0] = pid->out[0];
 	else
 	{
-		pid->out[0] = (pid->out[0] > pid->max) ? pid->max : pid->out[0];
-		pid->out[0] = (pid->out[0] < pid->min) ? pid->min : pid->out[0];
+		pid->out[0] = (pid->out[0] > p->max) ? p->max : pid->out[0];
+		pid->out[0] = (pid->out[0] < p->min) ? p->min : pid->out[0];
 	}
 }
 
@@ -148,12 +218,15 @@ void PID_set_ffd(PID_t *pid, float ffd)
 	* @Return:		none
 	* @Attention:	If ki/kd is set to 0, the corrosponding controller will be disabled.
 					kp cannot be set to 0!!!
+					The gain is written to the shadow block and takes effect at PID_sync() after
+					PID_publish(). It must not be called while PID_param_pending() is true.
 */
 void PID_set_gain(PID_t *pid, float kp, float ki, float kd)
 {
-	pid->kp = kp;
-	pid->ki = ki;
-	pid->kd = kd;
+	pid->shd->kp = kp;
+	pid->shd->ki = ki;
+	pid->shd->kd = kd;
+	pid->dirty = 1;
 }
 
 /**
@@ -165,11 +238,13 @@ void PID_set_gain(PID_t *pid, float kp, float ki, float kd)
 	* @Attention:	If abs(max - min) < 0.01, it will be consider that there is no limit
 					for output.
 					If max < min, the output is going to stay at 0.
+					The limit is written to the shadow block like PID_set_gain().
 */
 void PID_set_limit(PID_t *pid, float max, float min)
 {
-	pid->max = max;
-	pid->min = min;
+	pid->shd->max = max;
+	pid->shd->min = min;
+	pid->dirty = 1;
 }
 
 /**
@@ -201,3 +276,188 @@ void PID_clr_buf(PID_t *pid)
 	pid->err[2] = 0;
 	pid->err_sum = 0;
 }
+
+/**
+	* @Function:	Setting the internal state for bumpless transfer
+	* @Parameter:	- *pid:	pointer of pid structure
+					- in:	setpoint from which the controller continues
+					- out:	output from which the controller continues, including the feedforward
+	* @Return:		none
+	* @Attention:	The feedback and the feedforward must have been set before. The error history is
+					filled with the present error, so the D controller gives nothing at the first
+					calculation. In regular mode the integral is set so that the same error gives
+					the same output. If ki is 0 it stays a constant bias then, so a P or PD loop
+					keeps the output it was handed over at, like the manual reset of a P controller.
+					In increment mode the last output is the state, so it continues from the output
+					anyway.
+*/
+void PID_set_state(PID_t *pid, float in, float out)
+{
+	float err = in - pid->fbk;
+	PID_Param_t gain = *pid->act;
+
+	if (gain.sched)
+		PID_sched_calc(pid, gain.sched, &gain);
+
+	pid->in = in;
+	pid->err[0] = err;
+	pid->err[1] = err;
+	pid->err[2] = err;
+	pid->out[0] = out;
+	pid->out[1] = out - pid->ffd;
+
+	if (pid->mode == PID_REGULAR_MODE)
+		pid->err_sum = pid->out[1] - gain.kp * err;
+}
+
+/**
+	* @Function:	Publishing the parameters written to the shadow blocks
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	Handshake between the writer, e.g. a tuning command from serial, and the control
+					tick: the writer waits until PID_param_pending() is false, writes the gains and
+					limits of any controllers, then publishes them all at once. The control tick
+					swaps the blocks of all controllers at its start and acknowledges the sequence,
+					so every new parameter takes effect in the same tick and none is torn.
+*/
+void PID_publish(void)
+{
+	PID_pub_seq++;
+}
+
+/**
+	* @Function:	Checking whether a publication has not been taken by the control tick yet
+	* @Parameter:	none
+	* @Return:		1 if pending, 0 if the shadow blocks can be written
+	* @Attention:	none
+*/
+int PID_param_pending(void)
+{
+	return PID_pub_seq != PID_ack_seq;
+}
+
+/**
+	* @Function:	Getting sequence of the last publication
+	* @Parameter:	none
+	* @Return:		sequence of publication
+	* @Attention:	The consumer reads it before swapping and acknowledges the same value after.
+*/
+unsigned int PID_get_pub_seq(void)
+{
+	return PID_pub_seq;
+}
+
+/**
+	* @Function:	Acknowledging a publication after all controllers have been swapped
+	* @Parameter:	- seq:	sequence read by PID_get_pub_seq() before swapping
+	* @Return:		none
+	* @Attention:	none
+*/
+void PID_ack(unsigned int seq)
+{
+	PID_ack_seq = seq;
+}
+
+/**
+	* @Function:	Swapping the parameter blocks of a controller if the shadow has been written
+	* @Parameter:	- *pid:	pointer of pid structure
+	* @Return:		none
+	* @Attention:	Call it only in the context of PID_calc() and only while a publication is
+					pending. The new active block is copied to the shadow, so the next writes
+					start from the parameters in use.
+*/
+void PID_sync(PID_t *pid)
+{
+	PID_Param_t *tmp;
+
+	if (!pid->dirty)
+		return;
+
+	tmp = pid->act;
+	pid->act = pid->shd;
+	pid->shd = tmp;
+	*pid->shd = *pid->act;
+	pid->dirty = 0;
+}
+
+/**
+	* @Function:	Initializing a gain schedule
+	* @Parameter:	- *sched:	pointer of gain schedule structure
+					- *x:		breakpoints of scheduling variable in increasing order
+					- *kp:		gain values of P controller at the breakpoints
+					- *ki:		gain values of I controller at the breakpoints
+					- *kd:		gain values of D controller at the breakpoints
+					- num:		number of breakpoints
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		number of breakpoints out of range or breakpoints not increasing
+	* @Attention:	The slopes between breakpoints are computed here, so the lookup in the control
+					tick costs one multiply-add per gain.
+*/
+int PID_sched_init(PID_Sched_t *sched, const float *x, const float *kp, const float *ki, const float *kd, int num)
+{
+	int i;
+	float dx;
+
+	if (num < 1 || num > PID_SCHED_MAX_PTS)
+		return -1;
+	for (i = 1; i < num; i++)
+	{
+		if (x[i] <= x[i - 1])
+			return -1;
+	}
+
+	for (i = 0; i < num; i++)
+	{
+		sched->x[i] = x[i];
+		sched->seg[i].kp = kp[i];
+		sched->seg[i].ki = ki[i];
+		sched->seg[i].kd = kd[i];
+
+		if (i < num - 1)
+		{
+			dx = x[i + 1] - x[i];
+			sched->seg[i].kp_k = (kp[i + 1] - kp[i]) / dx;
+			sched->seg[i].ki_k = (ki[i + 1] - ki[i]) / dx;
+			sched->seg[i].kd_k = (kd[i + 1] - kd[i]) / dx;
+		}
+		else
+		{
+			sched->seg[i].kp_k = 0.0f;
+			sched->seg[i].ki_k = 0.0f;
+			sched->seg[i].kd_k = 0.0f;
+		}
+	}
+	sched->num = num;
+
+	return 0;
+}
+
+/**
+	* @Function:	Setting gain schedule for pid controller
+	* @Parameter:	- *pid:		pointer of pid structure
+					- *sched:	pointer of gain schedule structure, NULL to disable the schedule
+	* @Return:		none
+	* @Attention:	The schedule is written to the shadow block like PID_set_gain(), and gives the
+					gains from PID_sync() after PID_publish() on. It is only read by the controller,
+					so it must not be modified while it is in use: to change it, initialize another
+					one and set it here. When the schedule is removed, the gains of PID_set_gain()
+					apply again.
+*/
+void PID_set_sched(PID_t *pid, const PID_Sched_t *sched)
+{
+	pid->shd->sched = sched;
+	pid->dirty = 1;
+}
+
+/**
+	* @Function:	Setting scheduling variable for pid controller
+	* @Parameter:	- *pid:	pointer of pid structure
+					- var:	scheduling variable, e.g. velocity, load estimate or gait phase
+	* @Return:		none
+	* @Attention:	none
+*/
+void PID_set_sched_var(PID_t *pid, float var)
+{
+	pid->sched_var = var;
+}
@@ -7,14 +7,57 @@ typedef enum PID_Mode_t
 	PID_REGULAR_MODE = 0x01,
 } PID_Mode_t;
 
-typedef struct PID_t
+/* Maxinum number of breakpoints of a gain schedule */
+#define PID_SCHED_MAX_PTS 8
+
+typedef struct PID_Seg_t
 {
-	PID_Mode_t mode;
+	float kp;
+	float ki;
+	float kd;
+
+	/* Slopes to the next breakpoint */
+	float kp_k;
+	float ki_k;
+	float kd_k;
+} PID_Seg_t;
+
+typedef struct PID_Sched_t
+{
+	int num;
 
+	/* Breakpoints of scheduling variable in increasing order */
+	float x[PID_SCHED_MAX_PTS];
+	PID_Seg_t seg[PID_SCHED_MAX_PTS];
+
+} PID_Sched_t;
+
+/* Parameters which are changed at runtime, double buffered */
+typedef struct PID_Param_t
+{
 	float kp;
 	float ki;
 	float kd;
 
+	float max;
+	float min;
+
+	/* Gain schedule, which gives the gains instead of kp, ki and kd unless it is NULL */
+	const PID_Sched_t *sched;
+
+} PID_Param_t;
+
+typedef struct PID_t
+{
+	PID_Mode_t mode;
+
+	/* Block used by the controller and block written by the setters */
+	PID_Param_t param[2];
+	PID_Param_t *act;
+	PID_Param_t *shd;
+	/* Whether the shadow block has been written since the last swap */
+	unsigned char dirty;
+
 	float in;
 	float fbk;
 	float ffd;
@@ -23,10 +66,13 @@ typedef struct PID_t
 	float out[2];
 	float err[3];
 
-	float max;
-	float min;
+	/* Integral part of the output in regular mode, the sum of ki * err */
 	float err_sum;
 
+	/* Scheduling variable and segment found last, the schedule is in the parameter block */
+	float sched_var;
+	int sched_idx;
+
 } PID_t;
 
 void PID_init(PID_t *pid, PID_Mode_t mode, float kp, float ki, float kd);
@@ -47,4 +93,22 @@ float PID_get_out(PID_t *pid);
 
 void PID_clr_buf(PID_t *pid);
 
+void PID_set_state(PID_t *pid, float in, float out);
+
+void PID_publish(void);
+
+int PID_param_pending(void);
+
+unsigned int PID_get_pub_seq(void);
+
+void PID_ack(unsigned int seq);
+
+void PID_sync(PID_t *pid);
+
+int PID_sched_init(PID_Sched_t *sched, const float *x, const float *kp, const float *ki, const float *kd, int num);
+
+void PID_set_sched(PID_t *pid, const PID_Sched_t *sched);
+
+void PID_set_sched_var(PID_t *pid, float var);
+
 #endif
@@ -0,0 +1,202 @@
+/**
+	* @File:	sched.c
+	* @Author:	Chunyu Zhang
+	* @Version:	V0.0.1
+	* @Date:	2026.10.19
+	* @Description:	Cooperative rate monotonic scheduler. Tasks are registered with a
+	*		period and an execution budget and are run in the order of their periods.
+	*		Tasks with a budget only run when the budget fits in the time left before
+	*		the deadline of the cycle, so the background work never delays the next
+	*		control cycle. The clock is a function pointer, so the scheduler has no
+	*		dependency on the hardware and can be run on a host with a simulated clock.
+	*/
+
+#include "stdio.h"
+#include "sched.h"
+
+/**
+	* @Function:	Initializing the structure member of scheduler
+	* @Parameter:	- *sched:	pointer of scheduler structure
+					- clock:	function returning the time in us
+	* @Return:		none
+	* @Attention:	none
+*/
+void SCHED_init(SCHED_t *sched, SCHED_Clock_t clock)
+{
+	sched->clock = clock;
+	sched->num = 0;
+}
+
+/**
+	* @Function:	Registering a task
+	* @Parameter:	- *sched:	pointer of scheduler structure
+					- *name:	name of task, the string is not copied
+					- func:		function of task
+					- period:	period in us
+					- budget:	maxinum execution time in us, 0 to run whenever it is due
+	* @Return:		index of task, or -1 if the table is full
+	* @Attention:	The shorter the period, the higher the priority. Tasks with the same period
+					form a rate group and run in the order of registration.
+					A task with a budget must return within it, so long work such as redrawing
+					the LCD has to be sliced into several runs by the task itself.
+					The index changes if a task with a shorter period is registered later.
+*/
+int SCHED_add(SCHED_t *sched, const char *name, SCHED_Func_t func, unsigned int period, unsigned int budget)
+{
+	SCHED_Task_t *task;
+	int i;
+
+	if (sched->num >= SCHED_TASK_MAX)
+		return -1;
+
+	for (i = sched->num; i > 0 && sched->task[i - 1].period > period; i--)
+		sched->task[i] = sched->task[i - 1];
+
+	task = &sched->task[i];
+	task->name = name;
+	task->func = func;
+	task->period = period;
+	task->budget = budget;
+	task->next = sched->clock();
+
+	task->cnt = 0;
+	task->defer = 0;
+	task->miss = 0;
+	task->over = 0;
+	task->t_last = 0;
+	task->t_max = 0;
+	task->t_sum = 0;
+
+	sched->num++;
+
+	return i;
+}
+
+/**
+	* @Function:	Running the tasks which are due
+	* @Parameter:	- *sched:	pointer of scheduler structure
+					- deadline:	time in us before which all runs must finish, usually the next tick
+	* @Return:		none
+	* @Attention:	Tasks are visited once per call in the order of priority. A task without budget
+					runs whenever it is due, the others only if the budget fits before the deadline,
+					otherwise they are put off to the next call.
+					The next release is one period after the last one, so the rate is kept on
+					average, but a task which is more than one period late drops the releases
+					it has missed instead of running them back to back. The releases stay on the
+					grid of the first one, so a task registered on the tick keeps running on it.
+*/
+void SCHED_run(SCHED_t *sched, unsigned int deadline)
+{
+	SCHED_Task_t *task;
+	unsigned int now, t, k;
+	int i;
+
+	for (i = 0; i < sched->num; i++)
+	{
+		task = &sched->task[i];
+		now = sched->clock();
+
+		if ((int)(now - task->next) < 0)
+			continue;
+
+		if (task->budget > 0 && (int)(deadline - now) < (int)task->budget)
+		{
+			task->defer++;
+			continue;
+		}
+
+		task->func();
+
+		t = sched->clock() - now;
+		task->t_last = t;
+		task->t_max = (t > task->t_max) ? t : task->t_max;
+		task->t_sum += t;
+		task->cnt++;
+		if (task->budget > 0 && t > task->budget)
+			task->over++;
+
+		task->next += task->period;
+		if ((int)(now - task->next) >= 0)
+		{
+			k = (now - task->next) / task->period + 1;
+			task->miss += k;
+			task->next += task->period * k;
+		}
+	}
+}
+
+/**
+	* @Function:	Finding a task by name
+	* @Parameter:	- *sched:	pointer of scheduler structure
+					- *name:	name of task
+	* @Return:		pointer of task, or NULL if not found
+	* @Attention:	The statistics can be read through the pointer.
+*/
+SCHED_Task_t *SCHED_get_task(SCHED_t *sched, const char *name)
+{
+	const char *a, *b;
+	int i;
+
+	for (i = 0; i < sched->num; i++)
+	{
+		a = sched->task[i].name;
+		b = name;
+		while (*a && *a == *b)
+		{
+			a++;
+			b++;
+		}
+		if (*a == *b)
+			return &sched->task[i];
+	}
+
+	return 0;
+}
+
+/**
+	* @Function:	Clearing the statistics of all tasks
+	* @Parameter:	- *sched:	pointer of scheduler structure
+	* @Return:		none
+	* @Attention:	none
+*/
+void SCHED_clr_stat(SCHED_t *sched)
+{
+	int i;
+
+	for (i = 0; i < sched->num; i++)
+	{
+		sched->task[i].cnt = 0;
+		sched->task[i].defer = 0;
+		sched->task[i].miss = 0;
+		sched->task[i].over = 0;
+		sched->task[i].t_max = 0;
+		sched->task[i].t_sum = 0;
+	}
+}
+
+/**
+	* @Function:	Printing a line of the statistics of all tasks
+	* @Parameter:	- *sched:	pointer of scheduler structure
+					- line:		line of the table, 0 is the header and line i + 1 the task i
+	* @Return:		0 past the last line, 1 otherwise
+	* @Attention:	Times are in us. The table is printed a line per call, so the caller can wait
+					for room in the serial port buffer between the lines.
+*/
+int SCHED_print_line(SCHED_t *sched, int line)
+{
+	SCHED_Task_t *task;
+
+	if (line == 0)
+	{
+		printf("task     period budget    cnt  defer   miss   over  t_avg  t_max\r\n");
+		return 1;
+	}
+	if (line > sched->num)
+		return 0;
+
+	task = &sched->task[line - 1];
+	printf("%-8s %6u %6u %6u %6u %6u %6u %6u %6u\r\n", task->name, task->period, task->budget,
+		   task->cnt, task->defer, task->miss, task->over, task->cnt ? task->t_sum / task->cnt : 0, task->t_max);
+
+	return 1;
+}
@@ -0,0 +1,59 @@
+#ifndef _SCHED_H
+#define _SCHED_H
+
+/* Maxinum number of tasks */
+#define SCHED_TASK_MAX 8
+
+/* Clock in us, which may wrap around */
+typedef unsigned int (*SCHED_Clock_t)(void);
+
+typedef void (*SCHED_Func_t)(void);
+
+typedef struct SCHED_Task_t
+{
+	const char *name;
+	SCHED_Func_t func;
+
+	/* Period and execution budget in us, budget 0 for a task which always runs when due */
+	unsigned int period;
+	unsigned int budget;
+	/* Release time of the next run */
+	unsigned int next;
+
+	/* Statistics */
+	unsigned int cnt;
+	/* Runs put off because the budget did not fit in the slack */
+	unsigned int defer;
+	/* Releases dropped because the task was more than one period late */
+	unsigned int miss;
+	/* Runs longer than the budget */
+	unsigned int over;
+	unsigned int t_last;
+	unsigned int t_max;
+	unsigned int t_sum;
+
+} SCHED_Task_t;
+
+typedef struct SCHED_t
+{
+	SCHED_Clock_t clock;
+
+	/* Tasks sorted by period, the shortest first */
+	SCHED_Task_t task[SCHED_TASK_MAX];
+	int num;
+
+} SCHED_t;
+
+void SCHED_init(SCHED_t *sched, SCHED_Clock_t clock);
+
+int SCHED_add(SCHED_t *sched, const char *name, SCHED_Func_t func, unsigned int period, unsigned int budget);
+
+void SCHED_run(SCHED_t *sched, unsigned int deadline);
+
+SCHED_Task_t *SCHED_get_task(SCHED_t *sched, const char *name);
+
+void SCHED_clr_stat(SCHED_t *sched);
+
+int SCHED_print_line(SCHED_t *sched, int line);
+
+#endif
@@ -0,0 +1,328 @@
+/**
+	* @File:	traj.c
+	* @Author:	Chunyu Zhang
+	* @Version:	V0.0.1
+	* @Date:	2026.10.19
+	* @Description:	Online jerk-limited trajectory generator. Every tick the generator
+	*		computes the jerk that drives the joint to the target as fast as the
+	*		velocity, acceleration and jerk limits allow, so the target can be
+	*		changed at any time, even in the middle of a motion.
+	*/
+
+#include "math.h"
+#include "traj.h"
+
+/**
+	* @Function:	Initializing the structure member of trajectory generator
+	* @Parameter:	- *traj:	pointer of trajectory structure
+					- dt:		period of control tick in second
+					- vmax:		maxinum velocity
+					- amax:		maxinum acceleration
+					- jmax:		maxinum jerk
+	* @Return:		none
+	* @Attention:	The generator starts at position 0. Call TRAJ_reset() with the measured
+					position of the joint before the first TRAJ_calc().
+*/
+void TRAJ_init(TRAJ_t *traj, float dt, float vmax, float amax, float jmax)
+{
+	traj->dt = dt;
+	traj->kff = 0.0f;
+	traj->kvel = 1.0f;
+
+	TRAJ_set_limit(traj, vmax, amax, jmax);
+	TRAJ_reset(traj, 0.0f);
+}
+
+/**
+	* @Function:	Resetting the trajectory generator to a standstill position
+	* @Parameter:	- *traj:	pointer of trajectory structure
+					- pos:		position where the joint stands
+	* @Return:		none
+	* @Attention:	The target is set to the same position, so the generator holds still.
+*/
+void TRAJ_reset(TRAJ_t *traj, float pos)
+{
+	traj->tgt = pos;
+	traj->err = 0.0f;
+	traj->pos = pos;
+	traj->vel = 0.0f;
+	traj->acc = 0.0f;
+}
+
+/**
+	* @Function:	Setting the limits of trajectory generator
+	* @Parameter:	- *traj:	pointer of trajectory structure
+					- vmax:		maxinum velocity
+					- amax:		maxinum acceleration
+					- jmax:		maxinum jerk
+	* @Return:		none
+	* @Attention:	All limits must be positive. The limits may be changed during the motion,
+					the generator will then bring the state back into the new limits with
+					the allowed jerk.
+*/
+void TRAJ_set_limit(TRAJ_t *traj, float vmax, float amax, float jmax)
+{
+	traj->vmax = vmax;
+	traj->amax = amax;
+	traj->jmax = jmax;
+}
+
+/**
+	* @Function:	Setting the current feedforward gain
+	* @Parameter:	- *traj:	pointer of trajectory structure
+					- kff:		current command per unit of acceleration (the inertia of joint)
+	* @Return:		none
+	* @Attention:	none
+*/
+void TRAJ_set_ffd_gain(TRAJ_t *traj, float kff)
+{
+	traj->kff = kff;
+}
+
+/**
+	* @Function:	Setting the scale of the velocity setpoint
+	* @Parameter:	- *traj:	pointer of trajectory structure
+					- kvel:		velocity of the velocity loop per unit of velocity of the trajectory
+	* @Return:		none
+	* @Attention:	Only TRAJ_to_motor() applies it, the state of the generator is in the unit
+					of the position per second. It is 1 after TRAJ_init().
+*/
+void TRAJ_set_vel_scale(TRAJ_t *traj, float kvel)
+{
+	traj->kvel = kvel;
+}
+
+/**
+	* @Function:	Setting the target position
+	* @Parameter:	- *traj:	pointer of trajectory structure
+					- tgt:		target position
+	* @Return:		none
+	* @Attention:	The target can be changed at any time, the current motion state is kept.
+*/
+void TRAJ_set_target(TRAJ_t *traj, float tgt)
+{
+	traj->err += traj->tgt - tgt;
+	traj->tgt = tgt;
+}
+
+/* Distance covered until the joint stands still when braking from velocity v and
+   acceleration a as hard as the limits allow, both positive towards the target.
+   It is negative if the joint is moving away from the target. */
+static float TRAJ_brake_dist(float v, float a, float amax, float jmax)
+{
+	float q, ap, t1, t3, v1, d, th;
+
+	q = jmax * v + 0.5f * a * a;
+	if (q < 0.0f)
+		return -1.0f;
+
+	/* Braking harder than needed: the velocity reaches 0 while the acceleration is ramped back */
+	if (a < 0.0f && jmax * v < 0.5f * a * a)
+	{
+		if (v <= 0.0f)
+			return 0.0f;
+		t1 = (-a - sqrtf(a * a - 2.0f * jmax * v)) / jmax;
+		return v * t1 + 0.5f * a * t1 * t1 + jmax * t1 * t1 * t1 / 6.0f;
+	}
+
+	/* Ramp the acceleration down to its peak ap, hold it if clamped, and ramp it up to 0 */
+	ap = -sqrtf(q);
+	ap = (ap < -amax) ? -amax : ap;
+
+	t1 = (a - ap) / jmax;
+	d = v * t1 + 0.5f * a * t1 * t1 - jmax * t1 * t1 * t1 / 6.0f;
+	v1 = v + a * t1 - 0.5f * jmax * t1 * t1;
+
+	if (ap == -amax)
+	{
+		th = (v1 - 0.5f * amax * amax / jmax) / amax;
+		th = (th < 0.0f) ? 0.0f : th;
+		d += v1 * th - 0.5f * amax * th * th;
+		v1 -= amax * th;
+	}
+
+	t3 = -ap / jmax;
+	return d + v1 * t3 + 0.5f * ap * t3 * t3 + jmax * t3 * t3 * t3 / 6.0f;
+}
+
+/* Whether the joint can still stop at distance d and keep under vmax after a tick with jerk j,
+   all values positive towards the target */
+static int TRAJ_is_safe(TRAJ_t *traj, float d, float v, float a, float j)
+{
+	float dt = traj->dt;
+	float jmax = traj->jmax;
+	float a1 = a + j * dt;
+	float v1 = v + (a + 0.5f * j * dt) * dt;
+	float d1 = d - (v + (0.5f * a + j * dt / 6.0f) * dt) * dt;
+
+	if (v1 + ((a1 > 0.0f) ? 0.5f * a1 * a1 / jmax : 0.0f) > traj->vmax)
+		return 0;
+
+	return TRAJ_brake_dist(v1, a1, traj->amax, jmax) <= d1;
+}
+
+/**
+	* @Function:	Calculating the setpoint of the next tick
+	* @Parameter:	- *traj:	pointer of trajectory structure
+	* @Return:		none
+	* @Attention:	The state is integrated as the distance to the target instead of the absolute
+					position, so that small steps near the target are not lost to float rounding.
+					The jerk is constant within a tick and the state is integrated exactly with it.
+					A jerk is taken if after the tick the joint can still stop at the target with
+					the limits, counting the ramp of the acceleration down to 0, and still end the
+					ramp of the acceleration under the velocity limit. The largest such jerk
+					towards the target is found by bisection. Therefore the motion does not
+					overshoot the target or the velocity limit.
+					The cost is up to 14 evaluations of the braking distance with a sqrtf() each,
+					which is a single instruction on the M4 FPU, see TEST/test_traj.c.
+*/
+void TRAJ_calc(TRAJ_t *traj)
+{
+	float s, d, v, a, lo, hi, mid, jerk;
+	float dt = traj->dt;
+	float amax = traj->amax;
+	float jmax = traj->jmax;
+	int i;
+
+	/* Settled: snap to the target to avoid a limit cycle around it */
+	if (fabsf(traj->err) < 0.5f * jmax * dt * dt * dt &&
+		fabsf(traj->vel) < jmax * dt * dt &&
+		fabsf(traj->acc) < jmax * dt)
+	{
+		TRAJ_reset(traj, traj->tgt);
+		return;
+	}
+
+	/* Work with values positive towards the target */
+	s = (traj->err > 0.0f || (traj->err == 0.0f && traj->vel > 0.0f)) ? -1.0f : 1.0f;
+	d = fabsf(traj->err);
+	v = s * traj->vel;
+	a = s * traj->acc;
+
+	hi = (amax - a) / dt;
+	hi = (hi > jmax) ? jmax : hi;
+	lo = (-amax - a) / dt;
+	lo = (lo < -jmax) ? -jmax : lo;
+	hi = (hi < lo) ? lo : hi;
+
+	if (TRAJ_is_safe(traj, d, v, a, hi))
+		jerk = hi;
+	else if (!TRAJ_is_safe(traj, d, v, a, lo))
+		jerk = lo;
+	else
+	{
+		for (i = 0; i < 12; i++)
+		{
+			mid = 0.5f * (lo + hi);
+			if (TRAJ_is_safe(traj, d, v, a, mid))
+				lo = mid;
+			else
+				hi = mid;
+		}
+		jerk = lo;
+	}
+	jerk *= s;
+
+	traj->err += (traj->vel + (0.5f * traj->acc + jerk * dt / 6.0f) * dt) * dt;
+	traj->vel += (traj->acc + 0.5f * jerk * dt) * dt;
+	traj->acc += jerk * dt;
+	traj->pos = traj->tgt + traj->err;
+}
+
+/**
+	* @Function:	Calculating the setpoints of the next tick for several joints
+	* @Parameter:	- *traj:	array of trajectory structures
+					- num:		number of joints
+	* @Return:		none
+	* @Attention:	none
+*/
+void TRAJ_calc_batch(TRAJ_t *traj, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		TRAJ_calc(&traj[i]);
+}
+
+/**
+	* @Function:	Getting position setpoint
+	* @Parameter:	- *traj:	pointer of trajectory structure
+	* @Return:		position setpoint
+	* @Attention:	none
+*/
+float TRAJ_get_pos(TRAJ_t *traj)
+{
+	return traj->pos;
+}
+
+/**
+	* @Function:	Getting velocity setpoint
+	* @Parameter:	- *traj:	pointer of trajectory structure
+	* @Return:		velocity setpoint
+	* @Attention:	none
+*/
+float TRAJ_get_vel(TRAJ_t *traj)
+{
+	return traj->vel;
+}
+
+/**
+	* @Function:	Getting acceleration setpoint
+	* @Parameter:	- *traj:	pointer of trajectory structure
+	* @Return:		acceleration setpoint
+	* @Attention:	none
+*/
+float TRAJ_get_acc(TRAJ_t *traj)
+{
+	return traj->acc;
+}
+
+/**
+	* @Function:	Getting current feedforward
+	* @Parameter:	- *traj:	pointer of trajectory structure
+	* @Return:		current feedforward
+	* @Attention:	none
+*/
+float TRAJ_get_ffd(TRAJ_t *traj)
+{
+	return traj->kff * traj->acc;
+}
+
+/**
+	* @Function:	Checking whether the target has been reached
+	* @Parameter:	- *traj:	pointer of trajectory structure
+	* @Return:		- 1:		the joint stands still at the target
+					- 0:		the joint is moving
+	* @Attention:	none
+*/
+int TRAJ_is_done(TRAJ_t *traj)
+{
+	return (traj->err == 0.0f) && (traj->vel == 0.0f) && (traj->acc == 0.0f);
+}
+
+/**
+	* @Function:	Sending the setpoint to the motor controller
+	* @Parameter:	- *traj:	pointer of trajectory structure
+					- *motor:	pointer of motor structure
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		mode of motor does not take a position setpoint
+	* @Attention:	The setpoint is sent by the command which matches the mode of motor, the
+					velocity scaled by TRAJ_set_vel_scale().
+*/
+int TRAJ_to_motor(TRAJ_t *traj, MOTOR_t *motor)
+{
+	switch (motor->mode)
+	{
+	case MOTOR_POSITION_MODE:
+		return MOTOR_pos_mode(motor, traj->pos);
+	case MOTOR_POSITION_CURRENT_MODE:
+		return MOTOR_pos_cur_mode(motor, traj->pos, TRAJ_get_ffd(traj));
+	case MOTOR_POSITION_VELOCITY_MODE:
+		return MOTOR_pos_vel_mode(motor, traj->pos, traj->vel * traj->kvel);
+	case MOTOR_POSITION_VELOCITY_CURRENT_MODE:
+		return MOTOR_pos_vel_cur_mode(motor, traj->pos, traj->vel * traj->kvel, TRAJ_get_ffd(traj));
+	default:
+		return -1;
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef _TRAJ_H
+#define _TRAJ_H
+
+#include "motor.h"
+
+typedef struct TRAJ_t
+{
+	/* Sample time of the control tick in second */
+	float dt;
+
+	float vmax;
+	float amax;
+	float jmax;
+
+	/* Current feedforward per unit of acceleration */
+	float kff;
+	/* Velocity of the velocity loop per unit of velocity of the trajectory */
+	float kvel;
+
+	float tgt;
+	/* Distance from the target to the setpoint, the state actually integrated */
+	float err;
+
+	float pos;
+	float vel;
+	float acc;
+
+} TRAJ_t;
+
+void TRAJ_init(TRAJ_t *traj, float dt, float vmax, float amax, float jmax);
+
+void TRAJ_reset(TRAJ_t *traj, float pos);
+
+void TRAJ_set_limit(TRAJ_t *traj, float vmax, float amax, float jmax);
+
+void TRAJ_set_ffd_gain(TRAJ_t *traj, float kff);
+
+void TRAJ_set_vel_scale(TRAJ_t *traj, float kvel);
+
+void TRAJ_set_target(TRAJ_t *traj, float tgt);
+
+void TRAJ_calc(TRAJ_t *traj);
+
+void TRAJ_calc_batch(TRAJ_t *traj, int num);
+
+float TRAJ_get_pos(TRAJ_t *traj);
+
+float TRAJ_get_vel(TRAJ_t *traj);
+
+float TRAJ_get_acc(TRAJ_t *traj);
+
+float TRAJ_get_ffd(TRAJ_t *traj);
+
+int TRAJ_is_done(TRAJ_t *traj);
+
+int TRAJ_to_motor(TRAJ_t *traj, MOTOR_t *motor);
+
+#endif
@@ -1,4 +1,5 @@
 #include "can.h"
+#include "os_port.h"
 
 extern CanTxMsg g_tCanTxMsg; /* ڷ */
 extern CanRxMsg g_tCanRxMsg; /* ڽ */
@@ -75,10 +76,12 @@ extern void Can1InterruptHandler(void);
 
 void CAN1_RX0_IRQHandler(void)
 {
+	os_isr_enter();
 	if (CAN_GetITStatus(CAN1, CAN_IT_FMP0) != RESET)
 	{
 		CAN_ClearITPendingBit(CAN1, CAN_IT_FF0);
 		CAN_ClearFlag(CAN1, CAN_FLAG_FF0);
 		Can1InterruptHandler();
 	}
+	os_isr_exit();
 }
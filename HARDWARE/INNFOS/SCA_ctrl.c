@@ -16,15 +16,116 @@
 #include "math.h"
 #include "can.h"
 #include "SCA_ctrl.h"
+#include "timebase.h"
+#include "prof.h"
 
 static CanTxMsg g_tCanTxMsg;
 static CanRxMsg g_tCanRxMsg;
+static CanRxMsg g_tCanRxBuf[CAN_RX_BUF_SIZE]; //frames received by the interrupt, parsed by CanRxProcess()
+static volatile uint32_t g_tCanRxHead = 0;
+static volatile uint32_t g_tCanRxTail = 0;
+static volatile uint32_t g_tCanRxOverflow = 0;
+static os_sem_t CanRxSem;
+static volatile uint32_t g_tCanReqPending = 0; //replies of ActrRequest() still missing
+static os_sem_t CanReqSem;                     //posted when the last missing reply is parsed
+static volatile uint8_t g_tActrStopped = 0;    //latched by ActrSafeStop(), set commands are refused until the reset
+
+PROF_DEFINE(prof_can_rx, "can_rx");
 static ActrParaTypedef ActrDevList[ACTR_DEV_NUM]; //ִ豸ṹ飬ڱִĲ״̬
 static const uint32_t IQ24Factor = 16777216;
 static const float TempFactor = 256.0f;
 
 uint8_t devIDList[ACTR_DEV_NUM] = {2};
 
+//Send a set command unless ActrSafeStop() has latched. The interrupts are masked, so the
+//watchdog cannot stop the actuators between the check and the transmission.
+static int ActrSetTransmit(CanTxMsg *pTxMsg)
+{
+    uint32_t primask;
+    int ret = SET_PARA_ERR_STOPPED;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (!g_tActrStopped)
+    {
+        CAN_Transmit(CAN1, pTxMsg);
+        ret = SET_PARA_SUCCESS;
+    }
+    __set_PRIMASK(primask);
+
+    return ret;
+}
+
+//Bit of actrReqMask for the feedback commands ActrRequest() can track, 0 for the others
+static uint8_t ActrReqBit(uint8_t cmd)
+{
+    switch (cmd)
+    {
+    case ACTR_CMD_GET_POSTION:
+        return 0x01;
+    case ACTR_CMD_GET_SPEED:
+        return 0x02;
+    case ACTR_CMD_GET_CURRENT:
+        return 0x04;
+    default:
+        return 0x00;
+    }
+}
+
+//*********************************************************************************
+//Function: ActrAckPrepare
+//Brief:    Get ready for the reply of a command, call it before the frame is sent
+//Input:    pActrPara device, cmd command byte of the frame
+//Output:   none
+//Note:     The flag and semaphore only react to a reply carrying the same command, so a
+//          late reply of an earlier command can not complete the wait.
+//*********************************************************************************
+static void ActrAckPrepare(ActrParaTypedef *pActrPara, uint8_t cmd)
+{
+#if !OS_PREEMPTIVE
+    os_sem_clr(&CanRxSem);
+    CanRxProcess();
+#endif
+    pActrPara->actrWaitCmd = cmd;
+    pActrPara->actrParaUpdFlag = CAN_RECV_UPDATE_RESET;
+    pActrPara->actrRecvACKState = CAN_FRAME_ACK_CLEAR;
+    os_sem_clr(&pActrPara->actrAckSem);
+}
+
+//*********************************************************************************
+//Function: ActrWaitAck
+//Brief:    Wait for the reply prepared by ActrAckPrepare()
+//Input:    pActrPara device
+//Output:   0 when the reply has been parsed, -1 on timeout
+//Note:     With a kernel the calling task sleeps on the semaphore of the device and the
+//          frame is parsed by the CAN receive task. The timeout is rounded up to OS ticks.
+//          Without a kernel the core sleeps until a frame is queued, then parses it here.
+//*********************************************************************************
+static int ActrWaitAck(ActrParaTypedef *pActrPara)
+{
+#if OS_PREEMPTIVE
+    return os_sem_pend(&pActrPara->actrAckSem, CAN_WAIT_RECV_TIMEOUT_US);
+#else
+    TB_Time_t deadline = TB_deadline_us(CAN_WAIT_RECV_TIMEOUT_US);
+    uint32_t remain;
+
+    while (1)
+    {
+        CanRxProcess();
+        if (pActrPara->actrParaUpdFlag == CAN_RECV_UPDATE_SET)
+        {
+            return 0;
+        }
+        remain = TB_remain_us(deadline);
+        if (remain == 0 || os_sem_pend(&CanRxSem, remain) != 0)
+        {
+            CanRxProcess();
+            return (pActrPara->actrParaUpdFlag == CAN_RECV_UPDATE_SET) ? 0 : -1;
+        }
+    }
+#endif
+}
+
 //*********************************************************************************
 //: int SetActrMode(ActrRunModeTypedef actrMode,uint8_t actrID)
 //    ִĹģʽ
@@ -35,7 +136,6 @@ uint8_t devIDList[ACTR_DEV_NUM] = {2};
 //*********************************************************************************
 int SetActrMode(ActrRunModeTypedef actrMode, uint8_t actrID)
 {
-    uint32_t waitCanAckCounter = 0;
     ActrParaTypedef *pActrPara = NULL;
     CanTxMsg txMsg;
     pActrPara = FindActrDevByID(actrID);
@@ -43,6 +143,10 @@ int SetActrMode(ActrRunModeTypedef actrMode, uint8_t actrID)
     {
         return ACTR_SET_MODE_FIND_DEV_FAIL;
     }
+    if (g_tActrStopped)
+    {
+        return ACTR_SET_MODE_STOPPED;
+    }
     txMsg.IDE = CAN_ID_STD;
     txMsg.RTR = CAN_RTR_Data;
     txMsg.DLC = 0x02;
@@ -53,8 +157,7 @@ int SetActrMode(ActrRunModeTypedef actrMode, uint8_t actrID)
     txMsg.RTR = CAN_RTR_Data;
     txMsg.IDE = CAN_ID_STD;
 
-    pActrPara->actrParaUpdFlag = CAN_RECV_UPDATE_RESET;
-    pActrPara->actrRecvACKState = CAN_FRAME_ACK_CLEAR;
+    ActrAckPrepare(pActrPara, ACTR_CMD_SET_MODE);
     if (Can1BusyCheck() == CAN_BUS_STATE_FREE)
     {
         CAN_Transmit(CAN1, &txMsg);
@@ -64,16 +167,10 @@ int SetActrMode(ActrRunModeTypedef actrMode, uint8_t actrID)
         return ACTR_SET_MODE_SEND_FAIL;
     }
 
-    while (pActrPara->actrParaUpdFlag != CAN_RECV_UPDATE_SET)
+    if (ActrWaitAck(pActrPara) != 0)
     {
-        waitCanAckCounter++;
-        delay_us(10);
-        if (waitCanAckCounter > CAN_WAIT_RECV_TIMEOUT)
-        {
-            return ACTR_SET_MODE_ACK_FAIL;
-        }
+        return ACTR_SET_MODE_ACK_FAIL;
     }
-    CanRecvFramAnalyse(&g_tCanRxMsg, ActrDevList);
     if (pActrPara->actrRecvACKState == CAN_FRAME_ACK_SUCCESS)
     {
         if (pActrPara->actrMode == actrMode)
@@ -121,17 +218,12 @@ int SetActrPosition(float posSet, uint32_t actrID)
         g_tCanTxMsg.Data[i + CAN_FRAME_BIT_DAT_HH] = (tmpPos >> (8 * (3 - i)));
     }
 
-    if (Can1BusyCheck() == CAN_BUS_STATE_FREE)
-    {
-
-        CAN_Transmit(CAN1, &g_tCanTxMsg);
-    }
-    else
+    if (Can1BusyCheck() != CAN_BUS_STATE_FREE)
     {
         return SET_PARA_ERR_CAN_T_ERR;
     }
 
-    return SET_PARA_SUCCESS;
+    return ActrSetTransmit(&g_tCanTxMsg);
 }
 
 //*********************************************************************************
@@ -171,17 +263,12 @@ int SetActrSpeed(float speedSet, uint32_t actrID)
         g_tCanTxMsg.Data[i + CAN_FRAME_BIT_DAT_HH] = (tmpSpd >> (8 * (3 - i)));
     }
 
-    if (Can1BusyCheck() == CAN_BUS_STATE_FREE)
-    {
-
-        CAN_Transmit(CAN1, &g_tCanTxMsg);
-    }
-    else
+    if (Can1BusyCheck() != CAN_BUS_STATE_FREE)
     {
         return SET_PARA_ERR_CAN_T_ERR;
     }
 
-    return SET_PARA_SUCCESS;
+    return ActrSetTransmit(&g_tCanTxMsg);
 }
 
 //*********************************************************************************
@@ -221,17 +308,12 @@ int SetActrCurrent(float currentSet, uint32_t actrID)
         g_tCanTxMsg.Data[i + CAN_FRAME_BIT_DAT_HH] = (tmpCur >> (8 * (3 - i)));
     }
 
-    if (Can1BusyCheck() == CAN_BUS_STATE_FREE)
-    {
-
-        CAN_Transmit(CAN1, &g_tCanTxMsg);
-    }
-    else
+    if (Can1BusyCheck() != CAN_BUS_STATE_FREE)
     {
         return SET_PARA_ERR_CAN_T_ERR;
     }
 
-    return SET_PARA_SUCCESS;
+    return ActrSetTransmit(&g_tCanTxMsg);
 }
 
 //*********************************************************************************
@@ -342,7 +424,6 @@ int SetActrSpeedOutputUpperLimit(float speedSetUpperLimit, uint32_t actrID)
 //*********************************************************************************
 int ActrHandShake(uint32_t actrID)
 {
-    int32_t waitCanAckCounter = 0;
     ActrParaTypedef *pActrPara = NULL;
     pActrPara = FindActrDevByID(actrID);
     if (pActrPara == NULL)
@@ -352,8 +433,7 @@ int ActrHandShake(uint32_t actrID)
     g_tCanTxMsg.DLC = 0x01;
     g_tCanTxMsg.Data[CAN_FRAME_BIT_CMD] = ACTR_CMD_SHAKE_HAND;
     g_tCanTxMsg.StdId = actrID;
-    pActrPara->actrParaUpdFlag = CAN_RECV_UPDATE_RESET;
-    pActrPara->actrRecvACKState = CAN_FRAME_ACK_CLEAR;
+    ActrAckPrepare(pActrPara, ACTR_CMD_SHAKE_HAND);
     if (Can1BusyCheck() == CAN_BUS_STATE_FREE)
     {
 
@@ -364,21 +444,15 @@ int ActrHandShake(uint32_t actrID)
         return SET_PARA_ERR_CAN_T_ERR;
     }
 
-    while (pActrPara->actrParaUpdFlag != CAN_RECV_UPDATE_SET)
+    if (ActrWaitAck(pActrPara) != 0)
     {
-        waitCanAckCounter++;
-        delay_us(10);
-        if (waitCanAckCounter > CAN_WAIT_RECV_TIMEOUT)
+        pActrPara->actrOfflineCounter++;
+        if (pActrPara->actrOfflineCounter > ACTR_OFF_LINE_LIMIT)
         {
-            pActrPara->actrOfflineCounter++;
-            if (pActrPara->actrOfflineCounter > ACTR_OFF_LINE_LIMIT)
-            {
-                pActrPara->actrOnlineState = ACTR_STATE_OFF_LINE;
-            }
-            return SET_PARA_ERR_ACK_ERR;
+            pActrPara->actrOnlineState = ACTR_STATE_OFF_LINE;
         }
+        return SET_PARA_ERR_ACK_ERR;
     }
-    CanRecvFramAnalyse(&g_tCanRxMsg, ActrDevList);
     if (pActrPara->actrRecvACKState == CAN_FRAME_ACK_SUCCESS)
     {
         pActrPara->actrOnlineState = ACTR_STATE_ON_LINE;
@@ -407,7 +481,6 @@ int ActrHandShake(uint32_t actrID)
 //*********************************************************************************
 int SetActrPwrState(ActrPwrStateTypedef PwrState, uint32_t actrID)
 {
-    int32_t waitCanAckCounter = 0;
     ActrParaTypedef *pActrPara = NULL;
     pActrPara = FindActrDevByID(actrID);
     if (pActrPara == NULL)
@@ -418,8 +491,7 @@ int SetActrPwrState(ActrPwrStateTypedef PwrState, uint32_t actrID)
     g_tCanTxMsg.DLC = 0x02;
     g_tCanTxMsg.Data[CAN_FRAME_BIT_CMD] = ACTR_CMD_SET_ON_OFF;
     g_tCanTxMsg.Data[CAN_FRAME_BIT_DAT_HH] = PwrState;
-    pActrPara->actrParaUpdFlag = CAN_RECV_UPDATE_RESET;
-    pActrPara->actrRecvACKState = CAN_FRAME_ACK_CLEAR;
+    ActrAckPrepare(pActrPara, ACTR_CMD_SET_ON_OFF);
     if (Can1BusyCheck() == CAN_BUS_STATE_FREE)
     {
 
@@ -430,16 +502,10 @@ int SetActrPwrState(ActrPwrStateTypedef PwrState, uint32_t actrID)
         return SET_PARA_ERR_CAN_T_ERR;
     }
 
-    while (pActrPara->actrParaUpdFlag != CAN_RECV_UPDATE_SET)
+    if (ActrWaitAck(pActrPara) != 0)
     {
-        waitCanAckCounter++;
-        delay_us(10);
-        if (waitCanAckCounter > CAN_WAIT_RECV_TIMEOUT)
-        {
-            return SET_PARA_ERR_ACK_ERR;
-        }
+        return SET_PARA_ERR_ACK_ERR;
     }
-    CanRecvFramAnalyse(&g_tCanRxMsg, ActrDevList);
     if (pActrPara->actrRecvACKState == CAN_FRAME_ACK_SUCCESS)
     {
         pActrPara->actrPwrState = PwrState;
@@ -458,7 +524,6 @@ int SetActrPwrState(ActrPwrStateTypedef PwrState, uint32_t actrID)
 //*********************************************************************************
 int GetActrPara(uint8_t actrGetParaCmd, uint32_t actrID)
 {
-    int32_t waitCanAckCounter = 0;
     ActrParaTypedef *pActrPara = NULL;
     pActrPara = FindActrDevByID(actrID);
     if (pActrPara == NULL)
@@ -470,8 +535,7 @@ int GetActrPara(uint8_t actrGetParaCmd, uint32_t actrID)
                             //Ϊ0x02ʱڻȡλٶȵģʽ״̬ʱΪSET_PARA_ERR_ACK_ERR
                             //ȡ¶ȵȲʱᱨ
     g_tCanTxMsg.Data[CAN_FRAME_BIT_CMD] = actrGetParaCmd;
-    pActrPara->actrParaUpdFlag = CAN_RECV_UPDATE_RESET;
-    pActrPara->actrRecvACKState = CAN_FRAME_ACK_CLEAR;
+    ActrAckPrepare(pActrPara, actrGetParaCmd);
     if (Can1BusyCheck() == CAN_BUS_STATE_FREE)
     {
         CAN_Transmit(CAN1, &g_tCanTxMsg);
@@ -481,16 +545,10 @@ int GetActrPara(uint8_t actrGetParaCmd, uint32_t actrID)
         return GET_PARA_ERR_CAN_T_ERR;
     }
 
-    while (pActrPara->actrParaUpdFlag != CAN_RECV_UPDATE_SET)
+    if (ActrWaitAck(pActrPara) != 0)
     {
-        waitCanAckCounter++;
-        delay_us(10);
-        if (waitCanAckCounter > CAN_WAIT_RECV_TIMEOUT)
-        {
-            return SET_PARA_ERR_ACK_ERR;
-        }
+        return SET_PARA_ERR_ACK_ERR;
     }
-    CanRecvFramAnalyse(&g_tCanRxMsg, ActrDevList);
     if (pActrPara->actrRecvACKState == CAN_FRAME_ACK_SUCCESS)
     {
         return GET_PARA_SUCCESS;
@@ -508,15 +566,233 @@ int GetActrPara(uint8_t actrGetParaCmd, uint32_t actrID)
 //*********************************************************************************
 void Can1InterruptHandler(void)
 {
+    uint32_t next = (g_tCanRxHead + 1) % CAN_RX_BUF_SIZE;
+    if (next == g_tCanRxTail)
+    {
+        CAN_Receive(CAN1, CAN_FIFO0, &g_tCanRxMsg);
+        g_tCanRxOverflow++;
+        return;
+    }
+    CAN_Receive(CAN1, CAN_FIFO0, &g_tCanRxBuf[g_tCanRxHead]);
+    g_tCanRxHead = next;
+    os_sem_post(&CanRxSem);
+}
+
+//*********************************************************************************
+//Function: CanRxProcess
+//Brief:    Parse the frames queued by Can1InterruptHandler()
+//Input:    none
+//Output:   number of frames parsed
+//Note:     Run by the CAN receive task with a kernel, by the waits without. The device
+//          waiting for the command of a frame gets its flag set and its semaphore posted.
+//*********************************************************************************
+int CanRxProcess(void)
+{
+    int num = 0;
+    int done;
+    CanRxMsg *pCanRxMsg = NULL;
     ActrParaTypedef *pActrParaDev = NULL;
-    CAN_Receive(CAN1, CAN_FIFO0, &g_tCanRxMsg);
-    pActrParaDev = FindActrDevByID(g_tCanRxMsg.StdId);
-    if (pActrParaDev != NULL)
+
+    while (g_tCanRxTail != g_tCanRxHead)
+    {
+        pCanRxMsg = &g_tCanRxBuf[g_tCanRxTail];
+        PROF_START(prof_can_rx);
+        CanRecvFramAnalyse(pCanRxMsg, ActrDevList);
+        PROF_STOP(prof_can_rx);
+        pActrParaDev = FindActrDevByID(pCanRxMsg->StdId);
+        if (pActrParaDev != NULL && pActrParaDev->actrWaitCmd == pCanRxMsg->Data[CAN_FRAME_BIT_CMD]
+            && pActrParaDev->actrParaUpdFlag != CAN_RECV_UPDATE_SET)
+        {
+            pActrParaDev->actrParaUpdFlag = CAN_RECV_UPDATE_SET;
+            os_sem_post(&pActrParaDev->actrAckSem);
+        }
+        if (pActrParaDev != NULL && (pActrParaDev->actrReqMask & ActrReqBit(pCanRxMsg->Data[CAN_FRAME_BIT_CMD])))
+        {
+            __disable_irq();
+            pActrParaDev->actrReqMask &= ~ActrReqBit(pCanRxMsg->Data[CAN_FRAME_BIT_CMD]);
+            done = (g_tCanReqPending > 0 && --g_tCanReqPending == 0);
+            __enable_irq();
+            if (done)
+            {
+                os_sem_post(&CanReqSem);
+            }
+        }
+        g_tCanRxTail = (g_tCanRxTail + 1) % CAN_RX_BUF_SIZE;
+        num++;
+    }
+    return num;
+}
+
+//*********************************************************************************
+//Function: ActrRequest
+//Brief:    Request a feedback parameter without waiting for the reply
+//Input:    actrGetParaCmd ACTR_CMD_GET_POSTION, ACTR_CMD_GET_SPEED or ACTR_CMD_GET_CURRENT,
+//          actrID actuator ID
+//Output:   GET_PARA_SUCCESS, or GET_PARA_ERR_x if the frame was not sent
+//Note:     The reply is parsed into the device like for GetActrPara(). Requests to several
+//          actuators go out back to back, then ActrWaitReplies() waits for all of them.
+//*********************************************************************************
+int ActrRequest(uint8_t actrGetParaCmd, uint32_t actrID)
+{
+    uint8_t bit = ActrReqBit(actrGetParaCmd);
+    ActrParaTypedef *pActrPara = NULL;
+    pActrPara = FindActrDevByID(actrID);
+    if (pActrPara == NULL)
+    {
+        return GET_PARA_ERR_FIND_DEV;
+    }
+    if (bit == 0)
+    {
+        return GET_PARA_ERR_OUT_RANGE;
+    }
+    g_tCanTxMsg.StdId = actrID;
+    g_tCanTxMsg.DLC = 0x01;
+    g_tCanTxMsg.Data[CAN_FRAME_BIT_CMD] = actrGetParaCmd;
+
+    __disable_irq();
+    if (!(pActrPara->actrReqMask & bit))
+    {
+        pActrPara->actrReqMask |= bit;
+        g_tCanReqPending++;
+    }
+    __enable_irq();
+
+    if (Can1BusyCheck() == CAN_BUS_STATE_FREE)
+    {
+        CAN_Transmit(CAN1, &g_tCanTxMsg);
+    }
+    else
+    {
+        __disable_irq();
+        pActrPara->actrReqMask &= ~bit;
+        g_tCanReqPending--;
+        __enable_irq();
+        return GET_PARA_ERR_CAN_T_ERR;
+    }
+    return GET_PARA_SUCCESS;
+}
+
+//*********************************************************************************
+//Function: ActrWaitReplies
+//Brief:    Wait for the replies of all requests of ActrRequest()
+//Input:    timeout_us timeout in us
+//Output:   number of replies still missing, 0 if all have been parsed
+//Note:     It returns as soon as the last reply is parsed. The devices whose actrReqMask
+//          is not 0 afterwards have stale feedback. Call ActrCancelRequests() before the
+//          next round of requests.
+//*********************************************************************************
+int ActrWaitReplies(uint32_t timeout_us)
+{
+#if OS_PREEMPTIVE
+    if (g_tCanReqPending > 0)
+    {
+        os_sem_pend(&CanReqSem, timeout_us);
+    }
+    return g_tCanReqPending;
+#else
+    TB_Time_t deadline = TB_deadline_us(timeout_us);
+    uint32_t remain;
+
+    while (1)
+    {
+        CanRxProcess();
+        if (g_tCanReqPending == 0)
+        {
+            return 0;
+        }
+        remain = TB_remain_us(deadline);
+        if (remain == 0 || os_sem_pend(&CanRxSem, remain) != 0)
+        {
+            CanRxProcess();
+            return g_tCanReqPending;
+        }
+    }
+#endif
+}
+
+//*********************************************************************************
+//Function: ActrCancelRequests
+//Brief:    Forget the requests still waiting for a reply
+//Input:    none
+//Output:   none
+//Note:     A late reply is still parsed into its device, it is only not counted anymore.
+//*********************************************************************************
+void ActrCancelRequests(void)
+{
+    uint32_t i;
+
+    __disable_irq();
+    for (i = 0; i < ACTR_DEV_NUM; i++)
+    {
+        ActrDevList[i].actrReqMask = 0;
+    }
+    g_tCanReqPending = 0;
+    __enable_irq();
+    os_sem_clr(&CanReqSem);
+}
+
+//*********************************************************************************
+//Function: ActrSafeStop
+//Brief:    Command zero current to all actuators at once
+//Input:    none
+//Output:   none
+//Note:     For the watchdog, it may interrupt another transmission in any context. The
+//          frames waiting in the mailboxes are cancelled and no reply is waited for.
+//          It latches: SetActrMode/Position/Speed/Current() are refused until the reset.
+//*********************************************************************************
+void ActrSafeStop(void)
+{
+    uint32_t i;
+    CanTxMsg txMsg;
+
+    g_tActrStopped = 1;
+
+    CAN_CancelTransmit(CAN1, 0);
+    CAN_CancelTransmit(CAN1, 1);
+    CAN_CancelTransmit(CAN1, 2);
+
+    txMsg.IDE = CAN_ID_STD;
+    txMsg.RTR = CAN_RTR_Data;
+    txMsg.ExtId = 0x00;
+    txMsg.DLC = 0x05;
+    txMsg.Data[CAN_FRAME_BIT_CMD] = ACTR_CMD_SET_CURRENT;
+    txMsg.Data[CAN_FRAME_BIT_DAT_HH] = 0;
+    txMsg.Data[CAN_FRAME_BIT_DAT_HL] = 0;
+    txMsg.Data[CAN_FRAME_BIT_DAT_LH] = 0;
+    txMsg.Data[CAN_FRAME_BIT_DAT_LL] = 0;
+
+    for (i = 0; i < ACTR_DEV_NUM; i++)
     {
-        pActrParaDev->actrParaUpdFlag = CAN_RECV_UPDATE_SET;
+        ActrDevList[i].actrDestCurrent = 0.0f;
+        txMsg.StdId = ActrDevList[i].actrID;
+        if (Can1BusyCheck() == CAN_BUS_STATE_FREE)
+        {
+            CAN_Transmit(CAN1, &txMsg);
+        }
     }
 }
 
+//*********************************************************************************
+//Function: CanRxWait
+//Brief:    Wait for frames queued by Can1InterruptHandler()
+//Input:    timeout_us timeout in us, OS_WAIT_FOREVER for no timeout
+//Output:   0 when there are frames to parse, -1 on timeout
+//Note:     For the CAN receive task, call CanRxProcess() after it
+//*********************************************************************************
+int CanRxWait(uint32_t timeout_us)
+{
+    return os_sem_pend(&CanRxSem, timeout_us);
+}
+
+//*********************************************************************************
+//Function: CanRxOverflow
+//Brief:    Number of frames dropped because the receive queue was full
+//*********************************************************************************
+uint32_t CanRxOverflow(void)
+{
+    return g_tCanRxOverflow;
+}
+
 //*********************************************************************************
 //: FindActrDevByID
 //    ͨIDִ豸ṹ
@@ -577,7 +853,10 @@ void ActrDevInit(void)
     for (i = 0; i < ACTR_DEV_NUM; i++)
     {
         ActrDevList[i].actrID = devIDList[i];
+        os_sem_init(&ActrDevList[i].actrAckSem, 0);
     }
+    os_sem_init(&CanRxSem, 0);
+    os_sem_init(&CanReqSem, 0);
 }
 
 //*********************************************************************************
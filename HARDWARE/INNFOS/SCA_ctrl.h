@@ -19,10 +19,17 @@
 #include "stdint.h"
 #include "sys.h"
 #include "delay.h"
+#include "os_port.h"
 
 #define CAN_BUSY_TIMEOUT 100000
 #define CAN_WAIT_RECV_TIMEOUT 20
+#define CAN_WAIT_RECV_TIMEOUT_US (CAN_WAIT_RECV_TIMEOUT * 10)
 #define ACTR_DEV_NUM 1
+//Replies requested from each actuator per control cycle, position and speed
+#define CAN_RX_REPLY_NUM 2
+//Frames queued for CanRxProcess(): the replies of a whole cycle twice over, in case the
+//parsing falls a cycle behind, plus room for acks and heartbeats
+#define CAN_RX_BUF_SIZE (2 * CAN_RX_REPLY_NUM * ACTR_DEV_NUM + 8)
 
 #define CAN_BUS_STATE_FREE 0
 #define CAN_BUS_STATE_RESET -1
@@ -31,6 +38,7 @@
 #define ACTR_SET_MODE_FIND_DEV_FAIL -1
 #define ACTR_SET_MODE_SEND_FAIL -2
 #define ACTR_SET_MODE_ACK_FAIL -3
+#define ACTR_SET_MODE_STOPPED -4 //refused after ActrSafeStop()
 
 #define CAN_RECV_UPDATE_SET 1
 #define CAN_RECV_UPDATE_RESET 0
@@ -89,6 +97,7 @@
 #define SET_PARA_ERR_OUT_RANGE -2
 #define SET_PARA_ERR_CAN_T_ERR -3
 #define SET_PARA_ERR_ACK_ERR -4
+#define SET_PARA_ERR_STOPPED -5 //refused after ActrSafeStop()
 
 #define GET_PARA_SUCCESS 0
 #define GET_PARA_ERR_FIND_DEV -1
@@ -150,6 +159,9 @@ typedef struct ActrParaTypedef
     uint8_t actrParaUpdFlag;                    //±־
     uint8_t actrOnlineState;                    //ִ״̬
     uint8_t actrRecvACKState;                   //յִӦ״̬
+    uint8_t actrWaitCmd;                        //command whose reply is waited for
+    os_sem_t actrAckSem;                        //posted when the reply of actrWaitCmd is received
+    uint8_t actrReqMask;                        //feedback requested by ActrRequest() and not replied yet
     uint8_t actrOfflineCounter;                 //ִ״̬
     ActrRunModeTypedef actrMode;                //ִǰģʽ
     ActrPwrStateTypedef actrPwrState;           //ִػ״̬
@@ -187,10 +199,17 @@ int SetActrSpeedOutputUpperLimit(float speedSetUpperLimit, uint32_t actrID);
 int SetActrPwrState(ActrPwrStateTypedef PwrState, uint32_t actrID);
 int GetActrPara(uint8_t actrGetParaCmd, uint32_t actrID);
 int ActrHandShake(uint32_t actrID);
+int ActrRequest(uint8_t actrGetParaCmd, uint32_t actrID);
+int ActrWaitReplies(uint32_t timeout_us);
+void ActrCancelRequests(void);
+void ActrSafeStop(void);
 
 ActrParaTypedef *FindActrDevByID(uint8_t actrID);
 void CanRecvFramAnalyse(CanRxMsg *pCanRxMsg, ActrParaTypedef *pActrParaDev);
 int Can1BusyCheck(void);
+int CanRxProcess(void);
+int CanRxWait(uint32_t timeout_us);
+uint32_t CanRxOverflow(void);
 void ActrDevInit(void);
 
 #endif
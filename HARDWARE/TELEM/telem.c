@@ -0,0 +1,348 @@
+#include "telem.h"
+#include "usart.h"
+#include "string.h"
+
+/* Largest frame in bytes without the CRC, a multiple of 4 and not less than the schema */
+#define TELEM_FRAME_MAX (sizeof(TELEM_Head_t) + TELEM_JOINT_MAX * sizeof(TELEM_Rec_t))
+#define TELEM_SCHEMA_LEN 120
+#define TELEM_FIELD_NUM 8
+
+/* LSB of the PID fields per loop: current command, velocity and position of the motor */
+static const float TELEM_loop_lsb[TELEM_LOOP_NUM] = {0.002f, 0.5f, 0.01f};
+
+/* Fields of TELEM_Rec_t in order, an LSB of 0 stands for the LSB of the loop in the head */
+static const struct
+{
+    char name[8];
+    float lsb;
+} TELEM_field[TELEM_FIELD_NUM] = {
+    {"in", 0.0f},
+    {"fbk", 0.0f},
+    {"out", 0.0f},
+    {"err", 0.0f},
+    {"err_sum", 0.0f},
+    /* Feedback of the actuator in A, RPM and R */
+    {"cur", 0.001f},
+    {"vel", 0.25f},
+    {"pos", 1.0f / 256.0f},
+};
+
+/* One word more than the largest frame for the CRC */
+static uint32_t TELEM_frame[TELEM_FRAME_MAX / 4 + 1];
+static uint32_t TELEM_schema[TELEM_SCHEMA_LEN / 4 + 1];
+/* Delimiter, COBS overhead of 1 byte per 254 and the closing delimiter */
+static uint8_t TELEM_enc[TELEM_FRAME_MAX + 4 + (TELEM_FRAME_MAX + 4) / 254 + 3];
+
+static TELEM_Loop_t TELEM_loop = TELEM_LOOP_VEL;
+static float TELEM_inv_lsb[TELEM_FIELD_NUM];
+static uint16_t TELEM_seq = 0;
+/* Joint frames are sent every TELEM_joint_div cycles, never if 0, and not more often than
+   every TELEM_joint_min cycles, which keeps the frames of the last joint number within
+   TELEM_JOINT_BPS */
+static uint16_t TELEM_joint_div = 1;
+static uint16_t TELEM_joint_min = 1;
+static uint16_t TELEM_joint_cnt = 0;
+static uint32_t TELEM_rate = 0;
+static uint8_t TELEM_due = 0;
+static TELEM_Stat_t TELEM_stat;
+/* Set while a frame is encoded, the CRC unit and TELEM_enc are shared by the tasks */
+static volatile uint32_t TELEM_busy = 0;
+
+static int16_t TELEM_q(float v, float inv_lsb)
+{
+    float x = v * inv_lsb;
+
+    if (x >= 32767.0f)
+        return 32767;
+    if (x <= -32768.0f)
+        return -32768;
+    return (int16_t)(x >= 0.0f ? x + 0.5f : x - 0.5f);
+}
+
+/* Smallest divider of the joint frames with num joints, counting the CRC, COBS and delimiters */
+static uint16_t TELEM_joint_min_div(int num)
+{
+    uint32_t bytes = sizeof(TELEM_Head_t) + num * sizeof(TELEM_Rec_t) + 4 + 3;
+    uint32_t div = (bytes * TELEM_rate + TELEM_JOINT_BPS - 1) / TELEM_JOINT_BPS;
+
+    return (div > 1) ? div : 1;
+}
+
+/* Encode len bytes with COBS, return the length of the output, which has no zero byte */
+static int TELEM_cobs(const uint8_t *in, int len, uint8_t *out)
+{
+    int code_idx = 0;
+    int w = 1;
+    uint8_t code = 1;
+
+    for (int r = 0; r < len; r++)
+    {
+        if (in[r] == 0)
+        {
+            out[code_idx] = code;
+            code = 1;
+            code_idx = w++;
+        }
+        else
+        {
+            out[w++] = in[r];
+            if (++code == 0xFF)
+            {
+                out[code_idx] = code;
+                code = 1;
+                code_idx = w++;
+            }
+        }
+    }
+    out[code_idx] = code;
+
+    return w;
+}
+
+static void TELEM_set_inv_lsb(void)
+{
+    for (int i = 0; i < TELEM_FIELD_NUM; i++)
+    {
+        float lsb = (TELEM_field[i].lsb != 0.0f) ? TELEM_field[i].lsb : TELEM_loop_lsb[TELEM_loop];
+        TELEM_inv_lsb[i] = 1.0f / lsb;
+    }
+}
+
+/**
+	* @Function:	Start the CRC unit and send the schema
+	* @Parameter:	- rate_hz:	rate of the frames
+	* @Return:		none
+	* @Attention:	The schema is 8 bytes of type, version, field number, record size and rate,
+                    4 bytes of the maximum joint number and the loop number, the LSB of the PID fields
+                    per loop, then the name and the LSB of each field of TELEM_Rec_t.
+*/
+void TELEM_init(uint32_t rate_hz)
+{
+    uint8_t *p = (uint8_t *)TELEM_schema;
+
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_CRC, ENABLE);
+
+    memset(TELEM_schema, 0, sizeof(TELEM_schema));
+    p[0] = TELEM_TYPE_SCHEMA;
+    p[1] = TELEM_VERSION;
+    p[2] = TELEM_FIELD_NUM;
+    p[3] = sizeof(TELEM_Rec_t);
+    memcpy(p + 4, &rate_hz, 4);
+    p[8] = TELEM_JOINT_MAX;
+    p[9] = TELEM_LOOP_NUM;
+    memcpy(p + 12, TELEM_loop_lsb, sizeof(TELEM_loop_lsb));
+    for (int i = 0; i < TELEM_FIELD_NUM; i++)
+    {
+        memcpy(p + 24 + i * 12, TELEM_field[i].name, 8);
+        memcpy(p + 24 + i * 12 + 8, &TELEM_field[i].lsb, 4);
+    }
+
+    TELEM_set_inv_lsb();
+    TELEM_rate = rate_hz;
+    TELEM_joint_min = TELEM_joint_min_div(TELEM_JOINT_MAX);
+    TELEM_seq = 0;
+    TELEM_stat.frames = 0;
+    TELEM_stat.drops = 0;
+    TELEM_stat.bytes = 0;
+
+    TELEM_send(TELEM_schema, TELEM_SCHEMA_LEN);
+}
+
+/**
+	* @Function:	Select the loop whose PID state goes into the joint records
+	* @Parameter:	- loop:	current, velocity or position loop
+	* @Return:		none
+	* @Attention:	Takes effect from the next frame, the head carries the loop.
+*/
+void TELEM_set_loop(TELEM_Loop_t loop)
+{
+    if (loop >= TELEM_LOOP_NUM)
+        return;
+
+    TELEM_loop = loop;
+    TELEM_set_inv_lsb();
+}
+
+TELEM_Loop_t TELEM_get_loop(void)
+{
+    return TELEM_loop;
+}
+
+/**
+	* @Function:	Start a frame of joint records
+	* @Parameter:	- t_us:	time of the sample in us
+	* @Return:		none
+	* @Attention:	TELEM_begin(), TELEM_add() and TELEM_end() are called from the control cycle only.
+                    In the cycles where no frame is due, TELEM_add() and TELEM_end() return at once.
+*/
+void TELEM_begin(uint32_t t_us)
+{
+    TELEM_Head_t *head = (TELEM_Head_t *)TELEM_frame;
+    uint16_t div = (TELEM_joint_div > TELEM_joint_min) ? TELEM_joint_div : TELEM_joint_min;
+
+    TELEM_due = 0;
+    if (TELEM_joint_div == 0 || ++TELEM_joint_cnt < div)
+        return;
+    TELEM_joint_cnt = 0;
+    TELEM_due = 1;
+
+    head->type = TELEM_TYPE_JOINT;
+    head->num = 0;
+    head->loop = TELEM_loop;
+    head->ver = TELEM_VERSION;
+    head->t_us = t_us;
+    head->seq = TELEM_seq;
+    head->stale = 0;
+}
+
+/**
+	* @Function:	Add the record of a joint to the frame
+	* @Parameter:	- motor:	controller of the joint
+                    - actr:		actuator of the joint, NULL if there is none
+                    - stale:	whether the feedback of the joint was not updated in this cycle
+	* @Return:		none
+	* @Attention:	Joints beyond TELEM_JOINT_MAX are ignored.
+*/
+void TELEM_add(const MOTOR_t *motor, const ActrParaTypedef *actr, int stale)
+{
+    TELEM_Head_t *head = (TELEM_Head_t *)TELEM_frame;
+    TELEM_Rec_t *rec = (TELEM_Rec_t *)(head + 1) + head->num;
+    const PID_t *pid;
+
+    if (!TELEM_due || head->num >= TELEM_JOINT_MAX)
+        return;
+
+    switch (TELEM_loop)
+    {
+    case TELEM_LOOP_CUR:
+        pid = &motor->pid_cur;
+        break;
+    case TELEM_LOOP_POS:
+        pid = &motor->pid_pos;
+        break;
+    default:
+        pid = &motor->pid_vel;
+        break;
+    }
+
+    rec->in = TELEM_q(pid->in, TELEM_inv_lsb[0]);
+    rec->fbk = TELEM_q(pid->fbk, TELEM_inv_lsb[1]);
+    rec->out = TELEM_q(pid->out[0], TELEM_inv_lsb[2]);
+    rec->err = TELEM_q(pid->err[0], TELEM_inv_lsb[3]);
+    rec->err_sum = TELEM_q(pid->err_sum, TELEM_inv_lsb[4]);
+    rec->cur = actr ? TELEM_q(actr->actrCurrent, TELEM_inv_lsb[5]) : 0;
+    rec->vel = actr ? TELEM_q(actr->actrSpeed, TELEM_inv_lsb[6]) : 0;
+    rec->pos = actr ? TELEM_q(actr->actrPostion, TELEM_inv_lsb[7]) : 0;
+
+    if (stale)
+        head->stale |= 1 << head->num;
+    head->num++;
+}
+
+/**
+	* @Function:	Send the frame of joint records
+	* @Parameter:	none
+	* @Return:		number of bytes queued, 0 if the frame was dropped or not due
+	* @Attention:	The schema goes out in front of every TELEM_SCHEMA_PERIOD-th frame.
+                    The smallest divider follows the joint number of the frame, from the next one.
+*/
+int TELEM_end(void)
+{
+    TELEM_Head_t *head = (TELEM_Head_t *)TELEM_frame;
+
+    if (!TELEM_due)
+        return 0;
+
+    if (TELEM_seq % TELEM_SCHEMA_PERIOD == 0 && TELEM_seq != 0)
+        TELEM_send(TELEM_schema, TELEM_SCHEMA_LEN);
+
+    TELEM_seq++;
+    TELEM_joint_min = TELEM_joint_min_div(head->num);
+    return TELEM_send(TELEM_frame, sizeof(TELEM_Head_t) + head->num * sizeof(TELEM_Rec_t));
+}
+
+/**
+	* @Function:	Append the CRC to a frame, encode it with COBS and queue it to the serial port
+	* @Parameter:	- frame:	frame, with a free word after it for the CRC
+                    - len:		length of the frame in bytes, a multiple of 4
+	* @Return:		number of bytes queued, 0 if the frame was dropped
+	* @Attention:	The CRC is CRC-32/MPEG-2 of the hardware unit over the little endian words.
+                    A frame is a zero byte, the COBS encoded frame and CRC, and a zero byte,
+                    so the text output of printf in between is told apart by the host.
+                    It may be called from any task, a frame finding another one being encoded
+                    is dropped rather than waiting.
+*/
+int TELEM_send(uint32_t *frame, int len)
+{
+    int n;
+
+    if (len > (int)TELEM_FRAME_MAX)
+        return 0;
+
+    do
+    {
+        if (__LDREXW(&TELEM_busy))
+        {
+            __CLREX();
+            TELEM_stat.drops++;
+            return 0;
+        }
+    } while (__STREXW(1, &TELEM_busy));
+    __DMB();
+
+    CRC_ResetDR();
+    frame[len / 4] = CRC_CalcBlockCRC(frame, len / 4);
+
+    TELEM_enc[0] = 0;
+    n = TELEM_cobs((const uint8_t *)frame, len + 4, TELEM_enc + 1) + 1;
+    TELEM_enc[n++] = 0;
+
+    TELEM_stat.frames++;
+    if (usart_write(TELEM_enc, n) == 0)
+    {
+        TELEM_stat.drops++;
+        n = 0;
+    }
+    TELEM_stat.bytes += n;
+
+    __DMB();
+    TELEM_busy = 0;
+
+    return n;
+}
+
+void TELEM_get_stat(TELEM_Stat_t *stat)
+{
+    *stat = TELEM_stat;
+}
+
+/**
+	* @Function:	Set the decimation of the joint frames
+	* @Parameter:	- div:	a frame every div cycles, 0 to stop the joint frames
+	* @Return:		none
+	* @Attention:	A divider below the one keeping the frames within TELEM_JOINT_BPS is raised to
+                    it, 2 with 12 joints at 1 kHz, see TELEM_get_joint_div().
+*/
+void TELEM_set_joint_div(uint16_t div)
+{
+    TELEM_joint_div = div;
+    TELEM_joint_cnt = 0;
+}
+
+/**
+	* @Function:	Get the divider the joint frames are sent with
+	* @Parameter:	none
+	* @Return:		the divider set, or the smallest one within the budget if larger, 0 if stopped
+	* @Attention:	none
+*/
+uint16_t TELEM_get_joint_div(void)
+{
+    if (TELEM_joint_div == 0)
+        return 0;
+    return (TELEM_joint_div > TELEM_joint_min) ? TELEM_joint_div : TELEM_joint_min;
+}
+
+uint32_t TELEM_get_rate(void)
+{
+    return TELEM_rate;
+}
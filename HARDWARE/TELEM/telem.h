@@ -0,0 +1,179 @@
+#ifndef _TELEM_H
+#define _TELEM_H
+#include "sys.h"
+#include "stdint.h"
+#include "motor.h"
+#include "SCA_ctrl.h"
+
+/* Baud rate of USART1 carrying the telemetry, the highest of the CH340 on PA9/PA10, exact with
+   the 84 MHz APB2 clock */
+#define TELEM_BAUD 2000000
+/* Bytes per second of the link, 10 bits a byte */
+#define TELEM_LINK_BPS (TELEM_BAUD / 10)
+/* Shares of the link in bytes per second for the joint frames and the subscribed channels */
+#define TELEM_JOINT_BPS (TELEM_LINK_BPS * 55 / 100)
+#define TELEM_CHAN_BPS (TELEM_LINK_BPS * 15 / 100)
+/* Version of the frame layout, raised on any change of it */
+#define TELEM_VERSION 1
+/* Maximum number of joints in a frame */
+#define TELEM_JOINT_MAX 12
+/* The schema is sent again every so many frames, so a host connecting late can decode */
+#define TELEM_SCHEMA_PERIOD 1000
+/* Channels registered for each joint by init_task_telem(): 6 of each PID loop, the current,
+   velocity, position and temperature of the actuator, stale, and the output and contact of
+   the disturbance observer */
+#define TELEM_CHAN_JOINT 25
+/* Channels not tied to a joint, the timing of the cycle, the profiler and the serial port */
+#define TELEM_CHAN_GLOBAL 16
+/* Maximum number of registered channels and of subscribed ones */
+#define TELEM_CHAN_MAX (TELEM_CHAN_JOINT * TELEM_JOINT_MAX + TELEM_CHAN_GLOBAL)
+#define TELEM_SUB_MAX 24
+/* Length of a channel name with the terminating zero */
+#define TELEM_NAME_LEN 16
+
+/*
+ * Budget of the link, 200 kB/s at 10 bits a byte, at 1 kHz with 12 joints. COBS and the
+ * delimiters add 3 bytes to a frame of up to 254 bytes.
+ * - joint:   12 head + 16 per record + 4 CRC, 211 bytes with 12 joints. The divider of the
+ *            joint frames is raised to keep them within TELEM_JOINT_BPS, 55 %: 12 joints go
+ *            out every 2nd cycle, 106 kB/s, 53 %, a single joint every cycle, 35 kB/s
+ * - channel: 8 head + 8 per sample + 4 CRC, sent in the cycles where a sample is due,
+ *            15 bytes + 8 per sample. TELEM_sub() refuses a subscription taking the channels
+ *            past TELEM_CHAN_BPS, 15 %: one channel every cycle is 23 kB/s, 12 %
+ * - log:     up to LOG_DRAIN_FRAMES frames of 4 * (3 + LOG_FRAME_WORDS) + 4 = 208 bytes per
+ *            run of the telemetry task every 5 ms, 42 kB/s when the ring is full, 21 %
+ * - text:    answers to the commands only, the long ones are paged by TELEM_page(), so a
+ *            burst is at most the free part of the serial port buffer
+ * The producers fit together at their peaks, 91 % of the link.
+ * A frame which does not fit in the serial port buffer is dropped whole and counted.
+ */
+
+typedef enum TELEM_Type_t
+{
+    TELEM_TYPE_SCHEMA = 0x01,
+    TELEM_TYPE_JOINT = 0x02,
+    /* Entries of the deferred log, sent by log_drain() */
+    TELEM_TYPE_LOG = 0x03,
+    /* Samples of the subscribed channels */
+    TELEM_TYPE_CHAN = 0x04,
+} TELEM_Type_t;
+
+/* Loop of the motor whose PID state goes into the joint records */
+typedef enum TELEM_Loop_t
+{
+    TELEM_LOOP_CUR = 0x00,
+    TELEM_LOOP_VEL = 0x01,
+    TELEM_LOOP_POS = 0x02,
+    TELEM_LOOP_NUM = 0x03,
+} TELEM_Loop_t;
+
+/* Head of a frame of joint records, little endian */
+typedef struct TELEM_Head_t
+{
+    uint8_t type;
+    uint8_t num;
+    uint8_t loop;
+    uint8_t ver;
+    /* Time of the sample in us, wraps around */
+    uint32_t t_us;
+    uint16_t seq;
+    /* Bit i is set if the feedback of joint i is stale */
+    uint16_t stale;
+} TELEM_Head_t;
+
+/* Snapshot of a joint, each field is the value divided by its LSB in the schema and saturated */
+typedef struct TELEM_Rec_t
+{
+    int16_t in;
+    int16_t fbk;
+    int16_t out;
+    int16_t err;
+    int16_t err_sum;
+    int16_t cur;
+    int16_t vel;
+    int16_t pos;
+} TELEM_Rec_t;
+
+/* Type of the variable behind a channel, a sample carries it widened to 32 bits */
+typedef enum TELEM_Var_t
+{
+    TELEM_VAR_F32 = 0x00,
+    TELEM_VAR_U32 = 0x01,
+    TELEM_VAR_I32 = 0x02,
+    TELEM_VAR_U16 = 0x03,
+    TELEM_VAR_I16 = 0x04,
+    TELEM_VAR_U8 = 0x05,
+} TELEM_Var_t;
+
+/* Variable registered for sampling, its ID is the index in the registry */
+typedef struct TELEM_Chan_t
+{
+    char name[TELEM_NAME_LEN];
+    const volatile void *addr;
+    uint8_t type;
+    /* Decimation while subscribed, 0 if not subscribed */
+    uint16_t div;
+} TELEM_Chan_t;
+
+/* Sample of a channel in a frame of TELEM_TYPE_CHAN, after a head of type, version, number and time */
+typedef struct TELEM_Sample_t
+{
+    uint16_t id;
+    uint16_t type;
+    uint32_t val;
+} TELEM_Sample_t;
+
+typedef struct TELEM_Stat_t
+{
+    unsigned int frames;
+    /* Frames which did not fit in the serial port buffer */
+    unsigned int drops;
+    unsigned int bytes;
+} TELEM_Stat_t;
+
+/* Prints the given line of a long answer, returns 0 past the last line, see TELEM_page() */
+typedef int (*TELEM_Line_t)(int line);
+
+void TELEM_init(uint32_t rate_hz);
+
+void TELEM_set_loop(TELEM_Loop_t loop);
+
+TELEM_Loop_t TELEM_get_loop(void);
+
+void TELEM_begin(uint32_t t_us);
+
+void TELEM_add(const MOTOR_t *motor, const ActrParaTypedef *actr, int stale);
+
+int TELEM_end(void);
+
+int TELEM_send(uint32_t *frame, int len);
+
+void TELEM_get_stat(TELEM_Stat_t *stat);
+
+void TELEM_set_joint_div(uint16_t div);
+
+uint16_t TELEM_get_joint_div(void);
+
+uint32_t TELEM_get_rate(void);
+
+int TELEM_reg(const char *name, TELEM_Var_t type, const volatile void *addr);
+
+int TELEM_find(const char *name);
+
+int TELEM_sub(int id, uint16_t div);
+
+int TELEM_unsub(int id);
+
+void TELEM_unsub_all(void);
+
+int TELEM_list_line(int line);
+
+int TELEM_page(TELEM_Line_t func);
+
+void TELEM_page_run(void);
+
+void TELEM_sample(uint32_t t_us);
+
+int TELEM_cmd(char *line);
+
+#endif
@@ -0,0 +1,366 @@
+#include "telem.h"
+#include "usart.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+/* Subscribed channel with its decimation counter */
+typedef struct TELEM_Sub_t
+{
+    uint16_t id;
+    uint16_t div;
+    uint16_t cnt;
+} TELEM_Sub_t;
+
+static const char *const TELEM_var_name[] = {"f32", "u32", "i32", "u16", "i16", "u8"};
+
+static TELEM_Chan_t TELEM_chan[TELEM_CHAN_MAX];
+static int TELEM_chan_num = 0;
+static TELEM_Sub_t TELEM_subs[TELEM_SUB_MAX];
+static volatile int TELEM_sub_num = 0;
+/* Head of 2 words, the samples and a word for the CRC */
+static uint32_t TELEM_chan_frame[2 + TELEM_SUB_MAX * sizeof(TELEM_Sample_t) / 4 + 1];
+/* Long answer being printed and its next line */
+static TELEM_Line_t TELEM_page_func = 0;
+static int TELEM_page_line = 0;
+
+static uint32_t TELEM_read(const TELEM_Chan_t *c)
+{
+    switch (c->type)
+    {
+    case TELEM_VAR_U16:
+        return *(const volatile uint16_t *)c->addr;
+    case TELEM_VAR_I16:
+        return (uint32_t)(int32_t)*(const volatile int16_t *)c->addr;
+    case TELEM_VAR_U8:
+        return *(const volatile uint8_t *)c->addr;
+    default:
+        return *(const volatile uint32_t *)c->addr;
+    }
+}
+
+/* ID of a channel given by its name or its ID, -1 if there is none */
+static int TELEM_lookup(const char *arg)
+{
+    int id;
+
+    if (arg[0] < '0' || arg[0] > '9')
+        return TELEM_find(arg);
+
+    id = atoi(arg);
+    return (id < TELEM_chan_num) ? id : -1;
+}
+
+/**
+	* @Function:	Register a variable as a channel
+	* @Parameter:	- name:	name of the channel, cut to TELEM_NAME_LEN - 1 characters
+                    - type:	type of the variable
+                    - addr:	address of the variable, which lives as long as the program
+	* @Return:		ID of the channel, -1 if the registry is full
+	* @Attention:	Call it during the initialization, before the tasks run.
+*/
+int TELEM_reg(const char *name, TELEM_Var_t type, const volatile void *addr)
+{
+    TELEM_Chan_t *c;
+
+    if (TELEM_chan_num >= TELEM_CHAN_MAX)
+        return -1;
+
+    c = &TELEM_chan[TELEM_chan_num];
+    strncpy(c->name, name, TELEM_NAME_LEN - 1);
+    c->name[TELEM_NAME_LEN - 1] = 0;
+    c->addr = addr;
+    c->type = type;
+    c->div = 0;
+
+    return TELEM_chan_num++;
+}
+
+/**
+	* @Function:	Find a channel by its name
+	* @Parameter:	- name:	name of the channel
+	* @Return:		ID of the channel, -1 if there is none
+	* @Attention:	none
+*/
+int TELEM_find(const char *name)
+{
+    for (int i = 0; i < TELEM_chan_num; i++)
+    {
+        if (strncmp(TELEM_chan[i].name, name, TELEM_NAME_LEN) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/* Bytes per second of the channel frames if channel id is sampled every div cycles, the frame
+   overhead is counted at the rate of the most frequent channel */
+static uint32_t TELEM_chan_bps(int id, uint16_t div)
+{
+    uint32_t rate = TELEM_get_rate();
+    uint32_t bytes = sizeof(TELEM_Sample_t) * rate / div;
+    uint16_t div_min = div;
+
+    for (int i = 0; i < TELEM_sub_num; i++)
+    {
+        if (TELEM_subs[i].id == id)
+            continue;
+        bytes += sizeof(TELEM_Sample_t) * rate / TELEM_subs[i].div;
+        if (TELEM_subs[i].div < div_min)
+            div_min = TELEM_subs[i].div;
+    }
+
+    return bytes + (8 + 4 + 3) * rate / div_min;
+}
+
+/**
+	* @Function:	Subscribe a channel, or change its decimation
+	* @Parameter:	- id:	ID of the channel
+                    - div:	the channel is sampled every div cycles
+	* @Return:		0 if done, -1 if the ID or the decimation is invalid, the subscriptions are full
+                    or the channels would take more than TELEM_CHAN_BPS
+	* @Attention:	May be called while the control cycle runs.
+*/
+int TELEM_sub(int id, uint16_t div)
+{
+    u32 primask;
+    int i;
+
+    if (id < 0 || id >= TELEM_chan_num || div == 0)
+        return -1;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    for (i = 0; i < TELEM_sub_num; i++)
+    {
+        if (TELEM_subs[i].id == id)
+            break;
+    }
+    if (i == TELEM_SUB_MAX || TELEM_chan_bps(id, div) > TELEM_CHAN_BPS)
+    {
+        __set_PRIMASK(primask);
+        return -1;
+    }
+    TELEM_subs[i].id = id;
+    TELEM_subs[i].div = div;
+    TELEM_subs[i].cnt = 0;
+    if (i == TELEM_sub_num)
+        TELEM_sub_num++;
+    TELEM_chan[id].div = div;
+    __set_PRIMASK(primask);
+
+    return 0;
+}
+
+/**
+	* @Function:	Unsubscribe a channel
+	* @Parameter:	- id:	ID of the channel
+	* @Return:		0 if done, -1 if the channel was not subscribed
+	* @Attention:	May be called while the control cycle runs.
+*/
+int TELEM_unsub(int id)
+{
+    u32 primask = __get_PRIMASK();
+    int ret = -1;
+
+    __disable_irq();
+    for (int i = 0; i < TELEM_sub_num; i++)
+    {
+        if (TELEM_subs[i].id == id)
+        {
+            TELEM_subs[i] = TELEM_subs[--TELEM_sub_num];
+            TELEM_chan[id].div = 0;
+            ret = 0;
+            break;
+        }
+    }
+    __set_PRIMASK(primask);
+
+    return ret;
+}
+
+void TELEM_unsub_all(void)
+{
+    u32 primask = __get_PRIMASK();
+
+    __disable_irq();
+    for (int i = 0; i < TELEM_sub_num; i++)
+        TELEM_chan[TELEM_subs[i].id].div = 0;
+    TELEM_sub_num = 0;
+    __set_PRIMASK(primask);
+}
+
+/**
+	* @Function:	Print a line of the registry
+	* @Parameter:	- line:	line of the answer
+	* @Return:		0 past the last line, 1 otherwise
+	* @Attention:	One line "CH id name type div" per channel, div is 0 if not subscribed,
+                    then "END number". It is printed by TELEM_page().
+*/
+int TELEM_list_line(int line)
+{
+    if (line < TELEM_chan_num)
+        printf("CH %d %s %s %u\r\n", line, TELEM_chan[line].name, TELEM_var_name[TELEM_chan[line].type], TELEM_chan[line].div);
+    else if (line == TELEM_chan_num)
+        printf("END %d\r\n", TELEM_chan_num);
+    else
+        return 0;
+
+    return 1;
+}
+
+/**
+	* @Function:	Start printing a long answer
+	* @Parameter:	- func:	function printing the answer a line at a time
+	* @Return:		operation status
+                    - 0:	the answer is started
+                    - -1:	another answer is being printed
+	* @Attention:	The serial port buffer is smaller than the long answers, and printf drops
+                    the lines which do not fit, so the answer is printed by TELEM_page_run() as
+                    the buffer drains. Short answers of other commands may come in between.
+*/
+int TELEM_page(TELEM_Line_t func)
+{
+    if (TELEM_page_func != 0)
+        return -1;
+
+    TELEM_page_func = func;
+    TELEM_page_line = 0;
+
+    return 0;
+}
+
+/**
+	* @Function:	Print the lines of the long answer which fit in the serial port buffer
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	Call it in every run of the telemetry task.
+*/
+void TELEM_page_run(void)
+{
+    while (TELEM_page_func != 0 && usart_tx_free() >= USART_LINE_LEN)
+    {
+        if (!TELEM_page_func(TELEM_page_line++))
+            TELEM_page_func = 0;
+    }
+}
+
+/**
+	* @Function:	Sample the subscribed channels which are due and send them
+	* @Parameter:	- t_us:	time of the sample in us
+	* @Return:		none
+	* @Attention:	Called once per control cycle, it only walks the subscribed channels,
+                    and sends nothing if none is due.
+*/
+void TELEM_sample(uint32_t t_us)
+{
+    TELEM_Sample_t *smp = (TELEM_Sample_t *)(TELEM_chan_frame + 2);
+    uint8_t *head = (uint8_t *)TELEM_chan_frame;
+    int n = 0;
+
+    for (int i = 0; i < TELEM_sub_num; i++)
+    {
+        TELEM_Sub_t *sub = &TELEM_subs[i];
+
+        if (++sub->cnt < sub->div)
+            continue;
+        sub->cnt = 0;
+
+        smp[n].id = sub->id;
+        smp[n].type = TELEM_chan[sub->id].type;
+        smp[n].val = TELEM_read(&TELEM_chan[sub->id]);
+        n++;
+    }
+    if (n == 0)
+        return;
+
+    head[0] = TELEM_TYPE_CHAN;
+    head[1] = TELEM_VERSION;
+    head[2] = n;
+    head[3] = 0;
+    TELEM_chan_frame[1] = t_us;
+    TELEM_send(TELEM_chan_frame, 8 + n * sizeof(TELEM_Sample_t));
+}
+
+/**
+	* @Function:	Run a telemetry command received on the serial port
+	* @Parameter:	- line:	command without the line end
+	* @Return:		1 if it was a telemetry command, 0 otherwise
+	* @Attention:	The commands are
+                    LIST					print the registry
+                    SUB name|id [div]		subscribe a channel, every div cycles, 1 by default
+                    UNSUB name|id|ALL		unsubscribe channels
+                    JOINT div				send the joint frames every div cycles, 0 to stop them,
+                                            answers the divider within the budget
+                    LOOP cur|vel|pos		select the loop of the joint frames
+                    Each one answers with a line starting with OK or ERR.
+*/
+int TELEM_cmd(char *line)
+{
+    char cmd[8];
+    char arg[TELEM_NAME_LEN];
+    unsigned int div = 1;
+    int n, id;
+
+    n = sscanf(line, "%7s %15s %u", cmd, arg, &div);
+    if (n < 1)
+        return 0;
+
+    if (strcmp(cmd, "LIST") == 0)
+    {
+        if (TELEM_page(TELEM_list_line) != 0)
+            printf("ERR LIST busy\r\n");
+    }
+    else if (strcmp(cmd, "SUB") == 0)
+    {
+        id = (n >= 2) ? TELEM_lookup(arg) : -1;
+        div = (div > 0xFFFF) ? 0xFFFF : div;
+        if (TELEM_sub(id, div) == 0)
+            printf("OK SUB %d %s %u\r\n", id, TELEM_chan[id].name, div);
+        else
+            printf("ERR SUB\r\n");
+    }
+    else if (strcmp(cmd, "UNSUB") == 0)
+    {
+        if (n >= 2 && strcmp(arg, "ALL") == 0)
+        {
+            TELEM_unsub_all();
+            printf("OK UNSUB ALL\r\n");
+        }
+        else if (n >= 2 && TELEM_unsub(id = TELEM_lookup(arg)) == 0)
+            printf("OK UNSUB %d\r\n", id);
+        else
+            printf("ERR UNSUB\r\n");
+    }
+    else if (strcmp(cmd, "JOINT") == 0)
+    {
+        if (n >= 2 && arg[0] >= '0' && arg[0] <= '9')
+        {
+            TELEM_set_joint_div((uint16_t)atoi(arg));
+            printf("OK JOINT %u\r\n", TELEM_get_joint_div());
+        }
+        else
+            printf("ERR JOINT\r\n");
+    }
+    else if (strcmp(cmd, "LOOP") == 0)
+    {
+        if (n >= 2 && strcmp(arg, "cur") == 0)
+            TELEM_set_loop(TELEM_LOOP_CUR);
+        else if (n >= 2 && strcmp(arg, "vel") == 0)
+            TELEM_set_loop(TELEM_LOOP_VEL);
+        else if (n >= 2 && strcmp(arg, "pos") == 0)
+            TELEM_set_loop(TELEM_LOOP_POS);
+        else
+        {
+            printf("ERR LOOP\r\n");
+            return 1;
+        }
+        printf("OK LOOP %s\r\n", arg);
+    }
+    else
+    {
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,187 @@
+#include "timebase.h"
+
+/*
+ * The 32-bit cycle counter of the DWT is extended to 64 bits by counting its
+ * half turns. TB_epoch is the number of half turns, so its lowest bit is the
+ * expected top bit of the counter. A reader which finds the top bit different
+ * knows that the counter went into the next half turn after the last update
+ * and adds one. This is exact as long as TB_update() runs at least once per half
+ * turn, 12.7s at 168MHz, which the control tick does many times over.
+ * The state is a single word written by a single store, so readers in any
+ * context, even one interrupting TB_update(), need no lock and no retry.
+ */
+static volatile uint32_t TB_epoch = 0;
+static uint32_t TB_cyc_us = 168;
+
+/* Interval in cycles to us, saturated at 0xFFFFFFFF, with a 32-bit division below 25s */
+static uint32_t TB_interval_us(TB_Time_t d)
+{
+    if (d >> 32)
+    {
+        d /= TB_cyc_us;
+        return (d >> 32) ? 0xFFFFFFFF : (uint32_t)d;
+    }
+    return (uint32_t)d / TB_cyc_us;
+}
+
+/**
+	* @Function:	Start the cycle counter of the DWT as the timebase
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	Call it once at startup, before any timestamp is taken.
+                    The counter stops with the core clock in WFI, so the clock is kept running
+                    in sleep mode by DBG_SLEEP. The core still sleeps, only the saving of power
+                    is smaller.
+*/
+void TB_init(void)
+{
+    TB_cyc_us = SystemCoreClock / 1000000;
+
+    DBGMCU->CR |= DBGMCU_CR_DBG_SLEEP;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    TB_epoch = 0;
+}
+
+/**
+	* @Function:	Follow the half turns of the cycle counter
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	Called by the tick interrupt of TIM3. It must be the only writer.
+*/
+void TB_update(void)
+{
+    uint32_t e = TB_epoch;
+
+    if ((DWT->CYCCNT >> 31) != (e & 1))
+        TB_epoch = e + 1;
+}
+
+/**
+	* @Function:	Get the present time
+	* @Parameter:	none
+	* @Return:		time in cycles since TB_init()
+	* @Attention:	Safe in interrupts and tasks, it takes about ten cycles.
+*/
+TB_Time_t TB_now(void)
+{
+    uint32_t e = TB_epoch;
+    uint32_t c = DWT->CYCCNT;
+
+    e += (c >> 31) ^ (e & 1);
+    return ((TB_Time_t)(e >> 1) << 32) | c;
+}
+
+/**
+	* @Function:	Get the number of cycles per us
+	* @Parameter:	none
+	* @Return:		cycles per us
+	* @Attention:	none
+*/
+uint32_t TB_cyc_per_us(void)
+{
+    return TB_cyc_us;
+}
+
+/**
+	* @Function:	Convert a time or an interval to ns
+	* @Parameter:	- t:	time in cycles
+	* @Return:		time in ns
+	* @Attention:	It uses a 64-bit division, keep it out of the fast paths and compare
+                    times in cycles there.
+*/
+uint64_t TB_to_ns(TB_Time_t t)
+{
+    return t * 1000 / TB_cyc_us;
+}
+
+/**
+	* @Function:	Convert a time or an interval to us
+	* @Parameter:	- t:	time in cycles
+	* @Return:		time in us
+	* @Attention:	It uses a 64-bit division, see TB_to_ns().
+*/
+uint64_t TB_to_us(TB_Time_t t)
+{
+    return t / TB_cyc_us;
+}
+
+/**
+	* @Function:	Convert an interval in us to cycles
+	* @Parameter:	- us:	interval in us
+	* @Return:		interval in cycles
+	* @Attention:	none
+*/
+TB_Time_t TB_from_us(uint32_t us)
+{
+    return (TB_Time_t)us * TB_cyc_us;
+}
+
+/**
+	* @Function:	Get the present time in ns
+	* @Parameter:	none
+	* @Return:		time in ns since TB_init()
+	* @Attention:	none
+*/
+uint64_t TB_ns(void)
+{
+    return TB_to_ns(TB_now());
+}
+
+/**
+	* @Function:	Get the present time in us
+	* @Parameter:	none
+	* @Return:		time in us since TB_init()
+	* @Attention:	none
+*/
+uint64_t TB_us(void)
+{
+    return TB_to_us(TB_now());
+}
+
+/**
+	* @Function:	Get the time passed since a timestamp
+	* @Parameter:	- since:	timestamp of TB_now()
+	* @Return:		interval in us, saturated at 0xFFFFFFFF
+	* @Attention:	none
+*/
+uint32_t TB_elapsed_us(TB_Time_t since)
+{
+    return TB_interval_us(TB_now() - since);
+}
+
+/**
+	* @Function:	Get a deadline from now
+	* @Parameter:	- us:	interval in us
+	* @Return:		deadline in cycles
+	* @Attention:	none
+*/
+TB_Time_t TB_deadline_us(uint32_t us)
+{
+    return TB_now() + TB_from_us(us);
+}
+
+/**
+	* @Function:	Check a deadline
+	* @Parameter:	- deadline:	deadline of TB_deadline_us()
+	* @Return:		1 if the deadline has passed, 0 if not
+	* @Attention:	none
+*/
+int TB_expired(TB_Time_t deadline)
+{
+    return TB_now() >= deadline;
+}
+
+/**
+	* @Function:	Get the time left before a deadline
+	* @Parameter:	- deadline:	deadline of TB_deadline_us()
+	* @Return:		time left in us, 0 if the deadline has passed
+	* @Attention:	none
+*/
+uint32_t TB_remain_us(TB_Time_t deadline)
+{
+    TB_Time_t now = TB_now();
+
+    return (now >= deadline) ? 0 : TB_interval_us(deadline - now);
+}
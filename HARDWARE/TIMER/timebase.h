@@ -0,0 +1,35 @@
+#ifndef _TIMEBASE_H
+#define _TIMEBASE_H
+#include "sys.h"
+#include "stdint.h"
+
+/* Time in CPU cycles since TB_init(), it does not wrap around in practice */
+typedef uint64_t TB_Time_t;
+
+void TB_init(void);
+
+void TB_update(void);
+
+TB_Time_t TB_now(void);
+
+uint32_t TB_cyc_per_us(void);
+
+uint64_t TB_to_ns(TB_Time_t t);
+
+uint64_t TB_to_us(TB_Time_t t);
+
+TB_Time_t TB_from_us(uint32_t us);
+
+uint64_t TB_ns(void);
+
+uint64_t TB_us(void);
+
+uint32_t TB_elapsed_us(TB_Time_t since);
+
+TB_Time_t TB_deadline_us(uint32_t us);
+
+int TB_expired(TB_Time_t deadline);
+
+uint32_t TB_remain_us(TB_Time_t deadline);
+
+#endif
@@ -0,0 +1,236 @@
+#include "timeout.h"
+#include "os_port.h"
+
+/* Active timeouts sorted by expiry, the head sets the compare of TIM2 */
+static TMO_t *TMO_head = 0;
+
+/**
+	* @Function:	Initialize TIM2 as the clock of the timeout service
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	TIM2 is 32-bit and runs freely at 1MHz, it wraps around after about 71
+                    minutes. Channel 1 is a one-shot compare at the earliest expiry, so the
+                    interrupt only comes when a timeout expires, not at a fixed rate.
+*/
+void TIM2_Init(void)
+{
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseInitStructure;
+    TIM_OCInitTypeDef TIM_OCInitStructure;
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+
+    TIM_TimeBaseInitStructure.TIM_Period = 0xFFFFFFFF;
+    TIM_TimeBaseInitStructure.TIM_Prescaler = 84 - 1;
+    TIM_TimeBaseInitStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseInitStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseInit(TIM2, &TIM_TimeBaseInitStructure);
+
+    TIM_OCStructInit(&TIM_OCInitStructure);
+    TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_Timing;
+    TIM_OC1Init(TIM2, &TIM_OCInitStructure);
+    TIM_OC1PreloadConfig(TIM2, TIM_OCPreload_Disable);
+
+    TMO_head = 0;
+    TIM_ClearITPendingBit(TIM2, TIM_IT_CC1);
+    TIM_ITConfig(TIM2, TIM_IT_CC1, DISABLE);
+
+    NVIC_InitStructure.NVIC_IRQChannel = TIM2_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0x02;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0x00;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    TIM_Cmd(TIM2, ENABLE);
+}
+
+/**
+	* @Function:	Get the time of the timeout service
+	* @Parameter:	none
+	* @Return:		time in us, wrapping around
+	* @Attention:	none
+*/
+unsigned int TMO_now(void)
+{
+    return TIM2->CNT;
+}
+
+/* Program the compare for the head, call it with the interrupt disabled */
+static void TMO_arm(void)
+{
+    if (TMO_head == 0)
+    {
+        TIM_ITConfig(TIM2, TIM_IT_CC1, DISABLE);
+        return;
+    }
+
+    TIM2->CCR1 = TMO_head->expire;
+    TIM_ClearITPendingBit(TIM2, TIM_IT_CC1);
+    TIM_ITConfig(TIM2, TIM_IT_CC1, ENABLE);
+
+    /* The counter may have passed the compare while it was written */
+    if ((int)(TMO_head->expire - TIM2->CNT) <= 0)
+        TIM2->EGR = TIM_EGR_CC1G;
+}
+
+/* Remove a timeout from the list, call it with the interrupt disabled */
+static void TMO_unlink(TMO_t *tmo)
+{
+    TMO_t **p = &TMO_head;
+
+    while (*p != 0 && *p != tmo)
+        p = &(*p)->next;
+    if (*p == tmo)
+        *p = tmo->next;
+    tmo->next = 0;
+}
+
+/**
+	* @Function:	Start a timeout
+	* @Parameter:	- *tmo:	timeout, owned by the caller until it expires or is stopped
+					- us:	time to expiry in us, up to TMO_MAX_US
+					- func:	function called in the interrupt of TIM2 on expiry, may be NULL
+					- *arg:	argument of func
+	* @Return:		none
+	* @Attention:	It returns at once, a timeout already active is restarted. Safe in interrupts.
+                    The callback runs at interrupt level, keep it short: set a flag, post a
+                    semaphore or start another timeout.
+*/
+void TMO_start(TMO_t *tmo, unsigned int us, TMO_Func_t func, void *arg)
+{
+    TMO_t **p;
+    uint32_t primask = __get_PRIMASK();
+
+    us = (us > TMO_MAX_US) ? TMO_MAX_US : us;
+
+    __disable_irq();
+    if (tmo->state == TMO_ACTIVE)
+        TMO_unlink(tmo);
+
+    tmo->expire = TIM2->CNT + us;
+    tmo->func = func;
+    tmo->arg = arg;
+    tmo->state = TMO_ACTIVE;
+
+    /* Timeouts with the same expiry keep the order they were started in */
+    p = &TMO_head;
+    while (*p != 0 && (int)((*p)->expire - tmo->expire) <= 0)
+        p = &(*p)->next;
+    tmo->next = *p;
+    *p = tmo;
+
+    if (TMO_head == tmo)
+        TMO_arm();
+    __set_PRIMASK(primask);
+}
+
+/**
+	* @Function:	Stop a timeout
+	* @Parameter:	- *tmo:	timeout
+	* @Return:		none
+	* @Attention:	Its callback is not called. Safe in interrupts and on idle timeouts.
+*/
+void TMO_stop(TMO_t *tmo)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    if (tmo->state == TMO_ACTIVE)
+    {
+        if (TMO_head == tmo)
+        {
+            TMO_head = tmo->next;
+            TMO_arm();
+        }
+        else
+        {
+            TMO_unlink(tmo);
+        }
+    }
+    tmo->state = TMO_IDLE;
+    __set_PRIMASK(primask);
+}
+
+/**
+	* @Function:	Check a timeout
+	* @Parameter:	- *tmo:	timeout
+	* @Return:		1 if it has expired since it was started, 0 if not
+	* @Attention:	none
+*/
+int TMO_expired(TMO_t *tmo)
+{
+    return tmo->state == TMO_EXPIRED;
+}
+
+/**
+	* @Function:	Sleep until a counter is not zero or a timeout expires
+	* @Parameter:	- *cnt:	counter raised by an interrupt, taken by one when it is not zero
+					- us:	timeout in us, 0 to wait without timeout
+	* @Return:		0 if the counter was taken, -1 on timeout
+	* @Attention:	For the background loop of the bare metal build. The core sleeps in WFI
+                    between interrupts. The check and the WFI are done with the interrupt
+                    disabled, so an interrupt which comes in between still wakes the core.
+*/
+int TMO_wait(volatile unsigned int *cnt, unsigned int us)
+{
+    TMO_t tmo;
+    int ret;
+
+    tmo.state = TMO_IDLE;
+    if (us != 0)
+        TMO_start(&tmo, us, 0, 0);
+
+    while (1)
+    {
+        __disable_irq();
+        if (*cnt > 0)
+        {
+            (*cnt)--;
+            ret = 0;
+            break;
+        }
+        if (tmo.state == TMO_EXPIRED)
+        {
+            ret = -1;
+            break;
+        }
+        __WFI();
+        __enable_irq();
+    }
+    __enable_irq();
+
+    TMO_stop(&tmo);
+    return ret;
+}
+
+void TIM2_IRQHandler(void)
+{
+    TMO_t *tmo;
+
+    os_isr_enter();
+    if (TIM_GetITStatus(TIM2, TIM_IT_CC1) == SET)
+    {
+        TIM_ClearITPendingBit(TIM2, TIM_IT_CC1);
+
+        while (1)
+        {
+            __disable_irq();
+            tmo = TMO_head;
+            if (tmo == 0 || (int)(tmo->expire - TIM2->CNT) > 0)
+            {
+                TMO_arm();
+                __enable_irq();
+                break;
+            }
+            TMO_head = tmo->next;
+            tmo->next = 0;
+            tmo->state = TMO_EXPIRED;
+            __enable_irq();
+
+            /* Callbacks run with the interrupt enabled, they may start timeouts */
+            if (tmo->func != 0)
+                tmo->func(tmo->arg);
+        }
+    }
+    os_isr_exit();
+}
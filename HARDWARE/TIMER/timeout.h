@@ -0,0 +1,41 @@
+#ifndef _TIMEOUT_H
+#define _TIMEOUT_H
+#include "sys.h"
+
+/* Longest timeout in us, half the range of TIM2 so that times compare across the wrap */
+#define TMO_MAX_US 0x7FFFFFFF
+
+typedef void (*TMO_Func_t)(void *arg);
+
+typedef enum TMO_State_t
+{
+    TMO_IDLE = 0x00,
+    TMO_ACTIVE = 0x01,
+    TMO_EXPIRED = 0x02,
+} TMO_State_t;
+
+/* Timeout owned by the caller, linked in the list of the service while active */
+typedef struct TMO_t
+{
+    struct TMO_t *next;
+    /* Expiry in us of TIM2 */
+    unsigned int expire;
+    /* Called in the interrupt of TIM2 on expiry, may be NULL */
+    TMO_Func_t func;
+    void *arg;
+    volatile TMO_State_t state;
+} TMO_t;
+
+void TIM2_Init(void);
+
+unsigned int TMO_now(void);
+
+void TMO_start(TMO_t *tmo, unsigned int us, TMO_Func_t func, void *arg);
+
+void TMO_stop(TMO_t *tmo);
+
+int TMO_expired(TMO_t *tmo);
+
+int TMO_wait(volatile unsigned int *cnt, unsigned int us);
+
+#endif
@@ -1,41 +1,302 @@
 #include "timer.h"
+#include "timebase.h"
+#include "wdg.h"
+#include "os_port.h"
 
-void TIM3_Init(void)
+/* Period of the tick in us */
+static unsigned int TICK_period = 1000;
+static TICK_Policy_t TICK_policy = TICK_SKIP;
+/* Ticks since the last cycle started, written by the interrupt */
+static volatile unsigned int TICK_pending = 0;
+/* Ticks since TIM3_Init(), written by the interrupt */
+static volatile unsigned int TICK_count = 0;
+/* Ticks still to be run by the catch-up policy */
+static unsigned int TICK_backlog = 0;
+static unsigned int TICK_clean = 0;
+static TICK_Stat_t TICK_stat;
+#if OS_PREEMPTIVE
+/* Posted by the interrupt, the control task sleeps on it between ticks */
+static os_sem_t TICK_sem;
+#endif
+
+/**
+	* @Function:	Initialize TIM3 as the control tick
+	* @Parameter:	- rate:	rate of the tick in Hz, TICK_RATE_MIN to TICK_RATE_MAX
+	* @Return:		none
+	* @Attention:	TIM3 runs at 84MHz on APB1, the prescaler makes it count in us, so the
+                    period of the tick is exact for the rates dividing 1MHz.
+                    The tick interrupt only counts, the cycle is run by TICK_wait() in the
+                    background loop, or in the control task when built with a kernel.
+*/
+void TIM3_Init(unsigned int rate)
 {
     TIM_TimeBaseInitTypeDef TIM_TimeBaseInitStructure;
     NVIC_InitTypeDef NVIC_InitStructure;
 
+    rate = (rate < TICK_RATE_MIN) ? TICK_RATE_MIN : rate;
+    rate = (rate > TICK_RATE_MAX) ? TICK_RATE_MAX : rate;
+    TICK_period = 1000000 / rate;
+
     RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
 
-    TIM_TimeBaseInitStructure.TIM_Period = 1000;
-    TIM_TimeBaseInitStructure.TIM_Prescaler = 84;
+    TIM_TimeBaseInitStructure.TIM_Period = TICK_period - 1;
+    TIM_TimeBaseInitStructure.TIM_Prescaler = 84 - 1;
     TIM_TimeBaseInitStructure.TIM_CounterMode = TIM_CounterMode_Up;
     TIM_TimeBaseInitStructure.TIM_ClockDivision = TIM_CKD_DIV1;
 
     TIM_TimeBaseInit(TIM3, &TIM_TimeBaseInitStructure);
 
+    TICK_pending = 0;
+    TICK_count = 0;
+    TICK_backlog = 0;
+    TICK_clr_stat();
+#if OS_PREEMPTIVE
+    os_sem_init(&TICK_sem, 0);
+#endif
+
+    TIM_ClearITPendingBit(TIM3, TIM_IT_Update);
     TIM_ITConfig(TIM3, TIM_IT_Update, ENABLE);
-    TIM_Cmd(TIM3, ENABLE);
 
     NVIC_InitStructure.NVIC_IRQChannel = TIM3_IRQn;
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0x01;
     NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0x03;
     NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
+
+    TIM_Cmd(TIM3, ENABLE);
+}
+
+/**
+	* @Function:	Set the policy for missed ticks
+	* @Parameter:	- policy:	policy for missed ticks
+	* @Return:		none
+	* @Attention:	none
+*/
+void TICK_set_policy(TICK_Policy_t policy)
+{
+    TICK_policy = policy;
+    TICK_backlog = 0;
+    TICK_clean = 0;
+    TICK_stat.div = 1;
+}
+
+/**
+	* @Function:	Wait for the start of the next control cycle
+	* @Parameter:	none
+	* @Return:		number of tick periods since the start of the last cycle, which the
+                    controllers may use to scale their sample time
+	* @Attention:	Call it once per cycle in the background loop, right before the control task.
+                    It sleeps until the tick, in WFI or blocking the calling task with a kernel.
+                    A cycle is an overrun if it did not finish before its deadline, which is div
+                    ticks after its start under the degrade policy and the next tick otherwise. Then:
+                    skip drops the ticks which have passed and starts at the next tick, catch-up
+                    starts at once and runs the missed cycles back to back, degrade starts at once
+                    and runs the following cycles at a lower rate.
+*/
+int TICK_wait(void)
+{
+    unsigned int n, cnt, pending, slack, skipped = 0;
+
+    if (TICK_backlog > 0)
+    {
+        /* Catching up, no wait */
+        TICK_backlog--;
+        TICK_stat.cycles++;
+        return 1;
+    }
+
+    cnt = TIM3->CNT;
+    pending = TICK_pending;
+    if (pending < (unsigned int)TICK_stat.div)
+    {
+        slack = (TICK_stat.div - pending) * TICK_period - cnt;
+        if (slack < TICK_stat.slack_min)
+            TICK_stat.slack_min = slack;
+        if (TICK_policy == TICK_DEGRADE && TICK_stat.div > 1 && ++TICK_clean >= TICK_RECOVER_CYCLES)
+        {
+            TICK_stat.div >>= 1;
+            TICK_clean = 0;
+        }
+    }
+    else
+    {
+        TICK_stat.overruns++;
+        TICK_stat.slack_min = 0;
+        TICK_clean = 0;
+
+        switch (TICK_policy)
+        {
+        case TICK_SKIP:
+            __disable_irq();
+            skipped = TICK_pending;
+            TICK_pending = 0;
+            __enable_irq();
+            TICK_stat.missed += skipped;
+            break;
+        case TICK_DEGRADE:
+            if (TICK_stat.div < TICK_DIV_MAX)
+                TICK_stat.div <<= 1;
+            break;
+        default:
+            break;
+        }
+    }
+
+#if OS_PREEMPTIVE
+    /* The count of the semaphore may run ahead of the ticks, TICK_pending decides */
+    while (TICK_pending < (unsigned int)TICK_stat.div)
+        os_sem_pend(&TICK_sem, OS_WAIT_FOREVER);
+#else
+    /* Sleep until the tick, the check is repeated with the interrupt disabled so the tick
+       can not come between the check and the WFI */
+    while (TICK_pending < (unsigned int)TICK_stat.div)
+    {
+        __disable_irq();
+        if (TICK_pending < (unsigned int)TICK_stat.div)
+            __WFI();
+        __enable_irq();
+    }
+#endif
+
+    __disable_irq();
+    n = TICK_pending;
+    TICK_pending = 0;
+    __enable_irq();
+
+    cnt = TIM3->CNT;
+    TICK_stat.lat_min = (cnt < TICK_stat.lat_min) ? cnt : TICK_stat.lat_min;
+    TICK_stat.lat_max = (cnt > TICK_stat.lat_max) ? cnt : TICK_stat.lat_max;
+    TICK_stat.lat_sum += cnt;
+    TICK_stat.cycles++;
+
+    if (TICK_policy == TICK_CATCHUP)
+    {
+        if (n > 1)
+        {
+            TICK_backlog = n - 1;
+            if (TICK_backlog > TICK_CATCHUP_MAX - 1)
+            {
+                TICK_stat.missed += TICK_backlog - (TICK_CATCHUP_MAX - 1);
+                TICK_backlog = TICK_CATCHUP_MAX - 1;
+            }
+        }
+        return 1;
+    }
+
+    if (n > (unsigned int)TICK_stat.div)
+        TICK_stat.missed += n - TICK_stat.div;
+
+    return (int)(n + skipped);
+}
+
+/**
+	* @Function:	Check if the running cycle has overrun
+	* @Parameter:	none
+	* @Return:		1 if the deadline of the cycle has passed, 0 if not
+	* @Attention:	The deadline is div ticks after the start of the cycle, see TICK_wait().
+*/
+int TICK_overrun(void)
+{
+    return TICK_pending >= (unsigned int)TICK_stat.div;
+}
+
+/**
+	* @Function:	Get the period of the tick
+	* @Parameter:	none
+	* @Return:		period of the tick in us
+	* @Attention:	none
+*/
+unsigned int TICK_get_period(void)
+{
+    return TICK_period;
+}
+
+/**
+	* @Function:	Get the time since TIM3_Init()
+	* @Parameter:	none
+	* @Return:		time in us, wrapping around after about 71 minutes
+	* @Attention:	It is read again if the tick interrupt came in between. Called with the
+                    interrupt disabled, it lags by one period after a tick until the interrupt runs.
+*/
+unsigned int TICK_get_us(void)
+{
+    unsigned int cnt, t;
+
+    do
+    {
+        t = TICK_count;
+        cnt = TIM3->CNT;
+    } while (t != TICK_count);
+
+    return t * TICK_period + cnt;
+}
+
+/**
+	* @Function:	Get the time of the next tick
+	* @Parameter:	none
+	* @Return:		time in us, in the same base as TICK_get_us()
+	* @Attention:	It is the deadline of the running cycle, div ticks after its start. Once the
+                    deadline has passed it is the next tick.
+*/
+unsigned int TICK_get_next(void)
+{
+    unsigned int t, n;
+
+    do
+    {
+        t = TICK_count;
+        n = TICK_pending;
+    } while (t != TICK_count);
+
+    n = (n < (unsigned int)TICK_stat.div) ? TICK_stat.div - n : 1;
+
+    return (t + n) * TICK_period;
 }
 
-unsigned int Time_s, Time_ms;
+/**
+	* @Function:	Get the statistics of the control cycles
+	* @Parameter:	- *stat:	statistics copied out
+	* @Return:		none
+	* @Attention:	The mean delay is lat_sum / cycles.
+*/
+void TICK_get_stat(TICK_Stat_t *stat)
+{
+    *stat = TICK_stat;
+}
+
+/**
+	* @Function:	Clear the statistics of the control cycles
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	The divider of the degrade policy is kept.
+*/
+void TICK_clr_stat(void)
+{
+    int div = (TICK_stat.div < 1) ? 1 : TICK_stat.div;
+
+    TICK_stat.cycles = 0;
+    TICK_stat.overruns = 0;
+    TICK_stat.missed = 0;
+    TICK_stat.lat_min = 0xFFFFFFFF;
+    TICK_stat.lat_max = 0;
+    TICK_stat.lat_sum = 0;
+    TICK_stat.slack_min = 0xFFFFFFFF;
+    TICK_stat.div = div;
+}
 
 void TIM3_IRQHandler(void)
 {
+    os_isr_enter();
     if (TIM_GetITStatus(TIM3, TIM_IT_Update) == SET)
     {
         TIM_ClearITPendingBit(TIM3, TIM_IT_Update);
-        Time_ms++;
-        if (Time_ms == 1000)
-        {
-            Time_ms = 0;
-            Time_s++;
-        }
+        TICK_pending++;
+        TICK_count++;
+        TB_update();
+        WDG_tick();
+#if OS_PREEMPTIVE
+        os_sem_post(&TICK_sem);
+#endif
     }
+    os_isr_exit();
 }
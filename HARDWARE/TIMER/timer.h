@@ -2,8 +2,63 @@
 #define _TIMER_H
 #include "sys.h"
 
-extern unsigned int Time_s, Time_ms;
+/* Range of the control tick rate in Hz */
+#define TICK_RATE_MIN 1000
+#define TICK_RATE_MAX 4000
 
-void TIM3_Init(void);
+/* Maxinum divider of the degrade policy */
+#define TICK_DIV_MAX 8
+/* Cycles without overrun before the degrade policy halves the divider */
+#define TICK_RECOVER_CYCLES 1000
+/* Maxinum number of cycles run back to back by the catch-up policy */
+#define TICK_CATCHUP_MAX 4
+
+typedef enum TICK_Policy_t
+{
+    /* Missed ticks are dropped, the next cycle starts at the next tick */
+    TICK_SKIP = 0x00,
+    /* Missed ticks are run back to back, up to TICK_CATCHUP_MAX */
+    TICK_CATCHUP = 0x01,
+    /* The cycle runs every div ticks, div is doubled on overrun and halved on recovery */
+    TICK_DEGRADE = 0x02,
+} TICK_Policy_t;
+
+typedef struct TICK_Stat_t
+{
+    unsigned int cycles;
+    /* Cycles which did not finish before their deadline */
+    unsigned int overruns;
+    /* Ticks without a cycle started */
+    unsigned int missed;
+
+    /* Delay from the tick to the start of cycle in us */
+    unsigned int lat_min;
+    unsigned int lat_max;
+    unsigned int lat_sum;
+
+    /* Time left before the deadline when the cycle finished in us */
+    unsigned int slack_min;
+
+    /* Divider of the degrade policy */
+    int div;
+} TICK_Stat_t;
+
+void TIM3_Init(unsigned int rate);
+
+void TICK_set_policy(TICK_Policy_t policy);
+
+int TICK_wait(void);
+
+int TICK_overrun(void);
+
+unsigned int TICK_get_period(void);
+
+unsigned int TICK_get_us(void);
+
+unsigned int TICK_get_next(void);
+
+void TICK_get_stat(TICK_Stat_t *stat);
+
+void TICK_clr_stat(void);
 
 #endif
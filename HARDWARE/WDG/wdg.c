@@ -0,0 +1,195 @@
+#include "wdg.h"
+#include "timer.h"
+#include "stdio.h"
+
+/* Marks a valid record in the backup registers */
+#define WDG_BKP_MAGIC 0x57440000
+
+static WDG_Safe_t WDG_safe = 0;
+static volatile unsigned int WDG_miss = 0;
+static unsigned int WDG_pre_ticks = 0;
+static unsigned int WDG_good = 0;
+static volatile WDG_Trip_t WDG_trip = WDG_TRIP_NONE;
+static unsigned char WDG_on = 0;
+
+static unsigned int WDG_reset = 0;
+static WDG_Record_t WDG_record;
+
+/**
+	* @Function:	Record the cause of the last reset and start the watchdogs
+	* @Parameter:	- safe:	function putting the actuators in the safe state, called in interrupts
+	* @Return:		none
+	* @Attention:	Call it after the initialization, right before the control cycles start,
+                    because the initialization waits longer than the watchdogs allow.
+                    The watchdogs are frozen while a debugger halts the core.
+*/
+void WDG_Init(WDG_Safe_t safe)
+{
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    WDG_reset = 0;
+    WDG_reset |= (RCC_GetFlagStatus(RCC_FLAG_PORRST) == SET) ? WDG_RST_POWER : 0;
+    WDG_reset |= (RCC_GetFlagStatus(RCC_FLAG_PINRST) == SET) ? WDG_RST_PIN : 0;
+    WDG_reset |= (RCC_GetFlagStatus(RCC_FLAG_BORRST) == SET) ? WDG_RST_BROWNOUT : 0;
+    WDG_reset |= (RCC_GetFlagStatus(RCC_FLAG_SFTRST) == SET) ? WDG_RST_SOFT : 0;
+    WDG_reset |= (RCC_GetFlagStatus(RCC_FLAG_IWDGRST) == SET) ? WDG_RST_IWDG : 0;
+    WDG_reset |= (RCC_GetFlagStatus(RCC_FLAG_WWDGRST) == SET) ? WDG_RST_WWDG : 0;
+    WDG_reset |= (RCC_GetFlagStatus(RCC_FLAG_LPWRRST) == SET) ? WDG_RST_LOWPOWER : 0;
+    RCC_ClearFlag();
+
+    /* The backup registers keep the record over a reset other than power on */
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_PWR, ENABLE);
+    PWR_BackupAccessCmd(ENABLE);
+    WDG_record.trip = WDG_TRIP_NONE;
+    WDG_record.miss = 0;
+    WDG_record.good = 0;
+    if ((RTC->BKP0R & 0xFFFF0000) == WDG_BKP_MAGIC)
+    {
+        WDG_record.trip = (WDG_Trip_t)(RTC->BKP0R & 0xFF);
+        WDG_record.miss = RTC->BKP1R;
+        WDG_record.good = RTC->BKP2R;
+    }
+    RTC->BKP0R = 0;
+
+    WDG_safe = safe;
+    WDG_miss = 0;
+    WDG_good = 0;
+    WDG_trip = WDG_TRIP_NONE;
+    WDG_pre_ticks = WDG_PRETIMEOUT_US / TICK_get_period();
+
+    DBGMCU->APB1FZ |= DBGMCU_WWDG_STOP | DBGMCU_IWDG_STOP;
+
+    IWDG_WriteAccessCmd(IWDG_WriteAccess_Enable);
+    IWDG_SetPrescaler(IWDG_Prescaler_32);
+    IWDG_SetReload(WDG_IWDG_RELOAD);
+    IWDG_ReloadCounter();
+    IWDG_Enable();
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_WWDG, ENABLE);
+    WWDG_SetPrescaler(WWDG_Prescaler_8);
+    WWDG_SetWindowValue(WDG_WINDOW);
+    WWDG_Enable(WDG_COUNTER);
+    WWDG_ClearFlag();
+
+    NVIC_InitStructure.NVIC_IRQChannel = WWDG_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0x00;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0x00;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+    WWDG_EnableIT();
+
+    WDG_on = 1;
+}
+
+/* Latch the safe state and write the record, the watchdogs are not refreshed anymore */
+static void WDG_enter_safe(WDG_Trip_t trip)
+{
+    if (WDG_trip == WDG_TRIP_NONE)
+    {
+        WDG_trip = trip;
+        RTC->BKP1R = WDG_miss;
+        RTC->BKP2R = WDG_good;
+        RTC->BKP0R = WDG_BKP_MAGIC | trip;
+    }
+    if (WDG_safe != 0)
+        WDG_safe();
+}
+
+/**
+	* @Function:	Report the end of a control cycle
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	Call it at the end of the control task. A cycle counts as good only if it
+                    finished before its own deadline, which is div ticks after its start under
+                    the degrade policy, see TICK_overrun(). The watchdogs are refreshed only by good
+                    cycles, and only once WWDG is in its window, so a good cycle costs a read
+                    and two compares.
+*/
+void WDG_cycle_done(void)
+{
+    if (!WDG_on || WDG_trip != WDG_TRIP_NONE || TICK_overrun())
+        return;
+
+    WDG_miss = 0;
+    WDG_good++;
+
+    if ((WWDG->CR & 0x7F) < WDG_WINDOW)
+    {
+        WWDG_SetCounter(WDG_COUNTER);
+        IWDG_ReloadCounter();
+    }
+}
+
+/**
+	* @Function:	Count the ticks without a good cycle
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	Called by the tick interrupt of TIM3. After WDG_PRETIMEOUT_US it puts the
+                    actuators in the safe state, long before the reset of WWDG.
+*/
+void WDG_tick(void)
+{
+    if (WDG_on && ++WDG_miss > WDG_pre_ticks && WDG_trip == WDG_TRIP_NONE)
+        WDG_enter_safe(WDG_TRIP_DEADLINE);
+}
+
+/**
+	* @Function:	Check the safe state
+	* @Parameter:	none
+	* @Return:		1 after the watchdog tripped, the control task must not command the
+                    actuators anymore, 0 if not
+	* @Attention:	none
+*/
+int WDG_tripped(void)
+{
+    return WDG_trip != WDG_TRIP_NONE;
+}
+
+/**
+	* @Function:	Get the causes of the last reset
+	* @Parameter:	none
+	* @Return:		bit mask of WDG_RST_x
+	* @Attention:	none
+*/
+unsigned int WDG_get_reset(void)
+{
+    return WDG_reset;
+}
+
+/**
+	* @Function:	Get the record of the last watchdog trip
+	* @Parameter:	none
+	* @Return:		pointer of the record, trip is WDG_TRIP_NONE if there was none
+	* @Attention:	none
+*/
+const WDG_Record_t *WDG_get_record(void)
+{
+    return &WDG_record;
+}
+
+/**
+	* @Function:	Print the cause of the last reset and the record of the last trip
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	none
+*/
+void WDG_print(void)
+{
+    printf("Reset:%s%s%s%s%s%s%s\r\n",
+           (WDG_reset & WDG_RST_POWER) ? " power" : "",
+           (WDG_reset & WDG_RST_PIN) ? " pin" : "",
+           (WDG_reset & WDG_RST_BROWNOUT) ? " brownout" : "",
+           (WDG_reset & WDG_RST_SOFT) ? " soft" : "",
+           (WDG_reset & WDG_RST_IWDG) ? " iwdg" : "",
+           (WDG_reset & WDG_RST_WWDG) ? " wwdg" : "",
+           (WDG_reset & WDG_RST_LOWPOWER) ? " lowpower" : "");
+    if (WDG_record.trip != WDG_TRIP_NONE)
+        printf("Last trip:%s miss:%u good:%u\r\n", (WDG_record.trip == WDG_TRIP_EWI) ? " ewi" : " deadline",
+               WDG_record.miss, WDG_record.good);
+}
+
+void WWDG_IRQHandler(void)
+{
+    WWDG_ClearFlag();
+    WDG_enter_safe(WDG_TRIP_EWI);
+}
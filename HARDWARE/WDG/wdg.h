@@ -0,0 +1,61 @@
+#ifndef _WDG_H
+#define _WDG_H
+#include "sys.h"
+
+/* Time without a cycle finished before its deadline before the safe state, in us */
+#define WDG_PRETIMEOUT_US 20000
+
+/* WWDG counts 4096 * 8 cycles of PCLK1, 0.78ms at 42MHz. It is refreshed to WDG_COUNTER
+   once it has counted down below WDG_WINDOW, and resets the MCU below 0x40. So a hang is
+   reset after 38ms to 50ms, with the early wakeup interrupt one count before. */
+#define WDG_COUNTER 0x7F
+#define WDG_WINDOW 0x70
+
+/* IWDG counts the 32kHz LSI by 32, it resets the MCU after 100ms without a refresh */
+#define WDG_IWDG_RELOAD 100
+
+/* Causes of the last reset, bit mask */
+#define WDG_RST_POWER 0x01
+#define WDG_RST_PIN 0x02
+#define WDG_RST_BROWNOUT 0x04
+#define WDG_RST_SOFT 0x08
+#define WDG_RST_IWDG 0x10
+#define WDG_RST_WWDG 0x20
+#define WDG_RST_LOWPOWER 0x40
+
+typedef enum WDG_Trip_t
+{
+    WDG_TRIP_NONE = 0x00,
+    /* No cycle finished before its deadline for WDG_PRETIMEOUT_US */
+    WDG_TRIP_DEADLINE = 0x01,
+    /* Early wakeup of WWDG, the tick interrupt did not catch the hang */
+    WDG_TRIP_EWI = 0x02,
+} WDG_Trip_t;
+
+/* What the last run recorded before the watchdog reset, kept in the RTC backup registers */
+typedef struct WDG_Record_t
+{
+    WDG_Trip_t trip;
+    /* Ticks without a good cycle when it tripped */
+    unsigned int miss;
+    /* Cycles finished before their deadline before it tripped */
+    unsigned int good;
+} WDG_Record_t;
+
+typedef void (*WDG_Safe_t)(void);
+
+void WDG_Init(WDG_Safe_t safe);
+
+void WDG_cycle_done(void);
+
+void WDG_tick(void);
+
+int WDG_tripped(void);
+
+unsigned int WDG_get_reset(void);
+
+const WDG_Record_t *WDG_get_record(void);
+
+void WDG_print(void);
+
+#endif
@@ -0,0 +1,111 @@
+#include "log.h"
+//////////////////////////////////////////////////////////////////////////////////
+//Log ring, see log.h
+//Any number of writers reserve their entry with LDREX/STREX on the head, fill it and
+//write the head word of the entry last. The single reader, log_drain(), stops at the
+//first entry whose head word is not written yet and clears the entries it takes, so a
+//reserved entry reads as not written until its writer is done.
+//An interrupt between LDREX and STREX makes the STREX fail, and the writer retries.
+//////////////////////////////////////////////////////////////////////////////////
+
+#if LOG_ENABLE
+
+#include "timebase.h"
+
+#define LOG_MASK (LOG_BUF_WORDS - 1)
+//Words of an entry without the arguments: head, format and time
+#define LOG_ENTRY_WORDS 3
+
+static volatile u32 log_buf[LOG_BUF_WORDS];
+//Free running word indexes, reserved up to log_head, read up to log_tail
+static volatile u32 log_head = 0;
+static volatile u32 log_tail = 0;
+static volatile u32 log_drop = 0;
+//Head of the frame and the entries, one word more for the CRC
+static u32 log_frame[3 + LOG_FRAME_WORDS + 1];
+
+//Put an entry in the ring, return 0 if it was dropped because the ring is full
+int log_write(u32 id, u32 n, const u32 *arg)
+{
+    u32 len = LOG_ENTRY_WORDS + n;
+    u32 head, i;
+
+    do
+    {
+        head = __LDREXW(&log_head);
+        if (head + len - log_tail > LOG_BUF_WORDS)
+        {
+            __CLREX();
+            do
+            {
+                i = __LDREXW(&log_drop);
+            } while (__STREXW(i + 1, &log_drop));
+            return 0;
+        }
+    } while (__STREXW(head + len, &log_head));
+
+    log_buf[(head + 1) & LOG_MASK] = id;
+    log_buf[(head + 2) & LOG_MASK] = DWT->CYCCNT;
+    for (i = 0; i < n; i++)
+        log_buf[(head + LOG_ENTRY_WORDS + i) & LOG_MASK] = arg[i];
+    __DMB();
+    log_buf[head & LOG_MASK] = LOG_MAGIC | n;
+
+    return 1;
+}
+
+//Send the written entries in up to LOG_DRAIN_FRAMES frames, return the number of entries sent
+//A frame is the type, version and entry number, the cycles per us, the total of the dropped
+//entries, then the entries as they are in the ring. Call it from one task only.
+int log_drain(LOG_Send_t send)
+{
+    int cnt = 0;
+    int f;
+    u32 tail, hdr, len, w, i, n;
+
+    for (f = 0; f < LOG_DRAIN_FRAMES; f++)
+    {
+        tail = log_tail;
+        w = 0;
+        n = 0;
+        while (1)
+        {
+            hdr = log_buf[tail & LOG_MASK];
+            if ((hdr & 0xFFFFFFF0) != LOG_MAGIC)
+                break;
+            len = LOG_ENTRY_WORDS + (hdr & 0x0F);
+            if (w + len > LOG_FRAME_WORDS)
+                break;
+            __DMB();
+            for (i = 0; i < len; i++)
+            {
+                log_frame[3 + w + i] = log_buf[(tail + i) & LOG_MASK];
+                log_buf[(tail + i) & LOG_MASK] = 0;
+            }
+            tail += len;
+            w += len;
+            n++;
+        }
+        if (w == 0)
+            break;
+
+        __DMB();
+        log_tail = tail;
+        cnt += n;
+
+        log_frame[0] = LOG_FRAME_TYPE | (LOG_VERSION << 8) | (n << 16);
+        log_frame[1] = TB_cyc_per_us();
+        log_frame[2] = log_drop;
+        send(log_frame, (3 + w) * 4);
+    }
+
+    return cnt;
+}
+
+//Entries dropped since reset because the ring was full
+u32 log_drops(void)
+{
+    return log_drop;
+}
+
+#endif
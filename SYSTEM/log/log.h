@@ -0,0 +1,79 @@
+#ifndef __LOG_H
+#define __LOG_H
+//////////////////////////////////////////////////////////////////////////////////
+//Log with the formatting deferred to the host
+//LOG0("text") to LOG4("fmt", a, b, c, d) put the address of the format string, the
+//cycle counter and the raw 32 bit arguments in a ring, without formatting.
+//Floats are passed as LOG_F(x), strings are not supported.
+//The format strings, prefixed with file and line, go to the section .logstr and are
+//only read by TOOLS/logdecode.py from the ELF file, the firmware never reads them.
+//USER/LCD.sct keeps the section in a load region of its own, apart from the code.
+//log_drain() sends the ring as frames of the telemetry, from a background task.
+//A call costs a few tens of cycles and may come from any task or interrupt.
+//With LOG_ENABLE 0 the macros compile to nothing.
+//////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LOG_ENABLE
+#define LOG_ENABLE 1
+#endif
+
+//Size of the ring in words, a power of 2, an entry takes 3 words and 1 per argument
+#define LOG_BUF_WORDS 1024
+//Words of entries in a frame, so a frame fits TELEM_FRAME_MAX
+#define LOG_FRAME_WORDS 48
+//Frames sent by a call of log_drain(), which keeps the log within the link budget
+#define LOG_DRAIN_FRAMES 1
+//Type of the frames, TELEM_TYPE_LOG of the telemetry
+#define LOG_FRAME_TYPE 0x03
+#define LOG_VERSION 1
+//Head of an entry, the low 4 bits are the number of arguments
+#define LOG_MAGIC 0x4C4F0000
+
+#include "sys.h"
+
+//Send function of the frames, TELEM_send()
+typedef int (*LOG_Send_t)(uint32_t *frame, int len);
+
+#if LOG_ENABLE
+
+#define LOG_SECTION __attribute__((section(".logstr")))
+#define LOG_STR_(x) #x
+#define LOG_STR(x) LOG_STR_(x)
+#define LOG_FMT(fmt) static const char log_fmt_[] LOG_SECTION = __FILE__ ":" LOG_STR(__LINE__) ": " fmt
+
+__STATIC_INLINE u32 LOG_F(float f)
+{
+    union { float f; u32 u; } v;
+
+    v.f = f;
+    return v.u;
+}
+
+#define LOG0(fmt) do { LOG_FMT(fmt); log_write((u32)log_fmt_, 0, 0); } while (0)
+#define LOG1(fmt, a) do { LOG_FMT(fmt); u32 log_a_[1]; log_a_[0] = (u32)(a); log_write((u32)log_fmt_, 1, log_a_); } while (0)
+#define LOG2(fmt, a, b) do { LOG_FMT(fmt); u32 log_a_[2]; log_a_[0] = (u32)(a); log_a_[1] = (u32)(b); \
+    log_write((u32)log_fmt_, 2, log_a_); } while (0)
+#define LOG3(fmt, a, b, c) do { LOG_FMT(fmt); u32 log_a_[3]; log_a_[0] = (u32)(a); log_a_[1] = (u32)(b); \
+    log_a_[2] = (u32)(c); log_write((u32)log_fmt_, 3, log_a_); } while (0)
+#define LOG4(fmt, a, b, c, d) do { LOG_FMT(fmt); u32 log_a_[4]; log_a_[0] = (u32)(a); log_a_[1] = (u32)(b); \
+    log_a_[2] = (u32)(c); log_a_[3] = (u32)(d); log_write((u32)log_fmt_, 4, log_a_); } while (0)
+
+int log_write(u32 id, u32 n, const u32 *arg);
+int log_drain(LOG_Send_t send);
+u32 log_drops(void);
+
+#else
+
+#define LOG_F(f) 0
+#define LOG0(fmt)
+#define LOG1(fmt, a)
+#define LOG2(fmt, a, b)
+#define LOG3(fmt, a, b, c)
+#define LOG4(fmt, a, b, c, d)
+
+#define log_drain(send) ((void)0)
+#define log_drops() 0
+
+#endif
+
+#endif
@@ -0,0 +1,239 @@
+#include "os_port.h"
+//////////////////////////////////////////////////////////////////////////////////
+//Kernel abstraction, see os_port.h
+//os_sem_post() may be called from interrupts, the other functions only from
+//tasks (or the background loop on bare metal).
+//////////////////////////////////////////////////////////////////////////////////
+
+#ifdef OS_POSIX
+
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+void os_init(void)
+{
+}
+
+//The tasks run as soon as they are created, so os_start() only parks the caller
+void os_start(void)
+{
+    while (1)
+        pause();
+}
+
+//Entry of a task as pthreads calls it, the task returns nothing
+typedef struct os_entry_t
+{
+    os_task_t task;
+    void *arg;
+} os_entry_t;
+
+static os_entry_t os_entry[OS_TASK_MAX];
+static unsigned int os_entry_num = 0;
+
+static void *os_trampoline(void *p)
+{
+    os_entry_t *entry = (os_entry_t *)p;
+
+    entry->task(entry->arg);
+    return 0;
+}
+
+//Real-time priorities need CAP_SYS_NICE, without it the task runs with the default policy.
+//Tasks are created before os_start() by one caller, so the slots are not locked.
+int os_task_create(os_task_t task, void *arg, unsigned int prio, os_stk_t *stk, unsigned int stk_size)
+{
+    pthread_t tid;
+    pthread_attr_t attr;
+    struct sched_param param;
+    os_entry_t *entry;
+    int ret;
+
+    (void)stk;
+    (void)stk_size;
+
+    if (os_entry_num >= OS_TASK_MAX)
+        return -1;
+    entry = &os_entry[os_entry_num];
+    entry->task = task;
+    entry->arg = arg;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - (int)prio;
+    pthread_attr_setschedparam(&attr, &param);
+
+    ret = pthread_create(&tid, &attr, os_trampoline, entry);
+    if (ret == EPERM)
+        ret = pthread_create(&tid, 0, os_trampoline, entry);
+    pthread_attr_destroy(&attr);
+
+    if (ret != 0)
+        return -1;
+    os_entry_num++;
+    return 0;
+}
+
+void os_delay_us(unsigned int us)
+{
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+void os_sem_init(os_sem_t *sem, unsigned int cnt)
+{
+    sem_init(sem, 0, cnt);
+}
+
+void os_sem_post(os_sem_t *sem)
+{
+    sem_post(sem);
+}
+
+//Return 0 if the semaphore was taken, -1 on timeout
+int os_sem_pend(os_sem_t *sem, unsigned int timeout_us)
+{
+    struct timespec ts;
+
+    if (timeout_us == OS_WAIT_FOREVER)
+    {
+        while (sem_wait(sem) != 0)
+            ;
+        return 0;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (long)(timeout_us % 1000000) * 1000;
+    ts.tv_sec += timeout_us / 1000000 + ts.tv_nsec / 1000000000;
+    ts.tv_nsec %= 1000000000;
+
+    while (sem_timedwait(sem, &ts) != 0)
+    {
+        if (errno != EINTR)
+            return -1;
+    }
+    return 0;
+}
+
+void os_sem_clr(os_sem_t *sem)
+{
+    while (sem_trywait(sem) == 0)
+        ;
+}
+
+#elif SYSTEM_SUPPORT_OS
+
+//Timeouts are rounded up to whole OS ticks plus one, because the first tick of a
+//wait comes anywhere between 0 and 1 tick after the call. The whole seconds are
+//split off so the product does not overflow.
+static INT16U os_us_to_ticks(unsigned int us)
+{
+    unsigned int ticks = us / 1000000 * OS_TICKS_PER_SEC + ((us % 1000000) * OS_TICKS_PER_SEC + 999999) / 1000000 + 1;
+
+    return (ticks > 0xFFFF) ? 0xFFFF : (INT16U)ticks;
+}
+
+void os_init(void)
+{
+    OSInit();
+}
+
+void os_start(void)
+{
+    OSStart();
+}
+
+//The stack grows downwards on Cortex-M
+int os_task_create(os_task_t task, void *arg, unsigned int prio, os_stk_t *stk, unsigned int stk_size)
+{
+    return (OSTaskCreate(task, arg, &stk[stk_size - 1], (INT8U)prio) == OS_ERR_NONE) ? 0 : -1;
+}
+
+void os_delay_us(unsigned int us)
+{
+    OSTimeDly(os_us_to_ticks(us));
+}
+
+void os_sem_init(os_sem_t *sem, unsigned int cnt)
+{
+    sem->ev = OSSemCreate((INT16U)cnt);
+}
+
+void os_sem_post(os_sem_t *sem)
+{
+    OSSemPost(sem->ev);
+}
+
+int os_sem_pend(os_sem_t *sem, unsigned int timeout_us)
+{
+    INT8U err;
+
+    OSSemPend(sem->ev, (timeout_us == OS_WAIT_FOREVER) ? 0 : os_us_to_ticks(timeout_us), &err);
+    return (err == OS_ERR_NONE) ? 0 : -1;
+}
+
+void os_sem_clr(os_sem_t *sem)
+{
+    INT8U err;
+
+    OSSemSet(sem->ev, 0, &err);
+}
+
+#else
+
+#include "timeout.h"
+
+void os_init(void)
+{
+}
+
+//There is no kernel, the background loop is the only task
+void os_start(void)
+{
+    while (1)
+        ;
+}
+
+int os_task_create(os_task_t task, void *arg, unsigned int prio, os_stk_t *stk, unsigned int stk_size)
+{
+    return -1;
+}
+
+//Sleep in WFI until the timeout service wakes the core up
+void os_delay_us(unsigned int us)
+{
+    volatile unsigned int none = 0;
+
+    if (us > 0)
+        TMO_wait(&none, us);
+}
+
+void os_sem_init(os_sem_t *sem, unsigned int cnt)
+{
+    sem->cnt = cnt;
+}
+
+void os_sem_post(os_sem_t *sem)
+{
+    sem->cnt++;
+}
+
+//Sleep in WFI until it is posted or the timeout service wakes the core up
+int os_sem_pend(os_sem_t *sem, unsigned int timeout_us)
+{
+    return TMO_wait(&sem->cnt, timeout_us);
+}
+
+void os_sem_clr(os_sem_t *sem)
+{
+    sem->cnt = 0;
+}
+
+#endif
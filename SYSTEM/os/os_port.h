@@ -0,0 +1,91 @@
+#ifndef __OS_PORT_H
+#define __OS_PORT_H
+//////////////////////////////////////////////////////////////////////////////////
+//Thin layer between the firmware and the kernel, so the same code builds
+//- bare metal (SYSTEM_SUPPORT_OS 0): semaphores are counters and waits sleep
+//  in WFI until an interrupt, with timeouts from the service of timeout.c
+//- on uC/OS-II (SYSTEM_SUPPORT_OS 1): the kernel sources and includes.h are
+//  added to the project as for the ALIENTEK uC/OS examples
+//- on Linux (OS_POSIX defined): pthreads and POSIX semaphores. Only this layer
+//  is ported, the drivers under it need the board, so on the host the port is
+//  built and timed alone by TEST/test_os.c
+//Priorities are in the uC/OS-II sense, 0 is the highest.
+//Timeouts are rounded up to OS ticks plus one on uC/OS-II, so a CAN reply timeout
+//of a few hundred us waits 1 to 2 ms with OS_TICKS_PER_SEC 1000 in os_cfg.h.
+//////////////////////////////////////////////////////////////////////////////////
+
+#ifdef OS_POSIX
+
+#include <pthread.h>
+#include <semaphore.h>
+
+#define OS_PREEMPTIVE 1
+
+typedef sem_t os_sem_t;
+typedef unsigned int os_stk_t;
+
+//Most tasks os_task_create() can start, each needs a slot for its entry and argument
+#define OS_TASK_MAX 8
+
+#define os_isr_enter()
+#define os_isr_exit()
+
+#else
+
+#include "sys.h"
+
+#if SYSTEM_SUPPORT_OS
+
+#include "includes.h"
+
+#define OS_PREEMPTIVE 1
+
+typedef struct
+{
+    OS_EVENT *ev;
+} os_sem_t;
+typedef OS_STK os_stk_t;
+
+#define os_isr_enter() OSIntEnter()
+#define os_isr_exit() OSIntExit()
+
+#else
+
+#define OS_PREEMPTIVE 0
+
+typedef struct
+{
+    volatile unsigned int cnt;
+} os_sem_t;
+typedef unsigned int os_stk_t;
+
+#define os_isr_enter()
+#define os_isr_exit()
+
+#endif
+
+#endif
+
+//Stacks of tasks using printf() with floats must be 8-byte aligned
+#if defined(__CC_ARM)
+#define OS_STK_ALIGN __align(8)
+#else
+#define OS_STK_ALIGN __attribute__((aligned(8)))
+#endif
+
+//Wait forever in os_sem_pend()
+#define OS_WAIT_FOREVER 0
+
+typedef void (*os_task_t)(void *arg);
+
+void os_init(void);
+void os_start(void);
+int os_task_create(os_task_t task, void *arg, unsigned int prio, os_stk_t *stk, unsigned int stk_size);
+void os_delay_us(unsigned int us);
+
+void os_sem_init(os_sem_t *sem, unsigned int cnt);
+void os_sem_post(os_sem_t *sem);
+int os_sem_pend(os_sem_t *sem, unsigned int timeout_us);
+void os_sem_clr(os_sem_t *sem);
+
+#endif
@@ -0,0 +1,126 @@
+#include "prof.h"
+//////////////////////////////////////////////////////////////////////////////////
+//Profiler of named code scopes, see prof.h
+//PROF_START is a single load and store, PROF_STOP a call of about 40 cycles.
+//The cycle counter is started by TB_init().
+//////////////////////////////////////////////////////////////////////////////////
+
+#if PROF_ENABLE
+
+#include "stdio.h"
+
+static PROF_Scope_t *prof_table[PROF_SCOPE_MAX];
+static int prof_cnt = 0;
+
+//Put a scope in the table, once
+static void prof_register(PROF_Scope_t *s)
+{
+    u32 primask = __get_PRIMASK();
+
+    __disable_irq();
+    if (!s->reg && prof_cnt < PROF_SCOPE_MAX)
+    {
+        prof_table[prof_cnt++] = s;
+        s->min = 0xFFFFFFFF;
+    }
+    s->reg = 1;
+    __set_PRIMASK(primask);
+}
+
+//Account a run of a scope, t1 is the cycle counter at the end
+void prof_stop(PROF_Scope_t *s, u32 t1)
+{
+    u32 d = t1 - s->t0;
+    int bin;
+
+    if (!s->reg)
+        prof_register(s);
+
+    s->cnt++;
+    s->sum += d;
+    if (d < s->min)
+        s->min = d;
+    if (d > s->max)
+        s->max = d;
+    if (d > s->wcet)
+        s->wcet = d;
+
+    bin = 32 - __CLZ(d >> PROF_HIST_SHIFT);
+    if (bin >= PROF_HIST_BINS)
+        bin = PROF_HIST_BINS - 1;
+    s->hist[bin]++;
+}
+
+//Drive a pin of GPIOF high while the scope runs, GPIO_Pin_9 or GPIO_Pin_10 are the LEDs
+//The pin must be an output already, 0 to turn the trace off. Needs PROF_TRACE 1.
+void prof_set_trace(PROF_Scope_t *s, u16 pin)
+{
+    s->trace = pin;
+}
+
+//Number of scopes in the table
+int prof_num(void)
+{
+    return prof_cnt;
+}
+
+//Scope in the table by index, NULL if out of range
+PROF_Scope_t *prof_get(int idx)
+{
+    return (idx >= 0 && idx < prof_cnt) ? prof_table[idx] : 0;
+}
+
+//One line of a scope in us, for the LCD, buf must hold 48 chars
+void prof_format(PROF_Scope_t *s, char *buf)
+{
+    u32 cyc_us = SystemCoreClock / 1000000;
+    u32 avg = s->cnt ? (u32)(s->sum / s->cnt) : 0;
+
+    sprintf(buf, "%-8.8s %6u %5u %5u %5u", s->name, s->cnt, avg / cyc_us, s->max / cyc_us, s->wcet / cyc_us);
+}
+
+//Print a line of the table in cycles with the histogram, line 0 is the header and
+//line i + 1 the scope i. Return 0 past the last line. The table is about 2 KB with all
+//scopes, more than the serial port buffer, so it is printed a line per call.
+int prof_print_line(int line)
+{
+    PROF_Scope_t *s;
+    int k;
+
+    if (line == 0)
+    {
+        printf("scope         cnt      min      avg      max     wcet  hist(<2^%d, x2)\r\n", PROF_HIST_SHIFT);
+        return 1;
+    }
+    if (line > prof_cnt)
+        return 0;
+
+    s = prof_table[line - 1];
+    printf("%-8.8s %8u %8u %8u %8u %8u ", s->name, s->cnt, s->cnt ? s->min : 0,
+           s->cnt ? (u32)(s->sum / s->cnt) : 0, s->max, s->wcet);
+    for (k = 0; k < PROF_HIST_BINS; k++)
+        printf(" %u", s->hist[k]);
+    printf("\r\n");
+
+    return 1;
+}
+
+//Clear the statistics of all scopes, the WCET is kept
+void prof_clr(void)
+{
+    PROF_Scope_t *s;
+    int i, k;
+
+    for (i = 0; i < prof_cnt; i++)
+    {
+        s = prof_table[i];
+        s->cnt = 0;
+        s->sum = 0;
+        s->min = 0xFFFFFFFF;
+        s->max = 0;
+        for (k = 0; k < PROF_HIST_BINS; k++)
+            s->hist[k] = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef __PROF_H
+#define __PROF_H
+//////////////////////////////////////////////////////////////////////////////////
+//Profiler of named code scopes on the DWT cycle counter
+//PROF_DEFINE(prof_x, "name") at file scope, PROF_DECLARE(prof_x) in other files,
+//then PROF_START(prof_x) ... PROF_STOP(prof_x) around the code.
+//Each scope keeps count, min/avg/max since prof_clr(), the WCET since reset and
+//a log2 histogram. Nothing is allocated, a scope joins the table on its first stop.
+//With PROF_ENABLE 0 the macros compile to nothing and prof.c is empty.
+//The time of a scope includes the interrupts, and the preemption in the kernel
+//build, which happen inside it.
+//////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PROF_ENABLE
+#define PROF_ENABLE 1
+#endif
+
+//Drive a pin of GPIOF high while a scope runs, see prof_set_trace()
+#ifndef PROF_TRACE
+#define PROF_TRACE 0
+#endif
+
+#define PROF_SCOPE_MAX 16
+//Bin 0 counts the runs below 2^PROF_HIST_SHIFT cycles, bin k the runs in
+//[2^(k+PROF_HIST_SHIFT-1), 2^(k+PROF_HIST_SHIFT)), the last bin all the longer ones
+#define PROF_HIST_BINS 16
+#define PROF_HIST_SHIFT 6
+
+#if PROF_ENABLE
+
+#include "sys.h"
+
+typedef struct PROF_Scope_t
+{
+    const char *name;
+    u32 t0;
+    u32 cnt;
+    u32 min;
+    u32 max;
+    u32 wcet;
+    unsigned long long sum;
+    u32 hist[PROF_HIST_BINS];
+    u16 trace;
+    u8 reg;
+} PROF_Scope_t;
+
+#if PROF_TRACE
+#define PROF_TRACE_ON(s) do { if ((s).trace) GPIOF->BSRRL = (s).trace; } while (0)
+#define PROF_TRACE_OFF(s) do { if ((s).trace) GPIOF->BSRRH = (s).trace; } while (0)
+#else
+#define PROF_TRACE_ON(s)
+#define PROF_TRACE_OFF(s)
+#endif
+
+#define PROF_DEFINE(s, name) PROF_Scope_t s = {name}
+#define PROF_DECLARE(s) extern PROF_Scope_t s
+#define PROF_START(s) do { PROF_TRACE_ON(s); (s).t0 = DWT->CYCCNT; } while (0)
+#define PROF_STOP(s) do { prof_stop(&(s), DWT->CYCCNT); PROF_TRACE_OFF(s); } while (0)
+
+void prof_stop(PROF_Scope_t *s, u32 t1);
+void prof_set_trace(PROF_Scope_t *s, u16 pin);
+int prof_num(void);
+PROF_Scope_t *prof_get(int idx);
+void prof_format(PROF_Scope_t *s, char *buf);
+int prof_print_line(int line);
+void prof_clr(void);
+
+#else
+
+#define PROF_DEFINE(s, name) extern int prof_unused_
+#define PROF_DECLARE(s) extern int prof_unused_
+#define PROF_START(s)
+#define PROF_STOP(s)
+
+#define prof_set_trace(s, pin)
+#define prof_num() 0
+#define prof_print_line(line) 0
+#define prof_clr()
+
+#endif
+
+#endif
@@ -1,5 +1,6 @@
 #include "sys.h"
 #include "usart.h"	
+#include "os_port.h"
 ////////////////////////////////////////////////////////////////////////////////// 	 
 //ʹucos,ͷļ.
 #if SYSTEM_SUPPORT_OS
@@ -48,13 +49,125 @@ void _sys_exit(int x)
 { 
 	x = x; 
 } 
-//ضfputc 
+//TX ring drained to USART1 by DMA2 Stream7 Channel4, the writers never wait.
+//A write which does not fit is dropped, the data already queued goes out intact.
+//printf is buffered a line at a time, see fputc().
+u8 USART_TX_BUF[USART_TX_LEN];
+static volatile u16 usart_tx_head=0;		//next byte to write
+static volatile u16 usart_tx_tail=0;		//first byte not sent yet
+static volatile u16 usart_tx_busy=0;		//bytes in the running DMA transfer, 0 if idle
+u32 USART_TX_DROP=0;						//bytes dropped because the ring was full
+u32 USART_TX_DROP_CNT=0;					//writes dropped because the ring was full
+u16 USART_TX_PEAK=0;						//most bytes in the ring
+static u8 usart_line[USART_LINE_LEN];		//line of printf not written yet
+static u16 usart_line_len=0;
+#define USART_TX_DMA_FLAGS	((DMA_FLAG_TCIF7|DMA_FLAG_HTIF7|DMA_FLAG_TEIF7|DMA_FLAG_DMEIF7|DMA_FLAG_FEIF7)&0x0F7D0F7D)
+
+//Start the DMA on the queued bytes up to the end of the ring, call it with the interrupt disabled
+static void usart_tx_kick(void)
+{
+	u16 len;
+	if(usart_tx_busy||usart_tx_head==usart_tx_tail)return;
+	len=(usart_tx_head>usart_tx_tail)?usart_tx_head-usart_tx_tail:USART_TX_LEN-usart_tx_tail;
+	usart_tx_busy=len;
+	DMA2->HIFCR=USART_TX_DMA_FLAGS;
+	DMA2_Stream7->M0AR=(u32)&USART_TX_BUF[usart_tx_tail];
+	DMA2_Stream7->NDTR=len;
+	DMA2_Stream7->CR|=DMA_SxCR_EN;
+}
+
+//Queue len bytes, all or nothing, from any context
+//Return the number of bytes queued, 0 if dropped
+u16 usart_write(const u8 *buf,u16 len)
+{
+	u32 primask=__get_PRIMASK();
+	u16 used,i,head;
+	__disable_irq();
+	used=(usart_tx_head-usart_tx_tail)&(USART_TX_LEN-1);
+	if(len>USART_TX_LEN-1-used)
+	{
+		USART_TX_DROP+=len;
+		USART_TX_DROP_CNT++;
+		__set_PRIMASK(primask);
+		return 0;
+	}
+	head=usart_tx_head;
+	for(i=0;i<len;i++)
+	{
+		USART_TX_BUF[head]=buf[i];
+		head=(head+1)&(USART_TX_LEN-1);
+	}
+	usart_tx_head=head;
+	if(used+len>USART_TX_PEAK)USART_TX_PEAK=used+len;
+	usart_tx_kick();
+	__set_PRIMASK(primask);
+	return len;
+}
+
+//Bytes in the ring, including the running transfer
+u16 usart_tx_used(void)
+{
+	return (usart_tx_head-usart_tx_tail)&(USART_TX_LEN-1);
+}
+
+//Bytes which can be queued now
+u16 usart_tx_free(void)
+{
+	return USART_TX_LEN-1-usart_tx_used();
+}
+
+//Queue the buffered line of printf. With a kernel a task waits until it fits, so long
+//answers go out whole. Without one the background loop must not wait, the line is dropped
+//whole and the writer keeps below usart_tx_free() for long answers.
+static void usart_line_flush(void)
+{
+#if OS_PREEMPTIVE
+	while(usart_tx_free()<usart_line_len&&__get_PRIMASK()==0)
+		os_delay_us(1000);
+#endif
+	usart_write(usart_line,usart_line_len);
+	usart_line_len=0;
+}
+
+//Wait until the ring is sent, for the few places which must not lose output, e.g. before a reset
+void usart_flush(void)
+{
+	if(usart_line_len>0)usart_line_flush();
+	while(usart_tx_head!=usart_tx_tail);
+	while((USART1->SR&0X40)==0);
+}
+
+//printf goes through the ring a line at a time, from one task at a time. In an interrupt
+//the characters are queued one by one, the line being buffered is left alone.
 int fputc(int ch, FILE *f)
-{ 	
-	while((USART1->SR&0X40)==0);//ѭ,ֱ   
-	USART1->DR = (u8) ch;      
+{
+	u8 c=(u8)ch;
+	if(__get_IPSR()!=0)
+	{
+		usart_write(&c,1);
+		return ch;
+	}
+	usart_line[usart_line_len++]=c;
+	if(c=='\n'||usart_line_len>=USART_LINE_LEN)usart_line_flush();
 	return ch;
 }
+
+void DMA2_Stream7_IRQHandler(void)
+{
+#if SYSTEM_SUPPORT_OS
+	OSIntEnter();
+#endif
+	if(DMA2->HISR&DMA_FLAG_TCIF7&0x0F7D0F7D)
+	{
+		DMA2->HIFCR=USART_TX_DMA_FLAGS;
+		usart_tx_tail=(usart_tx_tail+usart_tx_busy)&(USART_TX_LEN-1);
+		usart_tx_busy=0;
+		usart_tx_kick();
+	}
+#if SYSTEM_SUPPORT_OS
+	OSIntExit();
+#endif
+}
 #endif
  
 #if EN_USART1_RX   //ʹ˽
@@ -74,6 +187,7 @@ void uart_init(u32 bound){
   GPIO_InitTypeDef GPIO_InitStructure;
 	USART_InitTypeDef USART_InitStructure;
 	NVIC_InitTypeDef NVIC_InitStructure;
+	DMA_InitTypeDef DMA_InitStructure;
 	
 	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOA,ENABLE); //ʹGPIOAʱ
 	RCC_APB2PeriphClockCmd(RCC_APB2Periph_USART1,ENABLE);//ʹUSART1ʱ
@@ -99,7 +213,35 @@ void uart_init(u32 bound){
 	USART_InitStructure.USART_Mode = USART_Mode_Rx | USART_Mode_Tx;	//շģʽ
   USART_Init(USART1, &USART_InitStructure); //ʼ1
 	
-  USART_Cmd(USART1, ENABLE);  //ʹܴ1 
+  USART_Cmd(USART1, ENABLE);
+
+	//DMA2 Stream7 Channel4 for TX, the address and length are set per transfer
+	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2,ENABLE);
+	DMA_DeInit(DMA2_Stream7);
+	DMA_InitStructure.DMA_Channel = DMA_Channel_4;
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (u32)&USART1->DR;
+	DMA_InitStructure.DMA_Memory0BaseAddr = (u32)USART_TX_BUF;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_MemoryToPeripheral;
+	DMA_InitStructure.DMA_BufferSize = 1;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
+	DMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Disable;
+	DMA_InitStructure.DMA_FIFOThreshold = DMA_FIFOThreshold_Full;
+	DMA_InitStructure.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+	DMA_InitStructure.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+	DMA_Init(DMA2_Stream7, &DMA_InitStructure);
+	DMA_ITConfig(DMA2_Stream7, DMA_IT_TC, ENABLE);
+	USART_DMACmd(USART1, USART_DMAReq_Tx, ENABLE);
+
+	NVIC_InitStructure.NVIC_IRQChannel = DMA2_Stream7_IRQn;
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority=3;
+	NVIC_InitStructure.NVIC_IRQChannelSubPriority =2;
+	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&NVIC_InitStructure);  //ʹܴ1 
 	
 	//USART_ClearFlag(USART1, USART_FLAG_TC);
 	
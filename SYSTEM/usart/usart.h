@@ -28,11 +28,20 @@
 ////////////////////////////////////////////////////////////////////////////////// 	
 #define USART_REC_LEN  			200  	//ֽ 200
 #define EN_USART1_RX 			1		//ʹܣ1/ֹ01
+#define USART_TX_LEN  			2048  	//size of the TX ring, a power of 2
+#define USART_LINE_LEN  		256  	//longest line of printf queued whole
 	  	
 extern u8  USART_RX_BUF[USART_REC_LEN]; //ջ,USART_REC_LENֽ.ĩֽΪз 
 extern u16 USART_RX_STA;         		//״̬	
 //봮жϽգ벻Ҫעº궨
+extern u32 USART_TX_DROP;				//bytes dropped because the TX ring was full
+extern u32 USART_TX_DROP_CNT;			//writes dropped because the TX ring was full
+extern u16 USART_TX_PEAK;				//most bytes in the TX ring
 void uart_init(u32 bound);
+u16 usart_write(const u8 *buf,u16 len);
+u16 usart_tx_used(void);
+u16 usart_tx_free(void);
+void usart_flush(void);
 #endif
 
 
@@ -0,0 +1,109 @@
+/**
+	* @File:	test_autotune.c
+	* @Description:	Host simulation of APP/autotune.c on a joint modelled as first order plus
+	*		dead time, from current command to velocity. The identified ultimate gain and
+	*		period are compared with the analytic ones, the motor must be back in velocity
+	*		mode at the end, and the loop with the applied gains must follow a step.
+	*/
+
+#include "stdio.h"
+#include "math.h"
+#include "autotune.h"
+
+#define DT 0.001f
+/* Plant: T * dv/dt = K * u(t - L) - v */
+#define PLANT_K 20.0f
+#define PLANT_T 0.05f
+#define PLANT_DELAY 4
+
+static int fails = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); fails++; } } while (0)
+
+static float vel = 0.0f;
+static float u_hist[PLANT_DELAY + 1];
+
+static void plant_step(float u)
+{
+	int i;
+
+	for (i = PLANT_DELAY; i > 0; i--)
+		u_hist[i] = u_hist[i - 1];
+	u_hist[0] = u;
+	vel += DT / PLANT_T * (PLANT_K * u_hist[PLANT_DELAY] - vel);
+}
+
+/* One control tick as ctrl_task runs it */
+static void tick(MOTOR_t *m, AUTOTUNE_t *at, float sp)
+{
+	MOTOR_sync_param(m, 1);
+	MOTOR_set_fbk(m, 0.0f, vel, 0.0f);
+	if (AUTOTUNE_calc(at) != AUTOTUNE_RELAY_STATE)
+		MOTOR_vel_mode(m, sp);
+	MOTOR_calc(m);
+	plant_step(MOTOR_get_cmd(m));
+}
+
+int main(void)
+{
+	MOTOR_t m;
+	AUTOTUNE_t at;
+	float w, ku, tu, peak = 0.0f, err = 0.0f, jump;
+	int k;
+
+	/* Phase crossover of K * exp(-L s) / (T s + 1) by bisection: atan(w T) + w L = pi */
+	float lo = 1.0f, hi = 1e4f, L = (PLANT_DELAY + 0.5f) * DT;
+	for (k = 0; k < 60; k++)
+	{
+		w = 0.5f * (lo + hi);
+		if (atanf(w * PLANT_T) + w * L < 3.14159265f)
+			lo = w;
+		else
+			hi = w;
+	}
+	ku = sqrtf(1.0f + w * w * PLANT_T * PLANT_T) / PLANT_K;
+	tu = 2.0f * 3.14159265f / w;
+
+	MOTOR_init(&m, MOTOR_VELOCITY_MODE);
+	MOTOR_set_vel_loop_gain(&m, 0.01f, 0.0005f);
+	PID_publish();
+	AUTOTUNE_init(&at, &m, AUTOTUNE_VEL_LOOP, DT);
+
+	/* Hold 10 with the old gains, then run the relay around it */
+	for (k = 0; k < 2000; k++)
+		tick(&m, &at, 10.0f);
+	AUTOTUNE_start(&at, 10.0f, MOTOR_get_cmd(&m), 1.0f, 0.05f, 5.0f);
+	for (k = 0; k < 5000 && AUTOTUNE_get_state(&at) == AUTOTUNE_RELAY_STATE; k++)
+		tick(&m, &at, 10.0f);
+
+	printf("relay: ku %.4f tu %.4f s, analytic ku %.4f tu %.4f s\n", at.ku, at.tu, ku, tu);
+	CHECK(AUTOTUNE_get_state(&at) == AUTOTUNE_DONE_STATE, "state %d", AUTOTUNE_get_state(&at));
+	CHECK(fabsf(at.ku / ku - 1.0f) < 0.25f, "ku %g off the analytic %g", at.ku, ku);
+	CHECK(fabsf(at.tu / tu - 1.0f) < 0.25f, "tu %g off the analytic %g", at.tu, tu);
+	CHECK(m.mode == MOTOR_VELOCITY_MODE, "mode %d after the experiment", m.mode);
+
+	/* The old loop takes over at the relay center without a jump of the command */
+	jump = MOTOR_get_cmd(&m);
+	tick(&m, &at, 10.0f);
+	jump = fabsf(MOTOR_get_cmd(&m) - jump);
+	CHECK(jump < 1.0f + 1e-3f, "command jumps by %g at the end", jump);
+
+	/* Step response with the Tyreus-Luyben PI gains */
+	CHECK(AUTOTUNE_apply(&at, AUTOTUNE_TL_PI_RULE) == 0, "apply failed");
+	printf("TL PI: kp %.5f ki %.6f\n", at.kp, at.ki);
+	for (k = 0; k < 1000; k++)
+		tick(&m, &at, 10.0f);
+	for (k = 0; k < 3000; k++)
+	{
+		tick(&m, &at, 30.0f);
+		peak = fmaxf(peak, vel);
+		if (k >= 2000)
+			err = fmaxf(err, fabsf(vel - 30.0f));
+	}
+	printf("step 10 -> 30: peak %.3f, error after 2 s %.4f\n", peak, err);
+	CHECK(peak < 30.0f + 0.3f * 20.0f, "overshoot to %g", peak);
+	CHECK(err < 0.1f, "does not settle, error %g", err);
+
+	printf("%s\n", fails ? "FAILED" : "PASSED");
+	return fails != 0;
+}
@@ -0,0 +1,98 @@
+/**
+	* @File:	test_ffd.c
+	* @Description:	Host test of the identification of APP/ffd.c: slow sweeps of a simulated joint
+	*		in both directions over its range, in the units of tasks.c where the velocity is
+	*		thousands of times the sin/cos of the gravity, must give back the friction and
+	*		gravity of the joint. Sweeps at one velocity or at one angle must be refused.
+	*/
+
+#include "stdio.h"
+#include "math.h"
+#include "ffd.h"
+
+/* Velocity of the velocity loop per RPM and Coulomb band, as SCA_VEL_SCALE and CTRL_FFD_VEL_EPS */
+#define VEL_SCALE (68.0f * 64.0f)
+#define VEL_EPS VEL_SCALE
+
+static int fails = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); fails++; } } while (0)
+
+static const FFD_t joint = {0.8f, 2e-5f, 3.0f, -1.0f, VEL_EPS, 0.0f};
+
+/* Pseudo random noise in [-amp, amp] */
+static float noise(float amp)
+{
+	static unsigned int seed = 12345;
+
+	seed = seed * 1664525u + 1013904223u;
+	return amp * ((float)(seed >> 8) / 8388608.0f - 1.0f);
+}
+
+/* Sweep the angle from a0 to a1 at rpm, adding a sample per tick of 1 ms, with a noise of amp
+   on the current and of amp / 4 RPM on the velocity */
+static void sweep(FFD_Ident_t *id, float rpm, float a0, float a1, float amp)
+{
+	FFD_t model = joint;
+	float vel = rpm * VEL_SCALE;
+	float step = rpm * 6.2831853f / 60.0f * 0.001f;
+	float ang;
+
+	for (ang = a0; (step > 0.0f) ? ang < a1 : ang > a1; ang += step)
+		FFD_ident_add(id, vel + noise(0.25f * amp * VEL_SCALE), ang, FFD_calc(&model, vel, ang) + noise(amp));
+}
+
+int main(void)
+{
+	static const float rpm[] = {2.0f, 5.0f, 10.0f};
+	FFD_Ident_t id;
+	FFD_t ffd;
+	int i;
+
+	/* Without noise the model must come back within float rounding */
+	FFD_ident_init(&id, VEL_EPS);
+	for (i = 0; i < 3; i++)
+	{
+		sweep(&id, rpm[i], -1.0f, 2.0f, 0.0f);
+		sweep(&id, -rpm[i], 2.0f, -1.0f, 0.0f);
+	}
+	FFD_init(&ffd, 0.0f, 0.0f, 0.0f, 0.0f, VEL_EPS);
+	CHECK(FFD_ident_solve(&id, &ffd) == 0, "%u samples of sweeps refused", id.num);
+	printf("%u samples: kc %g kv %g kgc %g kgs %g\n", id.num, ffd.kc, ffd.kv, ffd.kgc, ffd.kgs);
+	CHECK(fabsf(ffd.kc - joint.kc) < 1e-4f * joint.kc, "kc %g instead of %g", ffd.kc, joint.kc);
+	CHECK(fabsf(ffd.kv - joint.kv) < 1e-4f * joint.kv, "kv %g instead of %g", ffd.kv, joint.kv);
+	CHECK(fabsf(ffd.kgc - joint.kgc) < 1e-4f * fabsf(joint.kgc), "kgc %g instead of %g", ffd.kgc, joint.kgc);
+	CHECK(fabsf(ffd.kgs - joint.kgs) < 1e-4f * fabsf(joint.kgs), "kgs %g instead of %g", ffd.kgs, joint.kgs);
+	CHECK(ffd.vel_eps == VEL_EPS, "vel_eps %g not taken over", ffd.vel_eps);
+
+	/* With the noise of the current and the velocity feedback */
+	FFD_ident_init(&id, VEL_EPS);
+	for (i = 0; i < 3; i++)
+	{
+		sweep(&id, rpm[i], -1.0f, 2.0f, 0.2f);
+		sweep(&id, -rpm[i], 2.0f, -1.0f, 0.2f);
+	}
+	CHECK(FFD_ident_solve(&id, &ffd) == 0, "noisy sweeps refused");
+	printf("with noise: kc %g kv %g kgc %g kgs %g\n", ffd.kc, ffd.kv, ffd.kgc, ffd.kgs);
+	CHECK(fabsf(ffd.kc - joint.kc) < 0.02f * joint.kc, "kc %g instead of %g", ffd.kc, joint.kc);
+	CHECK(fabsf(ffd.kv - joint.kv) < 0.02f * joint.kv, "kv %g instead of %g", ffd.kv, joint.kv);
+	CHECK(fabsf(ffd.kgc - joint.kgc) < 0.02f * fabsf(joint.kgc), "kgc %g instead of %g", ffd.kgc, joint.kgc);
+	CHECK(fabsf(ffd.kgs - joint.kgs) < 0.02f * fabsf(joint.kgs), "kgs %g instead of %g", ffd.kgs, joint.kgs);
+
+	/* One velocity per direction cannot tell the Coulomb from the viscous friction */
+	FFD_ident_init(&id, VEL_EPS);
+	sweep(&id, 5.0f, -1.0f, 2.0f, 0.0f);
+	sweep(&id, -5.0f, 2.0f, -1.0f, 0.0f);
+	FFD_init(&ffd, 1.0f, 2.0f, 3.0f, 4.0f, VEL_EPS);
+	CHECK(FFD_ident_solve(&id, &ffd) == -1, "sweeps at one velocity accepted");
+	CHECK(ffd.kc == 1.0f && ffd.kgs == 4.0f, "model changed by a refused solve");
+
+	/* Standing at one angle cannot tell the gravity terms apart */
+	FFD_ident_init(&id, VEL_EPS);
+	for (i = 0; i < 1000; i++)
+		FFD_ident_add(&id, (i % 2) ? 3.0f * VEL_SCALE : -7.0f * VEL_SCALE, 0.5f, 1.0f);
+	CHECK(FFD_ident_solve(&id, &ffd) == -1, "samples at one angle accepted");
+
+	printf("%s\n", fails ? "FAILED" : "PASSED");
+	return fails != 0;
+}
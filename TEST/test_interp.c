@@ -0,0 +1,62 @@
+/**
+	* @File:	test_interp.c
+	* @Description:	Host test of APP/interp.c: no underrun is counted while the joint stands at
+	*		the reset position, a waypoint arriving in the middle of a segment does not change
+	*		the reference of that segment, and waypoints at 10 ms give a continuous reference.
+	*/
+
+#include "stdio.h"
+#include "math.h"
+#include "interp.h"
+
+static int fails = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); fails++; } } while (0)
+
+int main(void)
+{
+	INTERP_t in;
+	float pos, jump = 0.0f, last = 0.0f;
+	unsigned int t;
+
+	/* Standing at the reset position is no underrun */
+	INTERP_init(&in, 20000);
+	INTERP_reset(&in, 1000, 0.5f);
+	for (t = 1000; t < 50000; t += 1000)
+		INTERP_calc(&in, t);
+	CHECK(in.underrun_cnt == 0, "underrun %u after reset", in.underrun_cnt);
+	CHECK(INTERP_get_pos(&in) == 0.5f, "moved to %g after reset", INTERP_get_pos(&in));
+
+	/* The reference of the segment being evaluated stays as it was */
+	INTERP_reset(&in, 0, 0.0f);
+	INTERP_push(&in, 10000, 1.0f);
+	INTERP_calc(&in, 5000);
+	pos = INTERP_get_pos(&in);
+	INTERP_push(&in, 20000, 1.0f);
+	INTERP_calc(&in, 5000);
+	CHECK(INTERP_get_pos(&in) == pos, "segment changed from %g to %g", pos, INTERP_get_pos(&in));
+
+	/* A sine streamed at 100 Hz, 10 ms ahead, evaluated at 1 kHz */
+	INTERP_reset(&in, 0, 0.0f);
+	for (t = 0; t <= 2000000; t += 1000)
+	{
+		if (t % 10000 == 0)
+			INTERP_push(&in, t + 10000, sinf(6.2831853f * (t + 10000) * 1e-6f));
+		INTERP_calc(&in, t);
+		if (t > 20000)
+			jump = fmaxf(jump, fabsf(INTERP_get_pos(&in) - last));
+		last = INTERP_get_pos(&in);
+	}
+	CHECK(in.underrun_cnt == 0, "underrun %u while streaming", in.underrun_cnt);
+	CHECK(in.late_cnt == 0, "late %u while streaming", in.late_cnt);
+	CHECK(jump < 1.1f * 6.2831853f * 1e-3f, "step %g per tick over the velocity of the sine", jump);
+
+	/* The stream stops: one underrun, then the reference holds */
+	for (; t <= 2100000; t += 1000)
+		INTERP_calc(&in, t);
+	CHECK(in.underrun_cnt == 1, "underrun %u after the stream", in.underrun_cnt);
+	CHECK(INTERP_get_state(&in) == INTERP_HOLD_STATE, "state %d after the stream", INTERP_get_state(&in));
+
+	printf("%s\n", fails ? "FAILED" : "PASSED");
+	return fails != 0;
+}
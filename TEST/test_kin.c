@@ -0,0 +1,184 @@
+/**
+	* @File:	test_kin.c
+	* @Description:	Host test of APP/kin.c against a double precision reference: KIN_sincos()
+	*		and KIN_atan2() over their range, the forward kinematics, the Jacobian against
+	*		central differences of the reference and the inverse kinematics round trip.
+	*		The cost of the functions is printed in ns per call on the host, and in cycles
+	*		of the host if its clock is given as the first argument in MHz.
+	*/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "math.h"
+#include "time.h"
+#include "kin.h"
+
+static int fails = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); fails++; } } while (0)
+
+/* Bounds of the errors, as given in the comments of kin.c */
+#define SINCOS_TOL 4e-7
+#define ATAN2_TOL 2e-6
+#define FK_TOL 1e-6
+#define JAC_TOL 1e-4
+#define IK_TOL 1e-5
+
+static const double l1[LEG_NUM] = {0.08, -0.08, 0.08, -0.08};
+static const double l2[LEG_NUM] = {0.21, 0.21, 0.2, 0.2};
+static const double l3[LEG_NUM] = {0.2, 0.2, 0.22, 0.22};
+static const double knee[LEG_NUM] = {1.0, 1.0, -1.0, -1.0};
+
+static void fk_ref(int i, const double q[3], double p[3])
+{
+	double d = l2[i] * cos(q[1]) + l3[i] * cos(q[1] + q[2]);
+
+	p[0] = -l2[i] * sin(q[1]) - l3[i] * sin(q[1] + q[2]);
+	p[1] = l1[i] * cos(q[0]) + d * sin(q[0]);
+	p[2] = l1[i] * sin(q[0]) - d * cos(q[0]);
+}
+
+static double urand(double lo, double hi)
+{
+	return lo + (hi - lo) * rand() / (double)RAND_MAX;
+}
+
+static double host_ns(clock_t c0, double calls)
+{
+	return 1e9 * (double)(clock() - c0) / CLOCKS_PER_SEC / calls;
+}
+
+int main(int argc, char **argv)
+{
+	KIN_Geom_t geom;
+	KIN_Legs_t legs;
+	float pf[3][LEG_NUM], qf[LEG_JOINT_NUM][LEG_NUM];
+	float s, c, fx, acc = 0.0f;
+	double x, y, e, e_sc = 0.0, e_at = 0.0, e_fk = 0.0, e_jac = 0.0, e_ik = 0.0;
+	double q[3], qh[3], p[3], ph[3], pl[3], ns, mhz;
+	const double h = 1e-6;
+	clock_t c0;
+	int i, j, k, n, err;
+
+	mhz = (argc > 1) ? atof(argv[1]) : 0.0;
+	srand(1);
+
+	for (x = -100.0; x <= 100.0; x += 1e-4)
+	{
+		fx = (float)x;
+		KIN_sincos(fx, &s, &c);
+		e = fmax(fabs(s - sin((double)fx)), fabs(c - cos((double)fx)));
+		e_sc = fmax(e_sc, e);
+	}
+	printf("KIN_sincos: max error %.2e for |x| <= 100\n", e_sc);
+	CHECK(e_sc < SINCOS_TOL, "KIN_sincos error %.2e", e_sc);
+
+	for (k = 0; k < 2000000; k++)
+	{
+		x = urand(-1.0, 1.0);
+		y = urand(-1.0, 1.0);
+		e = fabs(KIN_atan2((float)y, (float)x) - atan2((float)y, (float)x));
+		e_at = fmax(e_at, e);
+	}
+	CHECK(KIN_atan2(0.0f, 0.0f) == 0.0f, "KIN_atan2(0, 0) is not 0");
+	printf("KIN_atan2: max error %.2e\n", e_at);
+	CHECK(e_at < ATAN2_TOL, "KIN_atan2 error %.2e", e_at);
+
+	for (i = 0; i < LEG_NUM; i++)
+		KIN_set_geom(&geom, i, (float)l1[i], (float)l2[i], (float)l3[i], (float)knee[i]);
+
+	for (n = 0; n < 20000; n++)
+	{
+		for (i = 0; i < LEG_NUM; i++)
+		{
+			legs.q[KIN_ABD][i] = (float)urand(-0.5, 0.5);
+			legs.q[KIN_HIP][i] = (float)urand(-1.2, 1.2);
+			legs.q[KIN_KNEE][i] = (float)(knee[i] * urand(0.2, 2.4));
+		}
+		KIN_fk(&geom, &legs);
+		KIN_jac(&geom, &legs);
+
+		for (i = 0; i < LEG_NUM; i++)
+		{
+			for (j = 0; j < 3; j++)
+				q[j] = legs.q[j][i];
+			fk_ref(i, q, p);
+			for (j = 0; j < 3; j++)
+				e_fk = fmax(e_fk, fabs(legs.p[j][i] - p[j]));
+
+			/* Column k of the Jacobian by central differences */
+			for (k = 0; k < 3; k++)
+			{
+				for (j = 0; j < 3; j++)
+					qh[j] = q[j];
+				qh[k] = q[k] + h;
+				fk_ref(i, qh, ph);
+				qh[k] = q[k] - h;
+				fk_ref(i, qh, pl);
+				for (j = 0; j < 3; j++)
+					e_jac = fmax(e_jac, fabs(legs.jac[KIN_J(j, k)][i] - (ph[j] - pl[j]) / (2.0 * h)));
+			}
+
+			for (j = 0; j < 3; j++)
+				pf[j][i] = legs.p[j][i];
+		}
+
+		/* The foot positions are reachable, so the angles come back with the same knee */
+		err = KIN_ik(&geom, pf, qf);
+		CHECK(err == 0, "KIN_ik out of reach 0x%x for reachable feet", err);
+		for (i = 0; i < LEG_NUM; i++)
+		{
+			for (j = 0; j < 3; j++)
+				q[j] = qf[j][i];
+			fk_ref(i, q, p);
+			for (j = 0; j < 3; j++)
+				e_ik = fmax(e_ik, fabs(p[j] - legs.p[j][i]));
+		}
+	}
+	printf("KIN_fk: max error %.2e, KIN_jac: max error %.2e, KIN_ik: max position error %.2e\n", e_fk, e_jac, e_ik);
+	CHECK(e_fk < FK_TOL, "KIN_fk error %.2e", e_fk);
+	CHECK(e_jac < JAC_TOL, "KIN_jac error %.2e", e_jac);
+	CHECK(e_ik < IK_TOL, "KIN_ik error %.2e", e_ik);
+
+	/* A foot beyond the leg length is flagged and moved in reach */
+	for (i = 0; i < LEG_NUM; i++)
+	{
+		pf[0][i] = 0.0f;
+		pf[1][i] = (float)l1[i];
+		pf[2][i] = -1.0f;
+	}
+	err = KIN_ik(&geom, pf, qf);
+	CHECK(err == (1 << LEG_NUM) - 1, "KIN_ik did not flag the feet out of reach: 0x%x", err);
+
+	c0 = clock();
+	for (k = 0; k < 10000000; k++)
+	{
+		KIN_sincos(k * 1e-5f, &s, &c);
+		acc += s + c;
+	}
+	ns = host_ns(c0, 1e7);
+	printf("KIN_sincos: %.1f ns per call on the host", ns);
+	if (mhz > 0.0)
+		printf(", %.0f host cycles", ns * mhz * 1e-3);
+	printf("\n");
+
+	c0 = clock();
+	for (k = 0; k < 1000000; k++)
+	{
+		legs.q[KIN_HIP][k & 3] = k * 1e-6f;
+		KIN_fk(&geom, &legs);
+		KIN_jac(&geom, &legs);
+		KIN_ik(&geom, (const float (*)[LEG_NUM])legs.p, qf);
+		acc += qf[KIN_KNEE][0];
+	}
+	ns = host_ns(c0, 1e6);
+	printf("KIN_fk + KIN_jac + KIN_ik of %d legs: %.0f ns per call on the host", LEG_NUM, ns);
+	if (mhz > 0.0)
+		printf(", %.0f host cycles", ns * mhz * 1e-3);
+	printf("\n");
+	if (acc == 12345.0f)
+		printf("\n");
+
+	printf(fails ? "FAILED\n" : "PASSED\n");
+	return fails != 0;
+}
@@ -0,0 +1,217 @@
+/**
+	* @File:	test_lqr.c
+	* @Description:	Host simulation of APP/lqr.c with the gains generated by TOOLS/lqr_gain.py
+	*		for the simulated joint, so the sign convention of the tool and of the controller
+	*		are checked together: the closed loop must follow a step of position, reject a
+	*		constant load and track a smooth move. The same joint is run with the cascade of
+	*		position P and velocity PI loops for comparison, and the cost of one tick of both
+	*		is printed in ns on the host. LQR_calc_batch() must scale the velocity feedback
+	*		of the velocity loop as set by LQR_set_vel_scale().
+	*/
+
+#include "stdio.h"
+#include "math.h"
+#include "time.h"
+#include "lqr.h"
+
+/* Plant: J * dvel/dt = u + load - b * vel, the same model and tick as the gain table */
+#define DT 0.001f
+#define PLANT_J 0.02f
+#define PLANT_B 0.1f
+/* Sub steps of the plant per tick */
+#define PLANT_SUB 10
+/* Time of the smooth move in s */
+#define MOVE_T 0.3f
+
+/* LQR_gain_table of APP/lqr_table.c: lqr_gain.py --dt 0.001 --q 1000 1 100000 --r 1 --joint 0.02 0.1,
+   checked against the output of the tool by the Makefile */
+
+static int fails = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); fails++; } } while (0)
+
+static float pos = 0.0f, vel = 0.0f;
+
+static void plant_step(float u, float load)
+{
+	int i;
+
+	for (i = 0; i < PLANT_SUB; i++)
+	{
+		pos += vel * DT / PLANT_SUB;
+		vel += (u + load - PLANT_B * vel) / PLANT_J * DT / PLANT_SUB;
+	}
+}
+
+typedef struct Resp_t
+{
+	/* Step of position 0 -> 1 */
+	float over;
+	float settle;
+	float iae;
+	/* Constant load of 1 applied while holding 1 */
+	float dev;
+	float err_end;
+	/* Smooth move 1 -> 2 under the load, with the velocity reference */
+	float track;
+} Resp_t;
+
+/* One control tick as ctrl_task runs it, with LQR_calc_batch() if lqr is given */
+static void tick(MOTOR_t *m, LQR_t *lqr, float sp, float sp_vel, float load)
+{
+	MOTOR_sync_param(m, 1);
+	MOTOR_set_fbk(m, 0.0f, vel, pos);
+	if (lqr)
+	{
+		LQR_set_ref(lqr, sp, sp_vel, 0.0f);
+		LQR_calc_batch(lqr, m, 1);
+	}
+	else
+		MOTOR_pos_vel_mode(m, sp, sp_vel);
+	MOTOR_calc(m);
+	plant_step(MOTOR_get_cmd(m), load);
+}
+
+static void run(MOTOR_t *m, LQR_t *lqr, Resp_t *r)
+{
+	float load, sp, sp_vel, t;
+	int k;
+
+	r->over = 0.0f;
+	r->settle = 0.0f;
+	r->iae = 0.0f;
+	r->dev = 0.0f;
+	r->err_end = 0.0f;
+	r->track = 0.0f;
+
+	for (k = 0; k < 5000; k++)
+	{
+		load = (k >= 2000) ? 1.0f : 0.0f;
+		sp = 1.0f;
+		sp_vel = 0.0f;
+		if (k >= 4000)
+		{
+			/* Half a cosine in MOVE_T */
+			t = fminf((k - 4000) * DT, MOVE_T);
+			sp = 1.5f - 0.5f * cosf(3.14159265f * t / MOVE_T);
+			sp_vel = (t < MOVE_T) ? 0.5f * 3.14159265f / MOVE_T * sinf(3.14159265f * t / MOVE_T) : 0.0f;
+		}
+		tick(m, lqr, sp, sp_vel, load);
+
+		if (k < 2000)
+		{
+			r->over = fmaxf(r->over, pos - 1.0f);
+			r->iae += fabsf(1.0f - pos) * DT;
+			if (fabsf(1.0f - pos) > 0.02f)
+				r->settle = (k + 1) * DT;
+		}
+		else if (k < 4000)
+		{
+			r->dev = fmaxf(r->dev, fabsf(pos - 1.0f));
+			if (k >= 3500)
+				r->err_end = fmaxf(r->err_end, fabsf(pos - 1.0f));
+		}
+		else
+		{
+			r->track = fmaxf(r->track, fabsf(pos - sp));
+		}
+	}
+}
+
+int main(void)
+{
+	const LQR_Gain_t *g = &LQR_gain_table[0];
+	MOTOR_t m;
+	LQR_t lqr;
+	Resp_t rl, rp;
+	float jump, acc = 0.0f;
+	clock_t c0;
+	int k;
+
+	printf("gains: kp %.4g kv %.4g ki %.4g\n", g->kp, g->kv, g->ki);
+	CHECK(g->kp > 0.0f && g->kv > 0.0f && g->ki > 0.0f, "gains of the table are not all positive");
+
+	/* Cascade of the MCU: position P, velocity PI, current loop passing the command through */
+	MOTOR_init(&m, MOTOR_POSITION_VELOCITY_MODE);
+	MOTOR_set_pos_loop_gain(&m, 15.0f, 0.0f, 0.0f);
+	MOTOR_set_vel_loop_gain(&m, 1.0f, 0.02f);
+	PID_publish();
+	run(&m, NULL, &rp);
+	CHECK(fabsf(pos - 2.0f) < 0.01f, "cascade ends at %g instead of 2", pos);
+
+	/* State feedback, taken over from the cascade while it holds the load */
+	LQR_init(&lqr, g, DT);
+	jump = MOTOR_get_cmd(&m);
+	LQR_start(&lqr, &m);
+	tick(&m, &lqr, 2.0f, 0.0f, 1.0f);
+	jump = fabsf(MOTOR_get_cmd(&m) - jump);
+	CHECK(jump < 0.05f, "command jumps by %g when the state feedback takes over", jump);
+
+	/* Both from standstill at 0 */
+	pos = 0.0f;
+	vel = 0.0f;
+	LQR_init(&lqr, g, DT);
+	LQR_start(&lqr, &m);
+	run(&m, &lqr, &rl);
+	CHECK(fabsf(pos - 2.0f) < 0.01f, "state feedback ends at %g instead of 2", pos);
+
+	/* The feedback of the velocity loop in its own unit, scaled back by the batch */
+	{
+		LQR_t ref;
+		MOTOR_t ms;
+
+		LQR_init(&ref, g, DT);
+		LQR_set_ref(&ref, 1.0f, 0.5f, 0.0f);
+		LQR_init(&lqr, g, DT);
+		LQR_set_ref(&lqr, 1.0f, 0.5f, 0.0f);
+		LQR_set_vel_scale(&lqr, 60.0f);
+		MOTOR_init(&ms, MOTOR_STATE_FEEDBACK_MODE);
+		MOTOR_set_fbk(&ms, 0.0f, 0.3f * 60.0f, 0.8f);
+		CHECK(LQR_calc_batch(&lqr, &ms, 1) == 0, "joint in state feedback mode skipped");
+		CHECK(fabsf(LQR_get_out(&lqr) - LQR_calc(&ref, 0.8f, 0.3f)) < 1e-4f, "scaled velocity gives %g instead of %g",
+			LQR_get_out(&lqr), LQR_get_out(&ref));
+	}
+
+	printf("                step 0 -> 1                   load 1                   move 1 -> 2\n");
+	printf("                overshoot  settle 2%%  IAE     deviation  final error  tracking error\n");
+	printf("P-PI cascade    %-9.4f  %-9.3f  %-6.4f  %-9.4f  %-11.5f  %.4f\n", rp.over, rp.settle, rp.iae, rp.dev, rp.err_end, rp.track);
+	printf("state feedback  %-9.4f  %-9.3f  %-6.4f  %-9.4f  %-11.5f  %.4f\n", rl.over, rl.settle, rl.iae, rl.dev, rl.err_end, rl.track);
+
+	/* A sign error of the tool or of the controller makes the loop diverge or leaves the load.
+	   The integral of the error of an unshaped step overshoots, which is why the references
+	   should come from a trajectory. */
+	CHECK(rl.settle > 0.0f && rl.settle < 1.0f, "state feedback does not settle, %g s", rl.settle);
+	CHECK(rl.over < 0.25f, "state feedback overshoots by %g", rl.over);
+	CHECK(rl.err_end < 1e-3f, "state feedback does not reject the load, error %g", rl.err_end);
+	CHECK(rp.err_end < 1e-2f, "cascade does not reject the load, error %g", rp.err_end);
+	CHECK(rl.dev < rp.dev, "state feedback deviates more under load than the cascade: %g > %g", rl.dev, rp.dev);
+	CHECK(rl.track < rp.track, "state feedback tracks the move worse than the cascade: %g > %g", rl.track, rp.track);
+
+	c0 = clock();
+	for (k = 0; k < 1000000; k++)
+	{
+		MOTOR_set_fbk(&m, 0.0f, k * 1e-6f, 1.0f);
+		LQR_calc_batch(&lqr, &m, 1);
+		MOTOR_calc(&m);
+		acc += MOTOR_get_cmd(&m);
+	}
+	printf("LQR_calc_batch + MOTOR_calc: %.1f ns per tick on the host\n",
+		1e9 * (double)(clock() - c0) / CLOCKS_PER_SEC / 1e6);
+
+	MOTOR_set_mode(&m, MOTOR_POSITION_VELOCITY_MODE);
+	c0 = clock();
+	for (k = 0; k < 1000000; k++)
+	{
+		MOTOR_set_fbk(&m, 0.0f, k * 1e-6f, 1.0f);
+		MOTOR_pos_vel_mode(&m, 1.0f, 0.0f);
+		MOTOR_calc(&m);
+		acc += MOTOR_get_cmd(&m);
+	}
+	printf("cascade MOTOR_calc: %.1f ns per tick on the host\n",
+		1e9 * (double)(clock() - c0) / CLOCKS_PER_SEC / 1e6);
+	if (acc == 12345.0f)
+		printf("\n");
+
+	printf("%s\n", fails ? "FAILED" : "PASSED");
+	return fails != 0;
+}
@@ -0,0 +1,106 @@
+/**
+	* @File:	test_os.c
+	* @Description:	Host test of the POSIX port of SYSTEM/os/os_port.c: the semaphores count and
+	*		time out, and a control task woken by a simulated 1 kHz tick, the way TICK_wait()
+	*		is woken by TIM3, runs once per tick. The wake-up latency of the control task
+	*		is printed in us.
+	*/
+
+#include "stdio.h"
+#include "time.h"
+#include "os_port.h"
+
+#define TICK_US 1000
+#define TICKS 500
+
+static int fails = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); fails++; } } while (0)
+
+static os_sem_t tick_sem, done_sem;
+static os_stk_t tick_stk[256], ctrl_stk[256];
+static volatile double t_post;
+static double lat_min = 1e9, lat_max = 0.0, lat_sum = 0.0;
+static int runs = 0;
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+/* Stands for the tick interrupt */
+static void tick_task(void *arg)
+{
+	int k;
+
+	(void)arg;
+	for (k = 0; k < TICKS; k++)
+	{
+		os_delay_us(TICK_US);
+		t_post = now_us();
+		os_sem_post(&tick_sem);
+	}
+}
+
+static void ctrl_task(void *arg)
+{
+	double lat;
+
+	(void)arg;
+	while (runs < TICKS)
+	{
+		os_sem_pend(&tick_sem, OS_WAIT_FOREVER);
+		lat = now_us() - t_post;
+		lat_min = (lat < lat_min) ? lat : lat_min;
+		lat_max = (lat > lat_max) ? lat : lat_max;
+		lat_sum += lat;
+		runs++;
+	}
+	os_sem_post(&done_sem);
+}
+
+int main(void)
+{
+	double t0, t;
+	int ret;
+
+	os_init();
+
+	/* Counting and timeout */
+	os_sem_init(&tick_sem, 0);
+	t0 = now_us();
+	ret = os_sem_pend(&tick_sem, 20000);
+	t = now_us() - t0;
+	CHECK(ret == -1, "pend on an empty semaphore returns %d", ret);
+	CHECK(t >= 20000.0 && t < 100000.0, "timeout of 20000 us took %.0f us", t);
+
+	os_sem_post(&tick_sem);
+	os_sem_post(&tick_sem);
+	CHECK(os_sem_pend(&tick_sem, 1000) == 0, "first post is lost");
+	CHECK(os_sem_pend(&tick_sem, 1000) == 0, "second post is lost");
+	os_sem_post(&tick_sem);
+	os_sem_clr(&tick_sem);
+	CHECK(os_sem_pend(&tick_sem, 1000) == -1, "post survives os_sem_clr()");
+
+	t0 = now_us();
+	os_delay_us(5000);
+	t = now_us() - t0;
+	CHECK(t >= 5000.0, "delay of 5000 us took %.0f us", t);
+
+	/* Control task on the tick, at the top priority as in tasks.c */
+	os_sem_init(&done_sem, 0);
+	CHECK(os_task_create(ctrl_task, 0, 0, ctrl_stk, sizeof(ctrl_stk) / sizeof(ctrl_stk[0])) == 0, "control task not created");
+	CHECK(os_task_create(tick_task, 0, 1, tick_stk, sizeof(tick_stk) / sizeof(tick_stk[0])) == 0, "tick task not created");
+	ret = os_sem_pend(&done_sem, 10 * TICKS * TICK_US);
+	CHECK(ret == 0, "control task ran %d of %d ticks", runs, TICKS);
+
+	if (runs > 0)
+		printf("wake-up latency of the control task: min %.1f us, mean %.1f us, max %.1f us\n",
+			lat_min, lat_sum / runs, lat_max);
+
+	printf("%s\n", fails ? "FAILED" : "PASSED");
+	return fails != 0;
+}
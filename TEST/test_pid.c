@@ -0,0 +1,117 @@
+/**
+	* @File:	test_pid.c
+	* @Description:	Host test of APP/pid.c: each loop runs in the mode given to PID_init(),
+	*		the regular mode integrates within the limits and stops at them, the D term
+	*		acts on the rise of the error, and both modes give the same output for the same
+	*		gains and errors. A change of ki by the gain schedule does not step the output,
+	*		and the schedule does not overwrite the published gains.
+	*		PID_set_state() hands over without a step, also to P and PD loops.
+	*/
+
+#include "stdio.h"
+#include "math.h"
+#include "pid.h"
+
+static int fails = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); fails++; } } while (0)
+
+static float step(PID_t *pid, float in, float fbk)
+{
+	PID_set_in(pid, in);
+	PID_set_fbk(pid, fbk);
+	PID_calc(pid);
+	return PID_get_out(pid);
+}
+
+int main(void)
+{
+	PID_t reg, inc;
+	float out, e;
+	int k;
+
+	PID_init(&reg, PID_REGULAR_MODE, 1.0f, 0.1f, 0.0f);
+	PID_init(&inc, PID_INCREMENT_MODE, 1.0f, 0.1f, 0.0f);
+	CHECK(reg.mode == PID_REGULAR_MODE && inc.mode == PID_INCREMENT_MODE, "mode not kept");
+
+	/* A constant error of 1 is integrated every calculation */
+	for (k = 1; k <= 10; k++)
+		out = step(&reg, 1.0f, 0.0f);
+	CHECK(fabsf(out - 2.0f) < 1e-5f, "regular output %g after 10 steps, expected 2", out);
+
+	/* Same gains and errors give the same output in both modes */
+	PID_init(&reg, PID_REGULAR_MODE, 0.5f, 0.05f, 0.2f);
+	PID_init(&inc, PID_INCREMENT_MODE, 0.5f, 0.05f, 0.2f);
+	for (k = 0; k < 200; k++)
+	{
+		e = sinf(0.05f * k);
+		out = step(&reg, e, 0.0f);
+		CHECK(fabsf(out - step(&inc, e, 0.0f)) < 1e-4f, "modes differ at %d", k);
+	}
+
+	/* The D term pushes against a rising feedback */
+	PID_init(&reg, PID_REGULAR_MODE, 1.0f, 0.0f, 1.0f);
+	step(&reg, 0.0f, 0.0f);
+	out = step(&reg, 0.0f, 1.0f);
+	CHECK(fabsf(out + 2.0f) < 1e-6f, "P + D output %g for a feedback step of 1, expected -2", out);
+
+	/* The integral stops at the limit and comes back at once when the error turns */
+	PID_init(&reg, PID_REGULAR_MODE, 1.0f, 0.1f, 0.0f);
+	PID_set_limit(&reg, 1.0f, -1.0f);
+	PID_sync(&reg);
+	for (k = 0; k < 1000; k++)
+		step(&reg, 5.0f, 0.0f);
+	CHECK(reg.err_sum < 100.0f, "integral %g wound up at the limit", reg.err_sum);
+	out = step(&reg, -0.5f, 0.0f);
+	CHECK(out < 1.0f, "output %g stays at the limit after the error turned", out);
+
+	/* A P and a PD loop taken over at an output of 5 with an error of 1 continue from it */
+	PID_init(&reg, PID_REGULAR_MODE, 2.0f, 0.0f, 0.0f);
+	PID_set_fbk(&reg, 0.0f);
+	PID_set_state(&reg, 1.0f, 5.0f);
+	out = step(&reg, 1.0f, 0.0f);
+	CHECK(fabsf(out - 5.0f) < 1e-6f, "P output %g after the transfer, expected 5", out);
+	out = step(&reg, 1.5f, 0.0f);
+	CHECK(fabsf(out - 6.0f) < 1e-6f, "P output %g after an error step of 0.5, expected 6", out);
+	PID_init(&reg, PID_REGULAR_MODE, 2.0f, 0.0f, 1.0f);
+	PID_set_fbk(&reg, 0.0f);
+	PID_set_state(&reg, 1.0f, 5.0f);
+	out = step(&reg, 1.0f, 0.0f);
+	CHECK(fabsf(out - 5.0f) < 1e-6f, "PD output %g after the transfer, expected 5", out);
+
+	/* ki scheduled from 0.01 to 0.1 while a constant error has been integrated: the output
+	   only changes by the new integration, not by rescaling the old integral */
+	{
+		static const float x[2] = {0.0f, 1.0f}, kp[2] = {1.0f, 1.0f}, ki[2] = {0.01f, 0.1f}, kd[2] = {0.0f, 0.0f};
+		PID_Sched_t sched;
+		float last;
+
+		CHECK(PID_sched_init(&sched, x, kp, ki, kd, 2) == 0, "schedule rejected");
+		PID_init(&reg, PID_REGULAR_MODE, 1.0f, 0.01f, 0.0f);
+		PID_set_sched(&reg, &sched);
+		PID_sync(&reg);
+		PID_set_sched_var(&reg, 0.0f);
+		for (k = 0; k < 1000; k++)
+			last = step(&reg, 1.0f, 0.0f);
+		PID_set_sched_var(&reg, 1.0f);
+		out = step(&reg, 1.0f, 0.0f);
+		CHECK(fabsf(out - last - 0.1f) < 1e-4f, "output steps by %g when ki is scheduled up, expected 0.1", out - last);
+
+		/* The schedule gives the gains without overwriting the published ones, which apply
+		   again when the schedule is removed */
+		PID_set_gain(&reg, 3.0f, 0.0f, 0.0f);
+		PID_sync(&reg);
+		CHECK(reg.act->kp == 3.0f && reg.act->sched == &sched, "published gain %g or schedule lost", reg.act->kp);
+		last = step(&reg, 2.0f, 0.0f);
+		out = step(&reg, 3.0f, 0.0f);
+		CHECK(fabsf(out - last - 1.3f) < 1e-4f, "scheduled gains give %g for an error step of 1 to 3, expected 1.3", out - last);
+		PID_set_sched(&reg, 0);
+		PID_sync(&reg);
+		last = step(&reg, 3.0f, 0.0f);
+		out = step(&reg, 4.0f, 0.0f);
+		CHECK(fabsf(out - last - 3.0f) < 1e-4f, "published kp gives %g for an error step of 1, expected 3", out - last);
+	}
+
+	printf("%s\n", fails ? "FAILED" : "PASSED");
+	return fails != 0;
+}
@@ -0,0 +1,93 @@
+/**
+	* @File:	test_sched.c
+	* @Description:	Host test of APP/sched.c with a simulated clock: the main loop of tasks.c is
+	*		run on a 1 ms tick with a jittering latency, the control task runs in every cycle
+	*		and stays on the grid of the tick after a late run, and a task with a budget is
+	*		put off while the budget does not fit before the deadline.
+	*/
+
+#include "stdio.h"
+#include "sched.h"
+
+#define TICK_US 1000
+
+static int fails = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); fails++; } } while (0)
+
+/* Simulated time in us, advanced by the tasks */
+static unsigned int now_us = 0;
+/* Execution time of the next run of each task */
+static unsigned int ctrl_us = 300, bg_us = 400;
+static unsigned int ctrl_runs = 0, bg_runs = 0;
+
+static unsigned int sim_clock(void)
+{
+	return now_us;
+}
+
+static void ctrl_func(void)
+{
+	ctrl_runs++;
+	now_us += ctrl_us;
+}
+
+static void bg_func(void)
+{
+	bg_runs++;
+	now_us += bg_us;
+}
+
+int main(void)
+{
+	SCHED_t s;
+	SCHED_Task_t *ctrl, *bg;
+	unsigned int tick = 0, cycles = 0, late = 0;
+	int k;
+
+	SCHED_init(&s, sim_clock);
+	/* Registered out of order, the shorter period must come first */
+	SCHED_add(&s, "bg", bg_func, 10 * TICK_US, 500);
+	SCHED_add(&s, "ctrl", ctrl_func, TICK_US, 0);
+	ctrl = SCHED_get_task(&s, "ctrl");
+	bg = SCHED_get_task(&s, "bg");
+	CHECK(ctrl == &s.task[0] && bg == &s.task[1], "tasks are not sorted by period");
+	CHECK(SCHED_get_task(&s, "lcd") == 0, "unknown task found");
+
+	for (k = 0; k < 1000; k++)
+	{
+		/* The cycle starts with a latency of 10 to 30 us after the tick, the longest right
+		   after the late run, where the missed releases are dropped */
+		now_us = tick * TICK_US + ((k == 501) ? 30 : 10 + (k * 7) % 21);
+		ctrl_us = (k == 500) ? 2500 : 300;
+		/* Little slack in some cycles, the background task must wait for the others */
+		bg_us = 400;
+		if (k % 3 == 0)
+			ctrl_us += 400;
+
+		SCHED_run(&s, (tick + 1) * TICK_US);
+		cycles++;
+
+		/* Skip policy: the ticks which have passed are dropped */
+		if (now_us >= (tick + 1) * TICK_US)
+			late++;
+		tick = now_us / TICK_US + 1;
+	}
+
+	printf("cycles %u, ctrl %u runs %u miss, bg %u runs %u defer %u over\n",
+		cycles, ctrl->cnt, ctrl->miss, bg->cnt, bg->defer, bg->over);
+
+	CHECK(late == 1, "%u late cycles instead of 1", late);
+	CHECK(ctrl_runs == cycles, "ctrl ran in %u of %u cycles", ctrl_runs, cycles);
+	CHECK(ctrl->next % TICK_US == 0, "ctrl is off the grid of the tick, next release %u", ctrl->next);
+	CHECK(ctrl->miss == 2, "ctrl missed %u releases instead of 2", ctrl->miss);
+	CHECK(bg->defer > 0, "bg was never put off");
+	CHECK(bg->over == 0, "bg overran its budget %u times", bg->over);
+	CHECK(bg->next % TICK_US == 0, "bg is off the grid of the tick, next release %u", bg->next);
+	/* One run per 10 ms on average, less the releases missed while it was put off */
+	CHECK(bg_runs + bg->miss >= tick / 10 - 1 && bg_runs <= tick / 10 + 1,
+		"bg ran %u times and missed %u in %u ticks", bg_runs, bg->miss, tick);
+
+	printf("%s\n", fails ? "FAILED" : "PASSED");
+	return fails != 0;
+}
@@ -0,0 +1,116 @@
+/**
+	* @File:	test_traj.c
+	* @Description:	Host test of APP/traj.c: moves of several lengths and limits, also with the
+	*		target changed during the motion, must stay within the velocity, acceleration and
+	*		jerk limits, must not overshoot the target and must settle. The cost of
+	*		TRAJ_calc() is printed in ns per call on the host. TRAJ_to_motor() must give the
+	*		position loop the scaled velocity as its feedforward, as ctrl_task does.
+	*/
+
+#include "stdio.h"
+#include "math.h"
+#include "time.h"
+#include "traj.h"
+
+static int fails = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { printf("FAIL: " __VA_ARGS__); printf("\n"); fails++; } } while (0)
+
+/* Run a move to tgt, return the number of ticks to settle */
+static int run_move(float dt, float vm, float am, float jm, float p0, float tgt, int change_at, float tgt2)
+{
+	TRAJ_t t;
+	float over = 0.0f, back = 0.0f, vpk = 0.0f, apk = 0.0f, jpk = 0.0f, acc_last = 0.0f;
+	float side = 0.0f, final_tgt = tgt;
+	int k;
+
+	TRAJ_init(&t, dt, vm, am, jm);
+	TRAJ_reset(&t, p0);
+	TRAJ_set_target(&t, tgt);
+
+	for (k = 0; k < 200000; k++)
+	{
+		if (k == change_at)
+		{
+			TRAJ_set_target(&t, tgt2);
+			final_tgt = tgt2;
+		}
+		TRAJ_calc(&t);
+
+		vpk = fmaxf(vpk, fabsf(t.vel));
+		apk = fmaxf(apk, fabsf(t.acc));
+		jpk = fmaxf(jpk, fabsf(t.acc - acc_last) / dt);
+		acc_last = t.acc;
+		/* A new target may be too close to stop at, the overshoot is counted once the
+		   joint heads for the last target */
+		if (side == 0.0f && (k >= change_at || change_at < 0) && t.vel * (final_tgt - t.pos) > 0.0f)
+			side = (final_tgt > t.pos) ? 1.0f : -1.0f;
+		over = fmaxf(over, side * (t.pos - final_tgt));
+		back = fmaxf(back, -side * t.vel);
+
+		if (TRAJ_is_done(&t))
+			break;
+	}
+
+	CHECK(k < 200000, "move %g->%g did not settle", p0, final_tgt);
+	CHECK(t.pos == final_tgt, "move %g->%g ended at %g", p0, final_tgt, t.pos);
+	CHECK(vpk <= vm * (1.0f + 1e-5f), "move %g->%g velocity %.7g over %g", p0, final_tgt, vpk, vm);
+	CHECK(apk <= am * (1.0f + 1e-5f), "move %g->%g acceleration %.7g over %g", p0, final_tgt, apk, am);
+	CHECK(jpk <= jm * (1.0f + 1e-3f), "move %g->%g jerk %.7g over %g", p0, final_tgt, jpk, jm);
+	CHECK(back <= 1e-4f * vm, "move %g->%g reverses at %.7g", p0, final_tgt, -back);
+	CHECK(over <= 1e-5f * fmaxf(1.0f, fabsf(final_tgt - p0)), "move %g->%g overshoot %.7g", p0, final_tgt, over);
+
+	return k;
+}
+
+int main(void)
+{
+	static const float len[] = {1.0f, 0.01f, 1e-4f, 3.0f, -2.0f, 25.0f};
+	static const float vmax[] = {10.0f, 0.5f, 2.0f};
+	TRAJ_t t[12];
+	MOTOR_t m;
+	clock_t c0;
+	int i, j, n;
+
+	for (i = 0; i < (int)(sizeof(len) / sizeof(len[0])); i++)
+		for (j = 0; j < (int)(sizeof(vmax) / sizeof(vmax[0])); j++)
+		{
+			n = run_move(0.001f, vmax[j], 20.0f, 400.0f, 0.0f, len[i], -1, 0.0f);
+			printf("move %-8g vmax %-4g: %d ticks\n", len[i], vmax[j], n);
+		}
+
+	/* Target changed in the middle of the motion: shortened to where the joint can still
+	   stop, moved behind the joint, and extended */
+	run_move(0.001f, 10.0f, 20.0f, 400.0f, 0.0f, 1.0f, 150, 0.7f);
+	run_move(0.001f, 10.0f, 20.0f, 400.0f, 0.0f, 1.0f, 250, -0.5f);
+	run_move(0.001f, 0.5f, 20.0f, 400.0f, 0.0f, 1.0f, 800, 1.2f);
+	run_move(0.0005f, 4.0f, 50.0f, 2000.0f, 1.0f, -1.0f, 100, 2.0f);
+
+	/* Setpoint of the position velocity mode, in the velocity unit of the velocity loop */
+	MOTOR_init(&m, MOTOR_POSITION_VELOCITY_MODE);
+	TRAJ_init(&t[0], 0.001f, 0.5f, 5.0f, 100.0f);
+	TRAJ_set_vel_scale(&t[0], 60.0f);
+	TRAJ_set_target(&t[0], 1.0f);
+	for (n = 0; n < 100; n++)
+		TRAJ_calc(&t[0]);
+	CHECK(TRAJ_to_motor(&t[0], &m) == 0, "position velocity mode refused");
+	CHECK(m.pid_pos.in == t[0].pos && m.pid_pos.ffd == t[0].vel * 60.0f && t[0].vel > 0.0f,
+		"setpoint %g %g sent as %g %g", t[0].pos, t[0].vel, m.pid_pos.in, m.pid_pos.ffd);
+	MOTOR_init(&m, MOTOR_VELOCITY_MODE);
+	CHECK(TRAJ_to_motor(&t[0], &m) == -1, "velocity mode took a position setpoint");
+
+	/* Cost per call during a long motion of 12 joints */
+	for (i = 0; i < 12; i++)
+	{
+		TRAJ_init(&t[i], 0.001f, 10.0f, 20.0f, 400.0f);
+		TRAJ_set_target(&t[i], 1000.0f + i);
+	}
+	c0 = clock();
+	for (n = 0; n < 20000; n++)
+		TRAJ_calc_batch(t, 12);
+	printf("TRAJ_calc: %.0f ns per call on the host\n",
+		1e9 * (double)(clock() - c0) / CLOCKS_PER_SEC / (20000.0 * 12));
+
+	printf("%s\n", fails ? "FAILED" : "PASSED");
+	return fails != 0;
+}
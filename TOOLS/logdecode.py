@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""
+Decoder of the deferred log sent by SYSTEM/log/log.c.
+
+The firmware sends only the address of the format string, the cycle counter
+and the raw 32 bit arguments of each LOG0() to LOG4() call. The format strings
+are read here from the ELF file of the same build, by the address, so the ELF
+must match the firmware running on the board:
+
+    python3 logdecode.py ../OBJ/LCD.axf /dev/ttyUSB0      (needs pyserial)
+    python3 logdecode.py ../OBJ/LCD.axf capture.bin
+
+Each line is printed as the time in seconds since the first entry, the file and
+line of the call and the formatted message. The frames of the joint telemetry
+and the text output are skipped, see telem.py.
+
+The strings are looked up in the region ER_LOGSTR of the scatter file
+USER/LCD.sct, or a section .logstr of another linker, otherwise in whichever
+section holds the address, as when .logstr is merged into the code.
+
+The cycle counter is unwrapped by the signed difference to the previous entry,
+because an entry is reserved before its time is read, so an entry may carry an
+earlier time than the one before it in the ring.
+
+Only the standard library is used for decoding.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+import telem
+
+LOG_MAGIC = 0x4C4F0000
+LOG_VERSION = 1
+
+SPEC = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diouxXcfFeEgGsp%])")
+
+
+class Elf:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        d = self.data
+        if d[:4] != b"\x7fELF":
+            raise ValueError("%s is not an ELF file" % path)
+        is64 = d[4] == 2
+        end = "<" if d[5] == 1 else ">"
+        if is64:
+            shoff, = struct.unpack_from(end + "Q", d, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from(end + "HHH", d, 0x3A)
+            sh = struct.Struct(end + "IIQQQQIIQQ")
+        else:
+            shoff, = struct.unpack_from(end + "I", d, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from(end + "HHH", d, 0x2E)
+            sh = struct.Struct(end + "IIIIIIIIII")
+
+        raw = [sh.unpack_from(d, shoff + i * shentsize) for i in range(shnum)]
+        names = raw[shstrndx]
+        self.sections = []
+        for name, typ, flags, addr, off, size, *_ in raw:
+            # SHT_NOBITS has no data in the file
+            if typ == 8 or size == 0:
+                continue
+            end_name = d.index(b"\0", names[4] + name)
+            sname = d[names[4] + name:end_name].decode("ascii", "replace")
+            self.sections.append((sname, addr, off, size))
+        # The strings first, so their own copy wins over an overlapping address
+        self.sections.sort(key=lambda s: s[0] not in (".logstr", "ER_LOGSTR"))
+        self.cache = {}
+
+    def string(self, addr):
+        if addr in self.cache:
+            return self.cache[addr]
+        s = None
+        for name, base, off, size in self.sections:
+            if base <= addr < base + size:
+                start = off + addr - base
+                stop = self.data.find(b"\0", start, off + size)
+                s = self.data[start:stop if stop >= 0 else off + size].decode("latin-1")
+                break
+        self.cache[addr] = s
+        return s
+
+
+def format_args(fmt, args):
+    """Format the raw words as printf would, floats are single precision."""
+    out = []
+    pos = 0
+    i = 0
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, _, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        if i >= len(args):
+            out.append("<?>")
+            continue
+        w = args[i]
+        i += 1
+        if conv in "di":
+            v = struct.unpack("<i", struct.pack("<I", w))[0]
+        elif conv in "fFeEgG":
+            v = struct.unpack("<f", struct.pack("<I", w))[0]
+        elif conv in "sp":
+            out.append("0x%08x" % w)
+            continue
+        else:
+            v = w
+        out.append(("%" + flags + conv) % v)
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+class LogDecoder:
+    def __init__(self, elf):
+        self.elf = elf
+        self.t0 = None
+        self.t = 0
+        self.t_last = None
+        self.drops = 0
+
+    def frame(self, raw):
+        """Yield (time in s, where, message) of the entries of a log frame without the CRC."""
+        typ, ver, n = struct.unpack_from("<BBH", raw, 0)
+        if typ != telem.TYPE_LOG or ver != LOG_VERSION:
+            return
+        cyc_per_us, self.drops = struct.unpack_from("<II", raw, 4)
+        words = struct.unpack_from("<%dI" % ((len(raw) - 12) // 4), raw, 12)
+        i = 0
+        for _ in range(n):
+            if i + 3 > len(words) or words[i] & 0xFFFFFFF0 != LOG_MAGIC:
+                break
+            argc = words[i] & 0x0F
+            fid, cyc = words[i + 1], words[i + 2]
+            args = words[i + 3:i + 3 + argc]
+            i += 3 + argc
+
+            # The cycle counter wraps every few tens of seconds, and an entry may be
+            # stamped a little before the one ahead of it in the ring
+            if self.t_last is None:
+                self.t = cyc
+            else:
+                d = (cyc - self.t_last) & 0xFFFFFFFF
+                self.t += d - (1 << 32) if d & 0x80000000 else d
+            self.t_last = cyc
+            t = self.t
+            if self.t0 is None:
+                self.t0 = t
+
+            fmt = self.elf.string(fid)
+            if fmt is None:
+                where, msg = "?", "unknown format 0x%08x %s" % (fid, " ".join("%08x" % a for a in args))
+            else:
+                where, _, body = fmt.partition(": ")
+                msg = format_args(body, args)
+            yield (t - self.t0) / (cyc_per_us * 1e6), where, msg
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("elf", help="ELF file of the firmware, OBJ/LCD.axf")
+    ap.add_argument("input", help="serial port, capture file or - for stdin")
+    ap.add_argument("--baud", type=int, default=telem.BAUD)
+    args = ap.parse_args()
+
+    log = LogDecoder(Elf(args.elf))
+    src = telem.open_input(args.input, args.baud)
+    dec = telem.Decoder()
+    try:
+        while True:
+            data = src.read(4096)
+            if not data:
+                if hasattr(src, "in_waiting"):
+                    continue
+                break
+            for kind, item in dec.feed(data):
+                if kind != "log":
+                    continue
+                for t, where, msg in log.frame(item):
+                    print("%12.6f %-24s %s" % (t, where, msg))
+    except KeyboardInterrupt:
+        pass
+    sys.stderr.write("dropped entries: %d\n" % log.drops)
+
+
+if __name__ == "__main__":
+    main()
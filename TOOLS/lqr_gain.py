@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""
+Offline design of the joint state feedback gains used by APP/lqr.c.
+
+The joint is modeled as  J * dvel/dt = u - b * vel, where u is the current
+command and J and b are identified in the unit of the current command, the
+same as the feedforward model of APP/ffd.c. The model is discretized with
+zero order hold at the control tick and augmented with the integral of the
+position error, then the discrete algebraic Riccati equation is iterated
+until it converges. The gains are run in closed loop on the model in the form
+of LQR_calc(), and the tool fails if the loop does not settle.
+
+The result is printed as a C table of LQR_Gain_t, one entry per joint:
+
+    python3 lqr_gain.py --dt 0.001 --q 1000 1 100000 --r 1 \\
+        --joint 0.02 0.1 --joint 0.05 0.2 > lqr_table.c
+
+Only the standard library is used, so it runs wherever Python 3 does.
+"""
+
+import argparse
+import math
+import sys
+
+
+def mat_mul(a, b):
+    return [[sum(a[i][k] * b[k][j] for k in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+def mat_add(a, b):
+    return [[a[i][j] + b[i][j] for j in range(len(a[0]))] for i in range(len(a))]
+
+
+def mat_sub(a, b):
+    return [[a[i][j] - b[i][j] for j in range(len(a[0]))] for i in range(len(a))]
+
+
+def mat_t(a):
+    return [list(r) for r in zip(*a)]
+
+
+def model(inertia, damping, dt):
+    """Zero order hold discretization of [pos, vel, integral of pos]."""
+    a = damping / inertia
+    if a * dt < 1e-6:
+        ev = 1.0
+        pv = dt
+        bv = dt / inertia
+        bp = dt * dt / (2.0 * inertia)
+    else:
+        ev = math.exp(-a * dt)
+        pv = (1.0 - ev) / a
+        bv = (1.0 - ev) / damping
+        bp = (dt - pv) / damping
+
+    A = [[1.0, pv, 0.0],
+         [0.0, ev, 0.0],
+         [dt, 0.0, 1.0]]
+    B = [[bp], [bv], [0.0]]
+    return A, B
+
+
+def dlqr(A, B, Q, r, iters=100000, tol=1e-10):
+    """Iterates the Riccati equation, returns K of u = -K * x."""
+    P = [row[:] for row in Q]
+    At = mat_t(A)
+    Bt = mat_t(B)
+    K = None
+
+    for _ in range(iters):
+        PA = mat_mul(P, A)
+        PB = mat_mul(P, B)
+        s = r + mat_mul(Bt, PB)[0][0]
+        K = [[v / s for v in mat_mul(Bt, PA)[0]]]
+        Pn = mat_add(Q, mat_sub(mat_mul(At, PA), mat_mul(mat_mul(At, PB), K)))
+        diff = max(abs(Pn[i][j] - P[i][j]) for i in range(3) for j in range(3))
+        P = Pn
+        if diff < tol * max(1.0, max(abs(v) for row in P for v in row)):
+            return K[0]
+
+    raise RuntimeError("Riccati iteration did not converge")
+
+
+def check(A, B, k, dt, ticks=20000):
+    """Runs the gains in the form of LQR_calc() on the model, from 1 off the reference.
+
+    Returns the final position error, which is small only if the gains and their signs
+    fit the controller.
+    """
+    pos, vel, integ = 1.0, 0.0, 0.0
+    for _ in range(ticks):
+        ep, ev = -pos, -vel
+        u = k[0] * ep + k[1] * ev + k[2] * integ
+        integ += ep * dt
+        pos, vel = A[0][0] * pos + A[0][1] * vel + B[0][0] * u, A[1][1] * vel + B[1][0] * u
+        if not abs(pos) < 1e6:
+            return float("inf")
+    return abs(pos)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Design the gain table of APP/lqr.c")
+    parser.add_argument("--dt", type=float, required=True, help="period of control tick in second")
+    parser.add_argument("--q", type=float, nargs=3, metavar=("QP", "QV", "QI"), required=True,
+                        help="state weights of position error, velocity error and integral")
+    parser.add_argument("--r", type=float, required=True, help="weight of current command")
+    parser.add_argument("--joint", type=float, nargs=2, metavar=("J", "B"), action="append", required=True,
+                        help="inertia and viscous damping of a joint, in the unit of the current command")
+    parser.add_argument("--name", default="LQR_gain_table", help="name of the C table")
+    args = parser.parse_args()
+
+    Q = [[args.q[0], 0.0, 0.0], [0.0, args.q[1], 0.0], [0.0, 0.0, args.q[2]]]
+
+    out = sys.stdout
+    out.write("/* Generated by TOOLS/lqr_gain.py, dt = %g s, Q = diag(%g, %g, %g), R = %g */\n"
+              % (args.dt, args.q[0], args.q[1], args.q[2], args.r))
+    out.write("#include \"lqr.h\"\n\n")
+    out.write("const LQR_Gain_t %s[%d] =\n{\n" % (args.name, len(args.joint)))
+
+    for inertia, damping in args.joint:
+        if inertia <= 0.0 or damping < 0.0:
+            parser.error("inertia must be positive and damping not negative")
+        A, B = model(inertia, damping, args.dt)
+        k = dlqr(A, B, Q, args.r)
+        # u = -K * [pos, vel, z] equals kp * ep + kv * ev + ki * integ of lqr.c, where the
+        # errors are ref - meas and integ = -z. Checked by running the loop like lqr.c does.
+        err = check(A, B, k, args.dt)
+        if not err < 1e-3:
+            sys.exit("J = %g, b = %g: the closed loop does not converge, error %g" % (inertia, damping, err))
+        out.write("\t/* J = %g, b = %g */\n" % (inertia, damping))
+        out.write("\t{%.7ef, %.7ef, %.7ef},\n" % (k[0], k[1], k[2]))
+
+    out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+"""
+Decoder of the binary telemetry sent by HARDWARE/TELEM/telem.c.
+
+Each frame on the serial port is a zero byte, the COBS encoded frame followed by
+its CRC, and a zero byte. The CRC is CRC-32/MPEG-2 as computed by the CRC unit
+of the STM32 over the little endian words of the frame. Anything between the
+frames which does not decode is the text output of printf and is passed on as
+text.
+
+The schema frame describes the fields of the joint records and their LSB, it
+is sent at startup and again every TELEM_SCHEMA_PERIOD frames, so the decoder
+can start in the middle of a stream. Joint frames seen before the first schema
+are skipped.
+
+As a library:
+
+    dec = telem.Decoder()
+    for kind, item in dec.feed(data):
+        ...
+
+where kind is "schema", "joint", "chan", "text" or "log", the frames of the
+log are decoded by logdecode.py. The names of the channels are taken from the
+answer to the LIST command as it passes in the text.
+
+As a tool it prints the joint records as CSV, one line per joint:
+
+    python3 telem.py /dev/ttyUSB0 > log.csv      (needs pyserial)
+    python3 telem.py capture.bin > log.csv
+
+or with --sub, which sends LIST and SUB to the board, the subscribed channels,
+one line per sample, e.g. the velocity loop error every cycle and the current
+every 10 cycles without the joint frames:
+
+    python3 telem.py /dev/ttyUSB0 --joint 0 --sub j0.vel.err --sub j0.actr.cur:10
+
+Only the standard library is used for decoding.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+TYPE_SCHEMA = 0x01
+TYPE_JOINT = 0x02
+TYPE_LOG = 0x03
+TYPE_CHAN = 0x04
+VERSION = 1
+BAUD = 2000000
+LOOPS = ("cur", "vel", "pos")
+VARS = ("<f", "<I", "<i", "<I", "<i", "<I")
+
+HEAD = struct.Struct("<BBBBIHH")
+CHAN_HEAD = struct.Struct("<BBBBI")
+SAMPLE = struct.Struct("<HHI")
+
+
+def crc32_stm32(data):
+    crc = 0xFFFFFFFF
+    for (word,) in struct.iter_unpack("<I", data):
+        crc ^= word
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else (crc << 1)
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def unpack_frame(chunk):
+    """Return the frame without the CRC, or None if the chunk is not a valid frame."""
+    try:
+        raw = cobs_decode(chunk)
+    except ValueError:
+        return None
+    if len(raw) < 8 or len(raw) % 4:
+        return None
+    if crc32_stm32(raw[:-4]) != struct.unpack_from("<I", raw, len(raw) - 4)[0]:
+        return None
+    return raw[:-4]
+
+
+class Schema:
+    def __init__(self, raw):
+        (self.type, self.version, self.n_field, self.rec_size,
+         self.rate_hz, self.joint_max, self.loop_num) = struct.unpack_from("<BBBBIBB", raw, 0)
+        self.loop_lsb = struct.unpack_from("<%df" % self.loop_num, raw, 12)
+        self.names = []
+        self.lsb = []
+        off = 12 + 4 * self.loop_num
+        for _ in range(self.n_field):
+            name, lsb = struct.unpack_from("<8sf", raw, off)
+            self.names.append(name.split(b"\0")[0].decode("ascii"))
+            self.lsb.append(lsb)
+            off += 12
+        self.rec = struct.Struct("<%dh" % (self.rec_size // 2))
+
+    def field_lsb(self, loop):
+        return [lsb if lsb != 0.0 else self.loop_lsb[loop] for lsb in self.lsb]
+
+
+class Decoder:
+    def __init__(self):
+        self.buf = bytearray()
+        self.schema = None
+        self.errors = 0
+        self.lost = 0
+        self.seq = None
+        self.names = {}
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            end = self.buf.find(b"\0")
+            if end < 0:
+                return
+            chunk = bytes(self.buf[:end])
+            del self.buf[:end + 1]
+            if not chunk:
+                continue
+            raw = unpack_frame(chunk)
+            if raw is None:
+                text = chunk.decode("latin-1")
+                self.parse_text(text)
+                yield "text", text
+                continue
+            item = self.parse(raw)
+            if item is not None:
+                yield item
+
+    def parse_text(self, text):
+        for line in text.splitlines():
+            f = line.split()
+            if len(f) == 5 and f[0] == "CH" and f[1].isdigit():
+                self.names[int(f[1])] = f[2]
+
+    def parse(self, raw):
+        if raw[0] == TYPE_SCHEMA:
+            if raw[1] != VERSION:
+                self.errors += 1
+                return None
+            self.schema = Schema(raw)
+            return "schema", self.schema
+        if raw[0] == TYPE_LOG:
+            return "log", raw
+        if raw[0] == TYPE_CHAN:
+            typ, ver, num, _, t_us = CHAN_HEAD.unpack_from(raw, 0)
+            values = []
+            for k in range(num):
+                cid, var, val = SAMPLE.unpack_from(raw, CHAN_HEAD.size + k * SAMPLE.size)
+                v = struct.unpack(VARS[var], struct.pack("<I", val))[0] if var < len(VARS) else val
+                values.append((cid, self.names.get(cid, str(cid)), v))
+            return "chan", {"t_us": t_us, "values": values}
+        if raw[0] != TYPE_JOINT or self.schema is None:
+            return None
+
+        typ, num, loop, ver, t_us, seq, stale = HEAD.unpack_from(raw, 0)
+        if self.seq is not None:
+            self.lost += (seq - self.seq - 1) & 0xFFFF
+        self.seq = seq
+
+        lsb = self.schema.field_lsb(loop)
+        joints = []
+        for j in range(num):
+            q = self.schema.rec.unpack_from(raw, HEAD.size + j * self.schema.rec_size)
+            rec = {n: v * s for n, v, s in zip(self.schema.names, q, lsb)}
+            rec["stale"] = (stale >> j) & 1
+            joints.append(rec)
+        return "joint", {"t_us": t_us, "seq": seq, "loop": LOOPS[loop], "joints": joints}
+
+
+def open_input(path, baud):
+    if path == "-":
+        return sys.stdin.buffer
+    if path.startswith("/dev/") or path.upper().startswith("COM"):
+        import serial
+        return serial.Serial(path, baud, timeout=0.1)
+    return open(path, "rb")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("input", help="serial port, capture file or - for stdin")
+    ap.add_argument("--baud", type=int, default=BAUD)
+    ap.add_argument("--text", action="store_true", help="print the text output to stderr")
+    ap.add_argument("--sub", action="append", default=[], metavar="NAME[:DIV]",
+                    help="subscribe a channel and print the channels instead of the joints")
+    ap.add_argument("--joint", type=int, metavar="DIV", help="decimation of the joint frames, 0 to stop them")
+    ap.add_argument("--loop", choices=LOOPS, help="loop of the joint records")
+    args = ap.parse_args()
+
+    src = open_input(args.input, args.baud)
+    if hasattr(src, "in_waiting"):
+        cmds = ["LIST"]
+        if args.joint is not None:
+            cmds.append("JOINT %d" % args.joint)
+        if args.loop:
+            cmds.append("LOOP " + args.loop)
+        if args.sub:
+            cmds.append("UNSUB ALL")
+        for sub in args.sub:
+            name, _, div = sub.partition(":")
+            cmds.append("SUB %s %s" % (name, div or "1"))
+        for cmd in cmds:
+            src.write((cmd + "\r\n").encode("ascii"))
+            src.flush()
+            # The board takes a command per run of its telemetry task
+            time.sleep(0.02)
+    dec = Decoder()
+    header = None
+    try:
+        while True:
+            data = src.read(4096)
+            if not data:
+                if hasattr(src, "in_waiting"):
+                    continue
+                break
+            for kind, item in dec.feed(data):
+                if kind == "text":
+                    if args.text:
+                        sys.stderr.write(item)
+                elif kind == "chan" and args.sub:
+                    if header is None:
+                        header = True
+                        print("t_us,id,name,value")
+                    for cid, name, v in item["values"]:
+                        print("%d,%d,%s,%g" % (item["t_us"], cid, name, v))
+                elif kind == "joint" and not args.sub:
+                    for j, rec in enumerate(item["joints"]):
+                        if header is None:
+                            header = list(rec)
+                            print("t_us,seq,loop,joint," + ",".join(header))
+                        print("%d,%d,%s,%d," % (item["t_us"], item["seq"], item["loop"], j)
+                              + ",".join("%g" % rec[k] for k in header))
+    except KeyboardInterrupt:
+        pass
+    sys.stderr.write("lost frames: %d, bad schema: %d\n" % (dec.lost, dec.errors))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,12 +1,97 @@
 #include "tasks.h"
+#include "string.h"
 
 MOTOR_t SCA[3];
+/* 1 for the joints whose feedback was not updated in the last cycle */
+unsigned char SCA_stale[ACTR_DEV_NUM];
+SCHED_t Sched;
 
+PROF_DEFINE(prof_ctrl, "ctrl");
+PROF_DEFINE(prof_motor, "motor");
+PROF_DECLARE(prof_can_rx);
+
+static CTRL_Sched_t Ctrl_sched = CTRL_SCHED_PERIODIC;
+/* Source of the setpoints per joint, a change requested by a command is taken by the next cycle */
+static CTRL_Src_t Ctrl_src[ACTR_DEV_NUM];
+static volatile CTRL_Src_t Ctrl_src_req[ACTR_DEV_NUM];
+static INTERP_t Ctrl_interp[ACTR_DEV_NUM];
+static TRAJ_t Ctrl_traj[ACTR_DEV_NUM];
+static LQR_t Ctrl_lqr[ACTR_DEV_NUM];
+static AUTOTUNE_t Ctrl_tune[ACTR_DEV_NUM];
+static CTRL_Tune_t Ctrl_tune_req[ACTR_DEV_NUM];
+/* Source to go back to at the end of the relay experiment */
+static CTRL_Src_t Ctrl_tune_ret[ACTR_DEV_NUM];
+/* Gain schedules of the loops, two per loop so the one in use is not written */
+static PID_Sched_t Ctrl_gain_sched[ACTR_DEV_NUM][CTRL_LOOP_NUM][2];
+/* Friction and gravity feedforward of the current loops, zero until it is set by a command */
+static FFD_t Ctrl_ffd[ACTR_DEV_NUM];
+static float Ctrl_ffd_ang[ACTR_DEV_NUM];
+/* Identification of the feedforward from the cycles, while Ctrl_ffd_id_on is set by a command */
+static FFD_Ident_t Ctrl_ffd_id[ACTR_DEV_NUM];
+static volatile unsigned char Ctrl_ffd_id_on[ACTR_DEV_NUM];
+static float Ctrl_ffd_id_vel[ACTR_DEV_NUM];
+/* External torque of the joints as current, it stays 0 until the model is set by a command */
+static DOB_t Ctrl_dob[ACTR_DEV_NUM];
+static CTRL_Stat_t Ctrl_stat;
+static TB_Time_t Ctrl_t_start = 0;
+/* End of the feedback of the running cycle */
+static TB_Time_t Ctrl_t_fbk = 0;
+/* Channels which did not fit in the registry of the telemetry */
+static int Telem_reg_fail = 0;
+
+static void ctrl_stat_add(unsigned int *min, unsigned int *max, unsigned int *sum, unsigned int v)
+{
+    *min = (v < *min) ? v : *min;
+    *max = (v > *max) ? v : *max;
+    *sum += v;
+}
+
+#if OS_PREEMPTIVE
+OS_STK_ALIGN static os_stk_t CTRL_TASK_STK[CTRL_STK_SIZE];
+OS_STK_ALIGN static os_stk_t CAN_RX_TASK_STK[CAN_RX_STK_SIZE];
+OS_STK_ALIGN static os_stk_t TELEM_TASK_STK[TELEM_STK_SIZE];
+OS_STK_ALIGN static os_stk_t UI_TASK_STK[UI_STK_SIZE];
+#endif
+
+/**
+	* @Function:	Initialize the system
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	Without a kernel the tasks are registered to the cooperative scheduler.
+                    With a kernel they are created as kernel tasks, and the actuators are set up
+                    by the control task, because the waits for CAN replies need the kernel running.
+*/
 void init_task(void)
 {
     init_task_hardware();
     init_task_controller();
+    init_task_telem();
+    ctrl_task_set_sched(CTRL_SCHED_PERIODIC);
+
+#if PROF_TRACE
+    /* The LEDs show the control cycle and the CAN parsing for a scope, instead of the health */
+    prof_set_trace(&prof_ctrl, GPIO_Pin_9);
+    prof_set_trace(&prof_can_rx, GPIO_Pin_10);
+#endif
+
+#if OS_PREEMPTIVE
+    os_task_create(rtos_ctrl_task, 0, CTRL_TASK_PRIO, CTRL_TASK_STK, CTRL_STK_SIZE);
+    os_task_create(rtos_can_rx_task, 0, CAN_RX_TASK_PRIO, CAN_RX_TASK_STK, CAN_RX_STK_SIZE);
+    os_task_create(rtos_telem_task, 0, TELEM_TASK_PRIO, TELEM_TASK_STK, TELEM_STK_SIZE);
+    os_task_create(rtos_ui_task, 0, UI_TASK_PRIO, UI_TASK_STK, UI_STK_SIZE);
+#else
     init_task_innfos();
+
+    TIM3_Init(CTRL_RATE_HZ);
+    WDG_Init(ActrSafeStop);
+    WDG_print();
+
+    SCHED_init(&Sched, TICK_get_us);
+    SCHED_add(&Sched, "ctrl", ctrl_task, 1000000 / CTRL_RATE_HZ, 0);
+    SCHED_add(&Sched, "telem", telem_task, TELEM_PERIOD_US, TELEM_BUDGET_US);
+    SCHED_add(&Sched, "diag", diag_task, DIAG_PERIOD_US, DIAG_BUDGET_US);
+    SCHED_add(&Sched, "lcd", lcd_task, LCD_PERIOD_US, LCD_BUDGET_US);
+#endif
 }
 
 /**
@@ -19,7 +104,11 @@ void init_task_hardware(void)
 {
     NVIC_PriorityGroupConfig(NVIC_PriorityGroup_2);
     delay_init(168);
-    uart_init(256000);
+    TB_init();
+    TIM2_Init();
+    os_init();
+    uart_init(TELEM_BAUD);
+    TELEM_init(CTRL_RATE_HZ);
     LED_Init();
     LCD_Init();
     CAN1_Init();
@@ -40,6 +129,22 @@ void init_task_controller(void)
     MOTOR_set_vel_loop_limit(&SCA[0], 33.0f, -33.0f);
     MOTOR_set_pos_loop_gain(&SCA[0], 1.0f, 0.0f, 0.0f);
     MOTOR_set_pos_loop_limit(&SCA[0], 0.0f, 0.0f);
+    PID_publish();
+
+    for (int i = 0; i < ACTR_DEV_NUM; i++)
+    {
+        Ctrl_src[i] = CTRL_SRC_DEMO;
+        Ctrl_src_req[i] = CTRL_SRC_DEMO;
+        INTERP_init(&Ctrl_interp[i], CTRL_INTERP_EXTRAP_US);
+        TRAJ_init(&Ctrl_traj[i], 1.0f / CTRL_RATE_HZ, CTRL_TRAJ_VMAX, CTRL_TRAJ_AMAX, CTRL_TRAJ_JMAX);
+        TRAJ_set_vel_scale(&Ctrl_traj[i], SCA_POS_VEL_SCALE);
+        LQR_init(&Ctrl_lqr[i], &LQR_gain_table[CTRL_LQR_GAIN], 1.0f / CTRL_RATE_HZ);
+        LQR_set_vel_scale(&Ctrl_lqr[i], SCA_POS_VEL_SCALE);
+        LQR_set_limit(&Ctrl_lqr[i], CTRL_LQR_CUR_MAX, -CTRL_LQR_CUR_MAX);
+        AUTOTUNE_init(&Ctrl_tune[i], &SCA[i], AUTOTUNE_VEL_LOOP, 1.0f / CTRL_RATE_HZ);
+        FFD_init(&Ctrl_ffd[i], 0.0f, 0.0f, 0.0f, 0.0f, CTRL_FFD_VEL_EPS);
+        DOB_init(&Ctrl_dob[i], 0.0f, 0.0f, CTRL_DOB_BW, 1.0f / CTRL_RATE_HZ);
+    }
 }
 
 /**
@@ -71,73 +176,1159 @@ void init_task_innfos(void)
         GetActrPara(ACTR_CMD_GET_CUR_MODE, devIDList[i]);
         if (pActrParaDev->actrMode != ACTR_MODE_CUR)
             SetActrMode(ACTR_MODE_CUR, devIDList[i]);
+        /* The actuator keeps the current of before a reset of the MCU */
+        SetActrCurrent(0.0f, devIDList[i]);
     }
 
     printf("SCA have been initialized!\r\n");
 }
 
+/* Register a channel, counting the ones which do not fit in the registry */
+static void init_task_telem_reg(const char *name, TELEM_Var_t type, const volatile void *addr)
+{
+    if (TELEM_reg(name, type, addr) < 0)
+        Telem_reg_fail++;
+}
+
+static void init_task_telem_pid(int j, const char *loop, PID_t *pid)
+{
+    char name[TELEM_NAME_LEN];
+
+    sprintf(name, "j%d.%s.in", j, loop);
+    init_task_telem_reg(name, TELEM_VAR_F32, &pid->in);
+    sprintf(name, "j%d.%s.fbk", j, loop);
+    init_task_telem_reg(name, TELEM_VAR_F32, &pid->fbk);
+    sprintf(name, "j%d.%s.ffd", j, loop);
+    init_task_telem_reg(name, TELEM_VAR_F32, &pid->ffd);
+    sprintf(name, "j%d.%s.out", j, loop);
+    init_task_telem_reg(name, TELEM_VAR_F32, &pid->out[0]);
+    sprintf(name, "j%d.%s.err", j, loop);
+    init_task_telem_reg(name, TELEM_VAR_F32, &pid->err[0]);
+    sprintf(name, "j%d.%s.esum", j, loop);
+    init_task_telem_reg(name, TELEM_VAR_F32, &pid->err_sum);
+}
+
+/**
+	* @Function:	Register the signals which the host may subscribe to
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	The PID state of each loop and the feedback of each joint, and the timing of the cycle.
+                    Nothing is sampled until the host subscribes, see TELEM_cmd(). The channels
+                    of a joint are counted by TELEM_CHAN_JOINT, a channel which does not fit in
+                    the registry is reported at startup.
+*/
+void init_task_telem(void)
+{
+    ActrParaTypedef *pActrParaDev;
+    char name[TELEM_NAME_LEN];
+
+    for (int i = 0; i < ACTR_DEV_NUM; i++)
+    {
+        init_task_telem_pid(i, "cur", &SCA[i].pid_cur);
+        init_task_telem_pid(i, "vel", &SCA[i].pid_vel);
+        init_task_telem_pid(i, "pos", &SCA[i].pid_pos);
+
+        pActrParaDev = FindActrDevByID(devIDList[i]);
+        sprintf(name, "j%d.actr.cur", i);
+        init_task_telem_reg(name, TELEM_VAR_F32, &pActrParaDev->actrCurrent);
+        sprintf(name, "j%d.dob", i);
+        init_task_telem_reg(name, TELEM_VAR_F32, &Ctrl_dob[i].out);
+        sprintf(name, "j%d.contact", i);
+        init_task_telem_reg(name, TELEM_VAR_U8, &Ctrl_dob[i].contact);
+        sprintf(name, "j%d.actr.vel", i);
+        init_task_telem_reg(name, TELEM_VAR_F32, &pActrParaDev->actrSpeed);
+        sprintf(name, "j%d.actr.pos", i);
+        init_task_telem_reg(name, TELEM_VAR_F32, &pActrParaDev->actrPostion);
+        sprintf(name, "j%d.actr.temp", i);
+        init_task_telem_reg(name, TELEM_VAR_F32, &pActrParaDev->actrMotorTemp);
+        sprintf(name, "j%d.stale", i);
+        init_task_telem_reg(name, TELEM_VAR_U8, &SCA_stale[i]);
+    }
+
+    init_task_telem_reg("ctrl.fbk_max", TELEM_VAR_U32, &Ctrl_stat.fbk_max);
+    init_task_telem_reg("ctrl.act_max", TELEM_VAR_U32, &Ctrl_stat.act_max);
+    init_task_telem_reg("ctrl.per_max", TELEM_VAR_U32, &Ctrl_stat.per_max);
+    init_task_telem_reg("ctrl.late", TELEM_VAR_U32, &Ctrl_stat.late);
+    init_task_telem_reg("ctrl.stale", TELEM_VAR_U32, &Ctrl_stat.stale);
+#if PROF_ENABLE
+    init_task_telem_reg("prof.ctrl.max", TELEM_VAR_U32, &prof_ctrl.max);
+    init_task_telem_reg("prof.motor.max", TELEM_VAR_U32, &prof_motor.max);
+#endif
+    init_task_telem_reg("uart.drop", TELEM_VAR_U32, &USART_TX_DROP);
+
+    if (Telem_reg_fail > 0)
+        printf("ERR TELEM %d channels not registered, raise TELEM_CHAN_MAX\r\n", Telem_reg_fail);
+}
+
+/* Switch the joint to the source requested, after its feedback of the cycle is read */
+static void ctrl_task_take_src(int i, uint32_t t_us)
+{
+    CTRL_Src_t src = Ctrl_src_req[i];
+    int ret;
+
+    if (src == Ctrl_src[i])
+        return;
+
+    /* Leaving an experiment before its end gives the joint back to its loops first */
+    if (Ctrl_src[i] == CTRL_SRC_TUNE)
+        AUTOTUNE_abort(&Ctrl_tune[i]);
+
+    /* A mode which the loops in the actuator cannot run is refused, the joint keeps its source
+       until the loops are taken back by ctrl_task_set_exec() */
+    switch (src)
+    {
+    case CTRL_SRC_INTERP:
+        ret = MOTOR_set_mode(&SCA[i], MOTOR_POSITION_VELOCITY_MODE);
+        if (ret == 0)
+            INTERP_reset(&Ctrl_interp[i], t_us, SCA[i].pid_pos.fbk);
+        break;
+    case CTRL_SRC_TRAJ:
+        /* The generator holds the joint where it stands until a target comes */
+        ret = MOTOR_set_mode(&SCA[i], MOTOR_POSITION_VELOCITY_MODE);
+        if (ret == 0)
+            TRAJ_reset(&Ctrl_traj[i], SCA[i].pid_pos.fbk);
+        break;
+    case CTRL_SRC_LQR:
+        /* The state feedback starts holding the present current, the generator where it stands */
+        ret = LQR_start(&Ctrl_lqr[i], &SCA[i]);
+        if (ret == 0)
+            TRAJ_reset(&Ctrl_traj[i], SCA[i].pid_pos.fbk);
+        break;
+    case CTRL_SRC_TUNE:
+        /* The relay opens a loop of the MCU, so it cannot run while the loops are in the actuator */
+        AUTOTUNE_init(&Ctrl_tune[i], &SCA[i], Ctrl_tune_req[i].loop, 1.0f / CTRL_RATE_HZ);
+        ret = AUTOTUNE_start(&Ctrl_tune[i], Ctrl_tune_req[i].sp,
+                             (Ctrl_tune_req[i].loop == AUTOTUNE_VEL_LOOP) ? MOTOR_get_cmd(&SCA[i]) - SCA[i].pid_cur.ffd : 0.0f,
+                             Ctrl_tune_req[i].amp, Ctrl_tune_req[i].hyst, CTRL_TUNE_TIMEOUT_S);
+        if (ret == 0)
+            Ctrl_tune_ret[i] = Ctrl_src[i];
+        break;
+    default:
+        ret = MOTOR_set_mode(&SCA[i], MOTOR_VELOCITY_MODE);
+        break;
+    }
+
+    if (ret == 0)
+        Ctrl_src[i] = src;
+    else
+        Ctrl_src_req[i] = Ctrl_src[i];
+}
+
+/* Give the joint the setpoint of its source for this cycle */
+static void ctrl_task_setpoint(int i, uint32_t t_us)
+{
+    ctrl_task_take_src(i, t_us);
+
+    switch (Ctrl_src[i])
+    {
+    case CTRL_SRC_INTERP:
+        INTERP_calc(&Ctrl_interp[i], t_us);
+        MOTOR_pos_vel_mode(&SCA[i], INTERP_get_pos(&Ctrl_interp[i]), INTERP_get_vel(&Ctrl_interp[i]) * SCA_POS_VEL_SCALE);
+        break;
+    case CTRL_SRC_TRAJ:
+        TRAJ_calc(&Ctrl_traj[i]);
+        TRAJ_to_motor(&Ctrl_traj[i], &SCA[i]);
+        break;
+    case CTRL_SRC_LQR:
+        /* The output is calculated by LQR_calc_batch() after the setpoints of all joints */
+        TRAJ_calc(&Ctrl_traj[i]);
+        LQR_set_ref(&Ctrl_lqr[i], TRAJ_get_pos(&Ctrl_traj[i]), TRAJ_get_vel(&Ctrl_traj[i]), TRAJ_get_ffd(&Ctrl_traj[i]));
+        break;
+    case CTRL_SRC_TUNE:
+        /* The autotuner gives the setpoint, and restores the mode at the end. The state feedback
+           is restarted in the same cycle, since LQR_calc_batch() runs the joint as soon as it is
+           back in its mode. */
+        if (AUTOTUNE_calc(&Ctrl_tune[i]) != AUTOTUNE_RELAY_STATE)
+        {
+            Ctrl_src_req[i] = Ctrl_tune_ret[i];
+            if (Ctrl_tune_ret[i] == CTRL_SRC_LQR)
+                LQR_start(&Ctrl_lqr[i], &SCA[i]);
+        }
+        break;
+    default:
+        MOTOR_vel_mode(&SCA[i], 100.0f);
+        break;
+    }
+}
+
 /**
 	* @Function:	Get motor data, calculate PID output, send control data
 	* @Parameter:	none
 	* @Return:		none
-	* @Attention:	Because the communication with the motor usually takes a lot of time,
-                    so it is better to add the task scheduling function or real-time system 
-                    for the MCU.
+	* @Attention:	The feedback of all joints is read first, see ctrl_task_set_sched(), then
+                    the commands are calculated and sent.
 */
 void ctrl_task(void)
 {
-    static ActrParaTypedef *pActrParaDev = NULL;
+    uint32_t t_us;
+
+    /* After the watchdog tripped, the actuators stay at zero current until the reset */
+    if (WDG_tripped())
+        return;
+
+    PROF_START(prof_ctrl);
+
+    MOTOR_sync_param(SCA, ACTR_DEV_NUM);
+
+    if (Ctrl_sched == CTRL_SCHED_EVENT)
+        ctrl_task_fbk_event();
+    else
+        ctrl_task_fbk_periodic();
+
+    /* The observer sees the current of the tick just measured, before the feedforward of this
+       cycle replaces the model part of it */
+    DOB_calc_batch(Ctrl_dob, SCA, ACTR_DEV_NUM);
+
+    /* The identification takes the current of the tick just measured, like the observer,
+       at the feedback of the cycle as long as the velocity stays about constant */
+    for (int i = 0; i < ACTR_DEV_NUM; i++)
+    {
+        Ctrl_ffd_ang[i] = SCA[i].pid_pos.fbk * SCA_POS_TO_RAD;
+        if (Ctrl_ffd_id_on[i] && !SCA_stale[i] && MOTOR_get_exec(&SCA[i]) == MOTOR_EXEC_LOCAL &&
+            SCA[i].pid_vel.fbk - Ctrl_ffd_id_vel[i] < CTRL_FFD_ID_DVEL && Ctrl_ffd_id_vel[i] - SCA[i].pid_vel.fbk < CTRL_FFD_ID_DVEL)
+            FFD_ident_add(&Ctrl_ffd_id[i], SCA[i].pid_vel.fbk, Ctrl_ffd_ang[i], MOTOR_get_cmd(&SCA[i]));
+        Ctrl_ffd_id_vel[i] = SCA[i].pid_vel.fbk;
+    }
+
+    /* The feedforward goes to the current loops before the setpoints, so a mode change
+       of this cycle takes it over bumplessly */
+    FFD_calc_batch(Ctrl_ffd, SCA, Ctrl_ffd_ang, ACTR_DEV_NUM);
+
+    t_us = (uint32_t)TB_to_us(TB_now());
+    TELEM_begin(t_us);
+
+    for (int i = 0; i < ACTR_DEV_NUM; i++)
+    {
+        ctrl_task_setpoint(i, t_us);
+        /* Gain schedules of the GAIN command, by the speed of the joint */
+        MOTOR_set_sched_var(&SCA[i], (SCA[i].pid_vel.fbk < 0.0f ? -SCA[i].pid_vel.fbk : SCA[i].pid_vel.fbk) / SCA_VEL_SCALE);
+    }
+    /* The joints of the state feedback source get their current command, the others are skipped */
+    LQR_calc_batch(Ctrl_lqr, SCA, ACTR_DEV_NUM);
 
     for (int i = 0; i < ACTR_DEV_NUM; i++)
+    {
+        PROF_START(prof_motor);
+        MOTOR_calc(&SCA[i]);
+        PROF_STOP(prof_motor);
+
+        switch (MOTOR_get_exec(&SCA[i]))
+        {
+        case MOTOR_EXEC_ACTR_VEL:
+            SetActrSpeed(MOTOR_get_exec_cmd(&SCA[i]) / SCA_VEL_SCALE, devIDList[i]);
+            break;
+        case MOTOR_EXEC_ACTR_POS:
+            SetActrPosition(MOTOR_get_exec_cmd(&SCA[i]), devIDList[i]);
+            break;
+        default:
+            SetActrCurrent(MOTOR_get_cmd(&SCA[i]) / SCA_CUR_SCALE, devIDList[i]);
+            break;
+        }
+        TELEM_add(&SCA[i], FindActrDevByID(devIDList[i]), SCA_stale[i]);
+    }
+    TELEM_end();
+    TELEM_sample(t_us);
+
+    if (Ctrl_sched == CTRL_SCHED_EVENT)
+        ctrl_stat_add(&Ctrl_stat.act_min, &Ctrl_stat.act_max, &Ctrl_stat.act_sum, TB_elapsed_us(Ctrl_t_fbk));
+
+    PROF_STOP(prof_ctrl);
+    WDG_cycle_done();
+}
+
+/**
+	* @Function:	Read the feedback of the joints one by one
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	Each reply is waited for before the next request is sent.
+*/
+void ctrl_task_fbk_periodic(void)
+{
+    ActrParaTypedef *pActrParaDev;
+
+    for (int i = 0; i < ACTR_DEV_NUM; i++)
+    {
+        if (!MOTOR_fbk_due(&SCA[i]))
+            continue;
+
         pActrParaDev = FindActrDevByID(devIDList[i]);
+        SCA_stale[i] = (GetActrPara(ACTR_CMD_GET_POSTION, devIDList[i]) != GET_PARA_SUCCESS);
+        SCA_stale[i] |= (GetActrPara(ACTR_CMD_GET_SPEED, devIDList[i]) != GET_PARA_SUCCESS);
+
+        MOTOR_set_fbk(&SCA[i], 0.0f, pActrParaDev->actrSpeed * SCA_VEL_SCALE, pActrParaDev->actrPostion);
+    }
+}
 
+/**
+	* @Function:	Read the feedback of the joints at once
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	The requests of all joints go out back to back, and it returns as soon as the
+                    last reply is parsed, or after CTRL_FBK_DEADLINE_US. A joint whose replies
+                    did not all come is flagged in SCA_stale and keeps its last feedback.
+*/
+void ctrl_task_fbk_event(void)
+{
+    ActrParaTypedef *pActrParaDev;
+    unsigned char due[ACTR_DEV_NUM];
+    TB_Time_t now = TB_now();
+    int missing;
+
+    if (Ctrl_stat.cycles > 0)
+        ctrl_stat_add(&Ctrl_stat.per_min, &Ctrl_stat.per_max, &Ctrl_stat.per_sum, TB_elapsed_us(Ctrl_t_start));
+    Ctrl_t_start = now;
+
+    ActrCancelRequests();
     for (int i = 0; i < ACTR_DEV_NUM; i++)
     {
-        MOTOR_vel_mode(&SCA[i], 100.0f);
+        due[i] = MOTOR_fbk_due(&SCA[i]);
+        if (due[i])
+        {
+            ActrRequest(ACTR_CMD_GET_POSTION, devIDList[i]);
+            ActrRequest(ACTR_CMD_GET_SPEED, devIDList[i]);
+        }
+    }
 
-        GetActrPara(ACTR_CMD_GET_POSTION, devIDList[i]);
-        GetActrPara(ACTR_CMD_GET_SPEED, devIDList[i]);
+    missing = ActrWaitReplies(CTRL_FBK_DEADLINE_US);
+    Ctrl_t_fbk = TB_now();
 
-        MOTOR_set_fbk(&SCA[i], 0.0f, pActrParaDev->actrSpeed * 68.0f * 64.0f, pActrParaDev->actrPostion);
+    for (int i = 0; i < ACTR_DEV_NUM; i++)
+    {
+        if (!due[i])
+            continue;
 
-        MOTOR_calc(&SCA[i]);
+        pActrParaDev = FindActrDevByID(devIDList[i]);
+        SCA_stale[i] = (pActrParaDev->actrReqMask != 0);
+        if (SCA_stale[i])
+        {
+            LOG2("joint %u stale, replies missing %x", i, pActrParaDev->actrReqMask);
+            Ctrl_stat.stale++;
+            continue;
+        }
+        MOTOR_set_fbk(&SCA[i], 0.0f, pActrParaDev->actrSpeed * SCA_VEL_SCALE, pActrParaDev->actrPostion);
+    }
+    ActrCancelRequests();
+
+    Ctrl_stat.cycles++;
+    Ctrl_stat.late += (missing > 0);
+    ctrl_stat_add(&Ctrl_stat.fbk_min, &Ctrl_stat.fbk_max, &Ctrl_stat.fbk_sum, (unsigned int)TB_to_us(Ctrl_t_fbk - now));
+}
+
+/**
+	* @Function:	Choose how the control cycle gets the feedback
+	* @Parameter:	- sched:	CTRL_SCHED_PERIODIC or CTRL_SCHED_EVENT
+	* @Return:		none
+	* @Attention:	Call it between two cycles. The statistics are cleared.
+*/
+void ctrl_task_set_sched(CTRL_Sched_t sched)
+{
+    Ctrl_sched = sched;
+    ctrl_task_clr_stat();
+}
+
+/**
+	* @Function:	Get the statistics of the event-driven cycle
+	* @Parameter:	- *stat:	statistics copied out
+	* @Return:		none
+	* @Attention:	The means are sum / cycles, the period has one sample less.
+*/
+void ctrl_task_get_stat(CTRL_Stat_t *stat)
+{
+    *stat = Ctrl_stat;
+}
+
+/**
+	* @Function:	Clear the statistics of the event-driven cycle
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	none
+*/
+void ctrl_task_clr_stat(void)
+{
+    CTRL_Stat_t zero = {0};
+
+    Ctrl_stat = zero;
+    Ctrl_stat.per_min = 0xFFFFFFFF;
+    Ctrl_stat.fbk_min = 0xFFFFFFFF;
+    Ctrl_stat.act_min = 0xFFFFFFFF;
+}
+
+/**
+	* @Function:	Send telemetry to the serial port
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	The joint frames and the channels are sent by the control cycle,
+                    this task runs the commands and sends the text and the log.
+*/
+void telem_task(void)
+{
+    char line[USART_REC_LEN + 1];
+    int len;
+
+    if (USART_RX_STA & 0x8000)
+    {
+        len = USART_RX_STA & 0x3FFF;
+        memcpy(line, USART_RX_BUF, len);
+        line[len] = 0;
+        USART_RX_STA = 0;
+        telem_task_cmd(line);
+    }
 
-        SetActrCurrent(MOTOR_get_cmd(&SCA[i]) / 33.0f, devIDList[i]);
-        //printf("DEBUG3:CUR:%.3fA\r\n", MOTOR_get_cmd(&SCA[i]));
-        //delay_ms(1);
-
-        //printf("CUR-PID:\r\n");
-        //printf("K:%.2f %.2f %.2f\r\n", SCA[0].pid_cur.kp, SCA[0].pid_cur.ki, SCA[0].pid_cur.kd);
-        //printf("in:%.2f fbk:%.2f ffd:%.2f\r\n", SCA[0].pid_cur.in, SCA[0].pid_cur.fbk, SCA[0].pid_cur.ffd);
-        //printf("out:%.2f %.2f\r\n", SCA[0].pid_cur.out[0], SCA[0].pid_cur.out[1]);
-        //printf("err:%.2f %.2f %.2f\r\n", SCA[0].pid_cur.err[0], SCA[0].pid_cur.err[1], SCA[0].pid_cur.err[2]);
-        //printf("max:%.2f min:%.2f err_sum:%.2f\r\n", SCA[0].pid_cur.max, SCA[0].pid_cur.min, SCA[0].pid_cur.err_sum);
-        //printf("VEL-PID:\r\n");
-        //printf("K:%.2f %.2f %.2f\r\n", SCA[0].pid_vel.kp, SCA[0].pid_vel.ki, SCA[0].pid_vel.kd);
-        printf("T:%f\r\n", Time_s + Time_ms / 1000.0f);
-        //printf("in:%.2f fbk:%.2f ffd:%.2f\r\n", SCA[0].pid_vel.in, SCA[0].pid_vel.fbk, SCA[0].pid_vel.ffd);
-        printf("out:%.2f %.2f\r\n", SCA[0].pid_vel.out[0], SCA[0].pid_vel.out[1]);
-        //printf("err:%.2f %.2f %.2f\r\n", SCA[0].pid_vel.err[0], SCA[0].pid_vel.err[1], SCA[0].pid_vel.err[2]);
-        //printf("max:%.2f min:%.2f err_sum:%.2f\r\n", SCA[0].pid_vel.max, SCA[0].pid_vel.min, SCA[0].pid_vel.err_sum);
-        //printf("POS-PID:\r\n");
-        //printf("K:%.2f %.2f %.2f\r\n", SCA[0].pid_pos.kp, SCA[0].pid_pos.ki, SCA[0].pid_pos.kd);
-        //printf("in:%.2f fbk:%.2f ffd:%.2f\r\n", SCA[0].pid_pos.in, SCA[0].pid_pos.fbk, SCA[0].pid_pos.ffd);
-        //printf("out:%.2f %.2f\r\n", SCA[0].pid_pos.out[0], SCA[0].pid_pos.out[1]);
-        //printf("err:%.2f %.2f %.2f\r\n", SCA[0].pid_pos.err[0], SCA[0].pid_pos.err[1], SCA[0].pid_pos.err[2]);
-        //printf("max:%.2f min:%.2f err_sum:%.2f\r\n", SCA[0].pid_pos.max, SCA[0].pid_pos.min, SCA[0].pid_pos.err_sum);
+    TELEM_page_run();
+    log_drain(TELEM_send);
+}
+
+/* Long answers, printed a line at a time by TELEM_page_run() */
+static int telem_task_prof_line(int line)
+{
+    return prof_print_line(line);
+}
+
+static int telem_task_sched_line(int line)
+{
+    return SCHED_print_line(&Sched, line);
+}
+
+/**
+	* @Function:	Run a command received on the serial port
+	* @Parameter:	- line:	command without the line end
+	* @Return:		none
+	* @Attention:	The telemetry commands are listed at TELEM_cmd(), besides them
+                    PROF					print the profiler
+                    PROF CLR				clear the profiler
+                    SCHED					print the statistics of the scheduler
+                    SRC joint DEMO|INTERP|TRAJ|LQR	select the source of the setpoints of a joint
+                    WP joint t_us pos		push a waypoint, t_us in the time of the telemetry
+                    TRAJ joint [pos [vmax amax jmax]]	print the generator, or move it to pos, for
+                                                    the sources TRAJ and LQR
+                    TUNE ...				run the autotuner, see telem_task_tune()
+                    GAIN ...				print or schedule the gains of a loop, see telem_task_gain()
+                    FFD joint [kc kv kgc kgs]	print or set the feedforward of a joint, see FFD_init()
+                    FFD joint ID|SOLVE		identify the feedforward while the joint is swept, see
+                                            ctrl_task_ffd_ident()
+                    DOB joint [J b on off]	print or set the disturbance observer of a joint, see DOB_init()
+                    WP only answers if the waypoint is discarded, so a stream of them does not
+                    fill the link. PROF and SCHED print as the serial port drains, see TELEM_page().
+*/
+void telem_task_cmd(char *line)
+{
+    unsigned int idx, t_us;
+    char arg[8];
+    float pos, vmax, amax, jmax, kc, kv, kgc, kgs, th_on, th_off;
+    int n;
+
+    if (TELEM_cmd(line))
+        return;
+
+    if (sscanf(line, "SRC %u %7s", &idx, arg) == 2)
+    {
+        if (ctrl_task_set_src(idx, (strcmp(arg, "INTERP") == 0) ? CTRL_SRC_INTERP : (strcmp(arg, "TRAJ") == 0) ? CTRL_SRC_TRAJ :
+                                   (strcmp(arg, "LQR") == 0) ? CTRL_SRC_LQR : (strcmp(arg, "DEMO") == 0) ? CTRL_SRC_DEMO : CTRL_SRC_NUM) == 0)
+            printf("OK SRC %u %s\r\n", idx, arg);
+        else
+            printf("ERR SRC\r\n");
+    }
+    else if (strncmp(line, "TUNE ", 5) == 0)
+    {
+        telem_task_tune(line + 5);
+    }
+    else if (strncmp(line, "GAIN ", 5) == 0)
+    {
+        telem_task_gain(line + 5);
+    }
+    else if (sscanf(line, "WP %u %u %f", &idx, &t_us, &pos) == 3)
+    {
+        if (ctrl_task_push_wp(idx, t_us, pos) != 0)
+            printf("ERR WP %u\r\n", t_us);
+    }
+    else if ((n = sscanf(line, "TRAJ %u %f %f %f %f", &idx, &pos, &vmax, &amax, &jmax)) == 1 || n == 2 || n == 5)
+    {
+        if (n == 1)
+        {
+            if (idx >= ACTR_DEV_NUM)
+                printf("ERR TRAJ\r\n");
+            else
+                printf("TRAJ %u tgt %g pos %g vel %g acc %g vmax %g amax %g jmax %g %s\r\n", idx,
+                       Ctrl_traj[idx].tgt, Ctrl_traj[idx].pos, Ctrl_traj[idx].vel, Ctrl_traj[idx].acc,
+                       Ctrl_traj[idx].vmax, Ctrl_traj[idx].amax, Ctrl_traj[idx].jmax, TRAJ_is_done(&Ctrl_traj[idx]) ? "DONE" : "MOVING");
+        }
+        else if (ctrl_task_set_traj(idx, pos, (n == 5) ? vmax : 0.0f, (n == 5) ? amax : 0.0f, (n == 5) ? jmax : 0.0f) == 0)
+            printf("OK TRAJ %u %g\r\n", idx, pos);
+        else
+            printf("ERR TRAJ %u not in TRAJ or LQR or bad limits\r\n", idx);
+    }
+    else if (sscanf(line, "FFD %u %7s", &idx, arg) == 2 && (strcmp(arg, "ID") == 0 || strcmp(arg, "SOLVE") == 0))
+    {
+        n = (idx < ACTR_DEV_NUM) ? Ctrl_ffd_id[idx].num : 0;
+        if (ctrl_task_ffd_ident(idx, arg[0] == 'I') != 0)
+            printf("ERR FFD %u %s\r\n", idx, arg);
+        else if (arg[0] == 'I')
+            printf("OK FFD %u ID\r\n", idx);
+        else
+            printf("OK FFD %u SOLVE %d samples kc %g kv %g kgc %g kgs %g\r\n", idx, n,
+                   Ctrl_ffd[idx].kc, Ctrl_ffd[idx].kv, Ctrl_ffd[idx].kgc, Ctrl_ffd[idx].kgs);
+    }
+    else if ((n = sscanf(line, "FFD %u %f %f %f %f", &idx, &kc, &kv, &kgc, &kgs)) == 1 || n == 5)
+    {
+        if ((n == 5) ? ctrl_task_set_ffd(idx, kc, kv, kgc, kgs) != 0 : idx >= ACTR_DEV_NUM)
+            printf("ERR FFD\r\n");
+        else
+            printf("%s FFD %u kc %g kv %g kgc %g kgs %g out %g\r\n", (n == 5) ? "OK" : "FFD", idx,
+                   Ctrl_ffd[idx].kc, Ctrl_ffd[idx].kv, Ctrl_ffd[idx].kgc, Ctrl_ffd[idx].kgs, FFD_get_out(&Ctrl_ffd[idx]));
+    }
+    else if ((n = sscanf(line, "DOB %u %f %f %f %f", &idx, &kc, &kv, &th_on, &th_off)) == 1 || n == 5)
+    {
+        if ((n == 5) ? ctrl_task_set_dob(idx, kc, kv, th_on, th_off) != 0 : idx >= ACTR_DEV_NUM)
+            printf("ERR DOB\r\n");
+        else
+            printf("%s DOB %u J %g b %g on %g off %g out %g contact %d\r\n", (n == 5) ? "OK" : "DOB", idx,
+                   Ctrl_dob[idx].inertia, Ctrl_dob[idx].damping, Ctrl_dob[idx].th_on, Ctrl_dob[idx].th_off,
+                   DOB_get_out(&Ctrl_dob[idx]), DOB_get_contact(&Ctrl_dob[idx]));
+    }
+    else if (strcmp(line, "PROF") == 0)
+    {
+        if (TELEM_page(telem_task_prof_line) != 0)
+            printf("ERR PROF busy\r\n");
+    }
+    else if (strcmp(line, "PROF CLR") == 0)
+    {
+        prof_clr();
+        printf("OK PROF CLR\r\n");
+    }
+    else if (strcmp(line, "SCHED") == 0)
+    {
+        if (TELEM_page(telem_task_sched_line) != 0)
+            printf("ERR SCHED busy\r\n");
+    }
+    else
+    {
+        printf("ERR %s, commands: LIST SUB UNSUB JOINT LOOP PROF SCHED SRC WP TRAJ TUNE GAIN FFD DOB\r\n", line);
     }
 }
 
+/**
+	* @Function:	Run a command of the autotuner
+	* @Parameter:	- args:	arguments after TUNE
+	* @Return:		none
+	* @Attention:	The commands are
+                    TUNE joint VEL|POS sp amp hyst	start a relay experiment of the velocity loop with
+                                                    a relay of amp current, or of the position loop
+                                                    with a relay of amp velocity, around sp
+                    TUNE joint STOP					abort the experiment
+                    TUNE joint						print the state and the result
+                    TUNE joint APPLY ZN_PI|ZN_PID|TL_PI|TL_PID	compute the gains and publish them
+                    The joint keeps its mode during the experiment and goes back to it and to its
+                    source at the end. Tune the velocity loop before the position loop.
+*/
+void telem_task_tune(char *args)
+{
+    static const char *const rules[] = {"ZN_PI", "ZN_PID", "TL_PI", "TL_PID"};
+    static const char *const states[] = {"IDLE", "RELAY", "DONE", "FAIL"};
+    AUTOTUNE_t *at;
+    unsigned int idx;
+    char arg[8];
+    float sp, amp, hyst;
+    int n, i;
+
+    n = sscanf(args, "%u %7s %f %f %f", &idx, arg, &sp, &amp, &hyst);
+    if (n < 1 || idx >= ACTR_DEV_NUM)
+    {
+        printf("ERR TUNE\r\n");
+        return;
+    }
+    at = &Ctrl_tune[idx];
+
+    if (n == 1)
+    {
+        printf("TUNE %u %s ku %g tu %g kp %g ki %g kd %g\r\n", idx, states[AUTOTUNE_get_state(at)],
+               at->ku, at->tu, at->kp, at->ki, at->kd);
+    }
+    else if (n == 5 && (strcmp(arg, "VEL") == 0 || strcmp(arg, "POS") == 0))
+    {
+        if (ctrl_task_tune(idx, (arg[0] == 'V') ? AUTOTUNE_VEL_LOOP : AUTOTUNE_POS_LOOP, sp, amp, hyst) == 0)
+            printf("OK TUNE %u %s\r\n", idx, arg);
+        else
+            printf("ERR TUNE %u busy or delegated\r\n", idx);
+    }
+    else if (n == 2 && strcmp(arg, "STOP") == 0)
+    {
+        if (Ctrl_src[idx] == CTRL_SRC_TUNE)
+            ctrl_task_set_src(idx, Ctrl_tune_ret[idx]);
+        else
+            ctrl_task_set_src(idx, Ctrl_src[idx]);
+        printf("OK TUNE %u STOP\r\n", idx);
+    }
+    else if (n >= 2 && strcmp(arg, "APPLY") == 0 && sscanf(args, "%*u %*s %7s", arg) == 1)
+    {
+        for (i = 0; i < 4 && strcmp(arg, rules[i]) != 0; i++)
+            ;
+        /* The gains must not be written while the last publication is pending */
+        if (i == 4 || PID_param_pending() || AUTOTUNE_apply(at, (AUTOTUNE_Rule_t)i) != 0)
+            printf("ERR TUNE %u APPLY\r\n", idx);
+        else
+            printf("OK TUNE %u APPLY kp %g ki %g kd %g\r\n", idx, at->kp, at->ki, at->kd);
+    }
+    else
+    {
+        printf("ERR TUNE\r\n");
+    }
+}
+
+/**
+	* @Function:	Run a command of the gain schedules
+	* @Parameter:	- args:	arguments after GAIN
+	* @Return:		none
+	* @Attention:	The commands are
+                    GAIN joint CUR|VEL|POS						print the published gains and the schedule
+                    GAIN joint CUR|VEL|POS x kp ki kd [x kp ki kd ...]	schedule the gains of the loop
+                                                                over |actrSpeed| in RPM, with up to
+                                                                CTRL_GAIN_SCHED_PTS breakpoints
+                    GAIN joint CUR|VEL|POS OFF					go back to the published gains
+                    While a schedule is set it gives the gains of the loop, the gains of
+                    TUNE APPLY are kept and apply again after OFF.
+*/
+void telem_task_gain(char *args)
+{
+    static const char *const loops[] = {"CUR", "VEL", "POS"};
+    float v[4 * CTRL_GAIN_SCHED_PTS], x[CTRL_GAIN_SCHED_PTS], kp[CTRL_GAIN_SCHED_PTS], ki[CTRL_GAIN_SCHED_PTS], kd[CTRL_GAIN_SCHED_PTS];
+    const PID_Param_t *p;
+    unsigned int idx;
+    char arg[4], off[4];
+    int n, i, loop;
+
+    n = sscanf(args, "%u %3s %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f", &idx, arg,
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7],
+               &v[8], &v[9], &v[10], &v[11], &v[12], &v[13], &v[14], &v[15]);
+    for (loop = 0; loop < CTRL_LOOP_NUM && n >= 2 && strcmp(arg, loops[loop]) != 0; loop++)
+        ;
+    if (n < 2 || idx >= ACTR_DEV_NUM || loop == CTRL_LOOP_NUM)
+    {
+        printf("ERR GAIN\r\n");
+        return;
+    }
+
+    if (n == 2 && sscanf(args, "%*u %*s %3s", off) == 1)
+    {
+        if (strcmp(off, "OFF") == 0 && ctrl_task_set_gain_sched(idx, (CTRL_Loop_t)loop, 0, 0, 0, 0, 0) == 0)
+            printf("OK GAIN %u %s OFF\r\n", idx, arg);
+        else
+            printf("ERR GAIN %u %s\r\n", idx, arg);
+    }
+    else if (n == 2)
+    {
+        p = (loop == CTRL_LOOP_CUR) ? SCA[idx].pid_cur.act : (loop == CTRL_LOOP_VEL) ? SCA[idx].pid_vel.act : SCA[idx].pid_pos.act;
+        printf("GAIN %u %s kp %g ki %g kd %g sched %d\r\n", idx, arg, p->kp, p->ki, p->kd, p->sched ? p->sched->num : 0);
+    }
+    else if ((n - 2) % 4 == 0)
+    {
+        for (i = 0; i < (n - 2) / 4; i++)
+        {
+            x[i] = v[4 * i];
+            kp[i] = v[4 * i + 1];
+            ki[i] = v[4 * i + 2];
+            kd[i] = v[4 * i + 3];
+        }
+        if (ctrl_task_set_gain_sched(idx, (CTRL_Loop_t)loop, x, kp, ki, kd, (n - 2) / 4) == 0)
+            printf("OK GAIN %u %s %d points\r\n", idx, arg, (n - 2) / 4);
+        else
+            printf("ERR GAIN %u %s pending or breakpoints not increasing\r\n", idx, arg);
+    }
+    else
+    {
+        printf("ERR GAIN\r\n");
+    }
+}
+
+/**
+	* @Function:	Poll the health of the control loop
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	LED0 blinks as heartbeat, LED1 is on while the control cycles overrun.
+                    The LEDs are left to the profiler when built with PROF_TRACE.
+*/
+void diag_task(void)
+{
+    static unsigned int overruns = 0;
+    TICK_Stat_t stat;
+
+    TICK_get_stat(&stat);
+
+#if !PROF_TRACE
+    LED0 = !LED0;
+    LED1 = (stat.overruns != overruns) ? 0 : 1;
+#endif
+    overruns = stat.overruns;
+}
+
+/**
+	* @Function:	Show the statistics of the tasks and the profiler on the LCD
+	* @Parameter:	none
+	* @Return:		none
+	* @Attention:	One line is drawn per run, so a run stays within the budget.
+                    The line of the event-driven cycle shows avg/max of the feedback and of the
+                    sense to actuate latency in us. The profiler lines show count, avg, max and
+                    WCET in us.
+*/
+void lcd_task(void)
+{
+    static int line = 0;
+    SCHED_Task_t *task;
+    TICK_Stat_t stat;
+    CTRL_Stat_t ctrl;
+    unsigned int n;
+    char buf[48];
+
+    if (line < Sched.num)
+    {
+        task = &Sched.task[line];
+        sprintf(buf, "%-6s n:%-8u avg:%-5u max:%-5u", task->name, task->cnt, task->cnt ? task->t_sum / task->cnt : 0, task->t_max);
+    }
+    else if (line == Sched.num)
+    {
+        TICK_get_stat(&stat);
+        sprintf(buf, "tick ovr:%-6u miss:%-6u lat:%-4u", stat.overruns, stat.missed, stat.lat_max);
+    }
+    else if (line == Sched.num + 1)
+    {
+        ctrl_task_get_stat(&ctrl);
+        n = ctrl.cycles ? ctrl.cycles : 1;
+        sprintf(buf, "fbk %4u/%-4u act %4u/%-4u st:%-5u", ctrl.fbk_sum / n, ctrl.fbk_max, ctrl.act_sum / n, ctrl.act_max, ctrl.stale);
+    }
+#if PROF_ENABLE
+    else
+    {
+        prof_format(prof_get(line - Sched.num - 2), buf);
+    }
+#endif
+    LCD_ShowString(10, 10 + 20 * line, 300, 16, 16, (u8 *)buf);
+
+    line = (line < Sched.num + 1 + prof_num()) ? line + 1 : 0;
+}
+
+/**
+	* @Function:	Moving the loops of a joint between the MCU and the actuator
+	* @Parameter:	- idx:		index of joint
+					- exec:		execution strategy
+					- fbk_div:	divider of the feedback rate while the loops are in the actuator
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		the mode of joint cannot be delegated like this, e.g. a position mode
+								over the velocity loop of the actuator with fbk_div above 1
+					- others:	error of SetActrMode()
+	* @Attention:	Call it between two ticks. When the loops come back, the present current of the
+                    actuator is read, so the current command continues from it.
+                    Delegated joints only need one setpoint frame per tick and a feedback read every
+                    fbk_div ticks, instead of three frames per tick.
+*/
+int ctrl_task_set_exec(int idx, MOTOR_Exec_t exec, int fbk_div)
+{
+    ActrParaTypedef *pActrParaDev = FindActrDevByID(devIDList[idx]);
+    ActrRunModeTypedef actrMode;
+    MOTOR_Exec_t old = MOTOR_get_exec(&SCA[idx]);
+    int old_div = SCA[idx].fbk_div;
+    int ret;
+
+    switch (exec)
+    {
+    case MOTOR_EXEC_ACTR_VEL:
+        actrMode = ACTR_MODE_SPD;
+        break;
+    case MOTOR_EXEC_ACTR_POS:
+        actrMode = ACTR_MODE_POS;
+        break;
+    default:
+        actrMode = ACTR_MODE_CUR;
+        GetActrPara(ACTR_CMD_GET_CURRENT, devIDList[idx]);
+        GetActrPara(ACTR_CMD_GET_POSTION, devIDList[idx]);
+        GetActrPara(ACTR_CMD_GET_SPEED, devIDList[idx]);
+        MOTOR_set_fbk(&SCA[idx], pActrParaDev->actrCurrent * SCA_CUR_SCALE, pActrParaDev->actrSpeed * SCA_VEL_SCALE, pActrParaDev->actrPostion);
+        break;
+    }
+
+    if (MOTOR_set_exec(&SCA[idx], exec, fbk_div) != 0)
+        return -1;
+
+    ret = SetActrMode(actrMode, devIDList[idx]);
+    if (ret != ACTR_SET_MODE_SUCCESS)
+    {
+        /* The actuator stays in its mode, so the loops stay where they are */
+        MOTOR_set_exec(&SCA[idx], old, old_div);
+        return ret;
+    }
+
+    /* The first setpoint in the new mode is sent right away, not at the next tick */
+    switch (exec)
+    {
+    case MOTOR_EXEC_ACTR_VEL:
+        SetActrSpeed(MOTOR_get_exec_cmd(&SCA[idx]) / SCA_VEL_SCALE, devIDList[idx]);
+        break;
+    case MOTOR_EXEC_ACTR_POS:
+        SetActrPosition(MOTOR_get_exec_cmd(&SCA[idx]), devIDList[idx]);
+        break;
+    default:
+        SetActrCurrent(MOTOR_get_cmd(&SCA[idx]) / SCA_CUR_SCALE, devIDList[idx]);
+        break;
+    }
+
+    return 0;
+}
+
+/**
+	* @Function:	Select the source of the setpoints of a joint
+	* @Parameter:	- idx:	index of joint
+					- src:	source of the setpoints
+	* @Return:		operation status
+					- 0:	operating successfully, the next cycle switches the joint
+					- -1:	the joint or the source is invalid
+	* @Attention:	May be called while the control cycle runs. The mode changes bumplessly, and
+                    the interpolator starts from the position the joint stands at. If the loops of
+                    the joint are in the actuator and cannot run the mode of the source, the cycle
+                    refuses it and the joint keeps its source.
+*/
+int ctrl_task_set_src(int idx, CTRL_Src_t src)
+{
+    if (idx < 0 || idx >= ACTR_DEV_NUM || src >= CTRL_SRC_NUM)
+        return -1;
+
+    Ctrl_src_req[idx] = src;
+    return 0;
+}
+
+/**
+	* @Function:	Push a waypoint of the host to the interpolator of a joint
+	* @Parameter:	- idx:		index of joint
+					- t_us:		time of the waypoint, in the clock of TELEM_begin()
+					- pos:		position of the waypoint
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		the joint is invalid or the waypoint is discarded, see INTERP_push()
+	* @Attention:	May be called while the control cycle runs, the cycle is held off meanwhile.
+                    The waypoints are only used while the source of the joint is CTRL_SRC_INTERP.
+*/
+int ctrl_task_push_wp(int idx, uint32_t t_us, float pos)
+{
+    u32 primask;
+    int ret;
+
+    if (idx < 0 || idx >= ACTR_DEV_NUM || Ctrl_src[idx] != CTRL_SRC_INTERP)
+        return -1;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    ret = INTERP_push(&Ctrl_interp[idx], t_us, pos);
+    __set_PRIMASK(primask);
+
+    return ret;
+}
+
+/**
+	* @Function:	Move the trajectory generator of a joint to a target
+	* @Parameter:	- idx:		index of joint
+					- tgt:		target position
+					- vmax:		maxinum velocity, 0 to keep the limits
+					- amax:		maxinum acceleration
+					- jmax:		maxinum jerk
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		the joint is invalid, its source is not CTRL_SRC_TRAJ or CTRL_SRC_LQR,
+								or a limit is negative
+	* @Attention:	May be called while the control cycle runs, the cycle is held off meanwhile.
+                    The target may change in the middle of a motion, see TRAJ_set_target().
+                    With CTRL_SRC_LQR the state feedback follows the trajectory instead of the loops.
+*/
+int ctrl_task_set_traj(int idx, float tgt, float vmax, float amax, float jmax)
+{
+    u32 primask;
+
+    if (idx < 0 || idx >= ACTR_DEV_NUM || (Ctrl_src[idx] != CTRL_SRC_TRAJ && Ctrl_src[idx] != CTRL_SRC_LQR))
+        return -1;
+    if (vmax != 0.0f && !(vmax > 0.0f && amax > 0.0f && jmax > 0.0f))
+        return -1;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (vmax != 0.0f)
+        TRAJ_set_limit(&Ctrl_traj[idx], vmax, amax, jmax);
+    TRAJ_set_target(&Ctrl_traj[idx], tgt);
+    __set_PRIMASK(primask);
+
+    return 0;
+}
+
+/**
+	* @Function:	Request a relay experiment of the autotuner on a joint
+	* @Parameter:	- idx:	index of joint
+					- loop:	loop to be tuned
+					- sp:	setpoint of the loop, around which the joint oscillates
+					- amp:	amplitude of the relay
+					- hyst:	hysteresis of the relay
+	* @Return:		operation status
+					- 0:	operating successfully, the next cycle starts the experiment
+					- -1:	the joint is invalid, already tuning, or its loops are in the actuator
+	* @Attention:	May be called while the control cycle runs. The relay of the velocity loop is
+                    centered at the present current command.
+*/
+int ctrl_task_tune(int idx, AUTOTUNE_Loop_t loop, float sp, float amp, float hyst)
+{
+    if (idx < 0 || idx >= ACTR_DEV_NUM || Ctrl_src[idx] == CTRL_SRC_TUNE || Ctrl_src_req[idx] == CTRL_SRC_TUNE ||
+        MOTOR_get_exec(&SCA[idx]) != MOTOR_EXEC_LOCAL)
+        return -1;
+
+    Ctrl_tune_req[idx].loop = loop;
+    Ctrl_tune_req[idx].sp = sp;
+    Ctrl_tune_req[idx].amp = amp;
+    Ctrl_tune_req[idx].hyst = hyst;
+    Ctrl_src_req[idx] = CTRL_SRC_TUNE;
+
+    return 0;
+}
+
+/**
+	* @Function:	Set or remove the gain schedule of a loop of a joint
+	* @Parameter:	- idx:	index of joint
+					- loop:	loop of the joint
+					- *x:	breakpoints of |actrSpeed| in RPM in increasing order
+					- *kp:	gain values of P controller at the breakpoints
+					- *ki:	gain values of I controller at the breakpoints
+					- *kd:	gain values of D controller at the breakpoints
+					- num:	number of breakpoints, 0 to remove the schedule
+	* @Return:		operation status
+					- 0:	operating successfully, the next cycle takes the schedule
+					- -1:	the joint or the breakpoints are invalid, or a publication is pending
+	* @Attention:	Call it from the context of the commands. The schedule is published with
+                    PID_publish() like the gains, into the table of the loop which the cycle does
+                    not use, so it is never written while it is read.
+*/
+int ctrl_task_set_gain_sched(int idx, CTRL_Loop_t loop, const float *x, const float *kp, const float *ki, const float *kd, int num)
+{
+    PID_Sched_t *sched = 0;
+    PID_t *pid;
+
+    if (idx < 0 || idx >= ACTR_DEV_NUM || loop >= CTRL_LOOP_NUM || num < 0 || num > CTRL_GAIN_SCHED_PTS || PID_param_pending())
+        return -1;
+
+    pid = (loop == CTRL_LOOP_CUR) ? &SCA[idx].pid_cur : (loop == CTRL_LOOP_VEL) ? &SCA[idx].pid_vel : &SCA[idx].pid_pos;
+    if (num > 0)
+    {
+        sched = &Ctrl_gain_sched[idx][loop][pid->act->sched == &Ctrl_gain_sched[idx][loop][0]];
+        if (PID_sched_init(sched, x, kp, ki, kd, num) != 0)
+            return -1;
+    }
+
+    switch (loop)
+    {
+    case CTRL_LOOP_CUR:
+        MOTOR_set_cur_loop_sched(&SCA[idx], sched);
+        break;
+    case CTRL_LOOP_VEL:
+        MOTOR_set_vel_loop_sched(&SCA[idx], sched);
+        break;
+    default:
+        MOTOR_set_pos_loop_sched(&SCA[idx], sched);
+        break;
+    }
+    PID_publish();
+
+    return 0;
+}
+
+/**
+	* @Function:	Set the friction and gravity feedforward of a joint
+	* @Parameter:	- idx:	index of joint
+					- kc:	Coulomb friction
+					- kv:	viscous friction per unit of velocity of the velocity loop
+					- kgc:	gravity coefficient of cos(ang)
+					- kgs:	gravity coefficient of sin(ang)
+	* @Return:		operation status
+					- 0:	operating successfully
+					- -1:	the joint is invalid
+	* @Attention:	May be called while the control cycle runs, the cycle is held off meanwhile.
+                    The coefficients are in the current of the controller, ang is the position of the
+                    joint in radian, e.g. from ctrl_task_ffd_ident() on slow sweeps.
+*/
+int ctrl_task_set_ffd(int idx, float kc, float kv, float kgc, float kgs)
+{
+    u32 primask;
+
+    if (idx < 0 || idx >= ACTR_DEV_NUM)
+        return -1;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    FFD_init(&Ctrl_ffd[idx], kc, kv, kgc, kgs, CTRL_FFD_VEL_EPS);
+    __set_PRIMASK(primask);
+
+    return 0;
+}
+
+/**
+	* @Function:	Start or solve the identification of the feedforward of a joint
+	* @Parameter:	- idx:	index of joint
+					- on:	1 to start taking samples from the cycles, 0 to stop and solve
+	* @Return:		operation status
+					- 0:	operating successfully
+					- -1:	the joint is invalid, or the samples do not determine the model, which
+							then stays as it is
+	* @Attention:	Call it from the context of the commands. Between the start and the solve, sweep
+                    the joint slowly at several constant velocities in both directions over its range,
+                    e.g. with SRC TRAJ. A cycle is taken while the loops are in the MCU and the velocity
+                    changed less than CTRL_FFD_ID_DVEL, with the current command of the cycle before,
+                    so the feedforward set before is part of the current identified. A solved model
+                    is set by ctrl_task_set_ffd().
+*/
+int ctrl_task_ffd_ident(int idx, int on)
+{
+    FFD_t ffd;
+
+    if (idx < 0 || idx >= ACTR_DEV_NUM)
+        return -1;
+
+    if (on)
+    {
+        Ctrl_ffd_id_on[idx] = 0;
+        FFD_ident_init(&Ctrl_ffd_id[idx], CTRL_FFD_VEL_EPS);
+        Ctrl_ffd_id_on[idx] = 1;
+        return 0;
+    }
+
+    /* The cycle preempts the commands, it takes no sample once the flag is clear */
+    Ctrl_ffd_id_on[idx] = 0;
+    if (FFD_ident_solve(&Ctrl_ffd_id[idx], &ffd) != 0)
+        return -1;
+
+    return ctrl_task_set_ffd(idx, ffd.kc, ffd.kv, ffd.kgc, ffd.kgs);
+}
+
+/**
+	* @Function:	Set the model and the contact thresholds of the disturbance observer of a joint
+	* @Parameter:	- idx:		index of joint
+					- inertia:	current per unit of velocity of the velocity loop per second
+					- damping:	current per unit of velocity of the velocity loop
+					- th_on:	estimate above which the joint is in contact, 0 to disable
+					- th_off:	estimate below which the contact ends
+	* @Return:		operation status
+					- 0:		operating successfully
+					- -1:		the joint is invalid
+	* @Attention:	May be called while the control cycle runs, the cycle is held off meanwhile.
+                    The estimate restarts from zero. Its sign is the one of the current balancing
+                    the external torque, it is published as the channel jN.dob. With inertia and
+                    damping both 0 the observer is off and jN.dob stays 0.
+*/
+int ctrl_task_set_dob(int idx, float inertia, float damping, float th_on, float th_off)
+{
+    u32 primask;
+
+    if (idx < 0 || idx >= ACTR_DEV_NUM)
+        return -1;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    DOB_init(&Ctrl_dob[idx], inertia, damping, CTRL_DOB_BW, 1.0f / CTRL_RATE_HZ);
+    DOB_set_contact_th(&Ctrl_dob[idx], th_on, th_off);
+    DOB_reset(&Ctrl_dob[idx], SCA[idx].pid_vel.fbk);
+    __set_PRIMASK(primask);
+
+    return 0;
+}
+
 /**
 	* @Function:	Background tasks
 	* @Parameter:	none
 	* @Return:		none
 	* @Attention:	Background task is the while loop in main.c
+                    Each control cycle starts at a tick of TIM3, see TICK_wait() for the policy
+                    when a cycle takes longer than the tick. The control task runs first in
+                    every cycle, the other tasks only in the time left before the next tick.
 */
 void loop_task(void)
 {
+#if OS_PREEMPTIVE
+    os_start();
+#else
+    TICK_set_policy(TICK_SKIP);
+
     while (1)
     {
+        TICK_wait();
+        SCHED_run(&Sched, TICK_get_next());
+    }
+#endif
+}
+
+/**
+	* @Function:	Control task of the kernel build, at the highest priority
+	* @Parameter:	- *arg:	unused
+	* @Return:		none
+	* @Attention:	It sleeps until the tick of TIM3 and while waiting for CAN replies, which
+                    gives the CPU to the lower tasks.
+*/
+void rtos_ctrl_task(void *arg)
+{
+    init_task_innfos();
+
+    TIM3_Init(CTRL_RATE_HZ);
+    TICK_set_policy(TICK_SKIP);
+    WDG_Init(ActrSafeStop);
+    WDG_print();
+
+    while (1)
+    {
+        TICK_wait();
         ctrl_task();
     }
 }
+
+/**
+	* @Function:	CAN receive task of the kernel build
+	* @Parameter:	- *arg:	unused
+	* @Return:		none
+	* @Attention:	The interrupt only queues the frames, they are parsed here, and the task
+                    waiting for a reply is woken up by the semaphore of its actuator.
+*/
+void rtos_can_rx_task(void *arg)
+{
+    while (1)
+    {
+        CanRxWait(OS_WAIT_FOREVER);
+        CanRxProcess();
+    }
+}
+
+/**
+	* @Function:	Telemetry task of the kernel build
+	* @Parameter:	- *arg:	unused
+	* @Return:		none
+	* @Attention:	none
+*/
+void rtos_telem_task(void *arg)
+{
+    while (1)
+    {
+        os_delay_us(TELEM_PERIOD_US);
+        telem_task();
+    }
+}
+
+/**
+	* @Function:	Task of the LEDs and the LCD of the kernel build, at the lowest priority
+	* @Parameter:	- *arg:	unused
+	* @Return:		none
+	* @Attention:	There is no cooperative scheduler in the kernel build, so the LCD only shows
+                    the statistics of the tick.
+*/
+void rtos_ui_task(void *arg)
+{
+    int cnt = 0;
+
+    while (1)
+    {
+        os_delay_us(DIAG_PERIOD_US);
+        diag_task();
+
+        if (++cnt >= LCD_PERIOD_US / DIAG_PERIOD_US)
+        {
+            cnt = 0;
+            lcd_task();
+        }
+    }
+}
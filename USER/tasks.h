@@ -9,13 +9,172 @@
 #include "lcd.h"
 #include "can.h"
 #include "timer.h"
+#include "timebase.h"
+#include "timeout.h"
+#include "wdg.h"
+#include "telem.h"
 #include "SCA_ctrl.h"
+#include "sched.h"
+#include "os_port.h"
+#include "prof.h"
+#include "log.h"
+#include "interp.h"
+#include "traj.h"
+#include "lqr.h"
+#include "autotune.h"
+#include "ffd.h"
+#include "dob.h"
+
+/* Rate of the control tick in Hz */
+#define CTRL_RATE_HZ 1000
+
+/* Period and budget of the background tasks in us */
+#define TELEM_PERIOD_US 5000
+#define TELEM_BUDGET_US 1500
+#define DIAG_PERIOD_US 50000
+#define DIAG_BUDGET_US 100
+#define LCD_PERIOD_US 100000
+#define LCD_BUDGET_US 1000
+
+/* Priorities and stack sizes in words of the kernel tasks, 0 is the highest priority */
+#define CTRL_TASK_PRIO 4
+#define CAN_RX_TASK_PRIO 5
+#define TELEM_TASK_PRIO 6
+#define UI_TASK_PRIO 7
+#define CTRL_STK_SIZE 512
+#define CAN_RX_STK_SIZE 256
+#define TELEM_STK_SIZE 512
+#define UI_STK_SIZE 256
+
+/* Time the event-driven cycle waits for the feedback before it goes on with stale joints, in us */
+#define CTRL_FBK_DEADLINE_US 600
+
+/* Current command per unit of SetActrCurrent() */
+#define SCA_CUR_SCALE 33.0f
+/* Velocity of the controller per unit of actrSpeed and SetActrSpeed() */
+#define SCA_VEL_SCALE (68.0f * 64.0f)
+/* Velocity of the controller per R/s of a position reference, actrSpeed is in RPM */
+#define SCA_POS_VEL_SCALE (SCA_VEL_SCALE * 60.0f)
+/* Angle in radian per unit of actrPostion, which is in R */
+#define SCA_POS_TO_RAD 6.2831853f
+/* Breakpoints of a gain schedule set by the GAIN command, the scheduling variable is |actrSpeed| in RPM */
+#define CTRL_GAIN_SCHED_PTS 4
+/* Velocity band where the Coulomb friction of the feedforward changes its sign, 1 RPM */
+#define CTRL_FFD_VEL_EPS (1.0f * SCA_VEL_SCALE)
+/* Change of velocity per cycle above which a sample is not taken by the identification of the
+   feedforward, which has no inertia, 0.5 RPM */
+#define CTRL_FFD_ID_DVEL (0.5f * SCA_VEL_SCALE)
+/* Bandwidth of the disturbance observer in rad/s */
+#define CTRL_DOB_BW 60.0f
+
+/* Time the waypoints of the host are extrapolated after the last one, in us */
+#define CTRL_INTERP_EXTRAP_US 20000
+/* Default limits of the trajectory generator, in R/s, R/s^2 and R/s^3 */
+#define CTRL_TRAJ_VMAX 0.5f
+#define CTRL_TRAJ_AMAX 5.0f
+#define CTRL_TRAJ_JMAX 100.0f
+/* Entry of LQR_gain_table of the joints, the bench joint, and the limit of its current */
+#define CTRL_LQR_GAIN 0
+#define CTRL_LQR_CUR_MAX 33.0f
+/* Longest relay experiment of the autotuner, in s */
+#define CTRL_TUNE_TIMEOUT_S 10.0f
+
+/* How the control cycle gets the feedback */
+typedef enum CTRL_Sched_t
+{
+    /* Each joint is read with a blocking request and reply */
+    CTRL_SCHED_PERIODIC = 0x00,
+    /* All joints are requested at once, the compute starts at the last reply or the deadline */
+    CTRL_SCHED_EVENT = 0x01,
+} CTRL_Sched_t;
+
+/* Source of the setpoints of a joint */
+typedef enum CTRL_Src_t
+{
+    /* Constant velocity of the bring-up */
+    CTRL_SRC_DEMO = 0x00,
+    /* Waypoints of the host through the interpolator, in position velocity mode */
+    CTRL_SRC_INTERP = 0x01,
+    /* Relay experiment of the autotuner, back to the source before at its end */
+    CTRL_SRC_TUNE = 0x02,
+    /* Target of the host through the jerk-limited trajectory generator, in position velocity mode */
+    CTRL_SRC_TRAJ = 0x03,
+    /* Target of the host through the trajectory generator, followed by the state feedback */
+    CTRL_SRC_LQR = 0x04,
+    CTRL_SRC_NUM = 0x05,
+} CTRL_Src_t;
+
+/* Loop of a joint, see ctrl_task_set_gain_sched() */
+typedef enum CTRL_Loop_t
+{
+    CTRL_LOOP_CUR = 0x00,
+    CTRL_LOOP_VEL = 0x01,
+    CTRL_LOOP_POS = 0x02,
+    CTRL_LOOP_NUM = 0x03,
+} CTRL_Loop_t;
+
+/* Relay experiment requested for a joint, see ctrl_task_tune() */
+typedef struct CTRL_Tune_t
+{
+    AUTOTUNE_Loop_t loop;
+    float sp;
+    float amp;
+    float hyst;
+} CTRL_Tune_t;
+
+/* Statistics of the event-driven cycle, times in us */
+typedef struct CTRL_Stat_t
+{
+    unsigned int cycles;
+    /* Cycles which reached the deadline with replies missing */
+    unsigned int late;
+    /* Stale joints summed over the cycles */
+    unsigned int stale;
+
+    /* Between the starts of two cycles */
+    unsigned int per_min;
+    unsigned int per_max;
+    unsigned int per_sum;
+    /* From the requests to the last reply */
+    unsigned int fbk_min;
+    unsigned int fbk_max;
+    unsigned int fbk_sum;
+    /* From the last reply to the last command sent, sense to actuate */
+    unsigned int act_min;
+    unsigned int act_max;
+    unsigned int act_sum;
+} CTRL_Stat_t;
 
 void init_task(void);
 void init_task_hardware(void);
 void init_task_controller(void);
 void init_task_innfos(void);
+void init_task_telem(void);
 void ctrl_task(void);
+void ctrl_task_fbk_periodic(void);
+void ctrl_task_fbk_event(void);
+void ctrl_task_set_sched(CTRL_Sched_t sched);
+void ctrl_task_get_stat(CTRL_Stat_t *stat);
+void ctrl_task_clr_stat(void);
+void telem_task(void);
+void telem_task_cmd(char *line);
+void telem_task_tune(char *args);
+void telem_task_gain(char *args);
+void diag_task(void);
+void lcd_task(void);
+int ctrl_task_set_exec(int idx, MOTOR_Exec_t exec, int fbk_div);
+int ctrl_task_set_src(int idx, CTRL_Src_t src);
+int ctrl_task_push_wp(int idx, uint32_t t_us, float pos);
+int ctrl_task_set_traj(int idx, float tgt, float vmax, float amax, float jmax);
+int ctrl_task_tune(int idx, AUTOTUNE_Loop_t loop, float sp, float amp, float hyst);
+int ctrl_task_set_gain_sched(int idx, CTRL_Loop_t loop, const float *x, const float *kp, const float *ki, const float *kd, int num);
+int ctrl_task_set_ffd(int idx, float kc, float kv, float kgc, float kgs);
+int ctrl_task_ffd_ident(int idx, int on);
+int ctrl_task_set_dob(int idx, float inertia, float damping, float th_on, float th_off);
 void loop_task(void);
+void rtos_ctrl_task(void *arg);
+void rtos_can_rx_task(void *arg);
+void rtos_telem_task(void *arg);
+void rtos_ui_task(void *arg);
 
 #endif